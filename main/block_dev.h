@@ -0,0 +1,47 @@
+/* Block device — declarations of raw sector access to the storage behind the segment log.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct block_dev block_dev_t;
+
+/**
+ * @brief Sector-addressed storage: the SD card on the ESP32, a disk image on the host
+ *
+ */
+struct block_dev {
+    uint32_t sector_size;   /*!< Bytes per sector */
+    uint32_t sector_count;  /*!< Number of sectors */
+    esp_err_t (*read)(block_dev_t *dev, uint32_t sector, void *buf, uint32_t count);        /*!< Read count sectors */
+    esp_err_t (*write)(block_dev_t *dev, uint32_t sector, const void *buf, uint32_t count); /*!< Write count sectors */
+    void *ctx;              /*!< Implementation data */
+};
+
+#ifdef ESP_PLATFORM
+#include "sdmmc_cmd.h"
+
+/**
+ * @brief Block device on an initialized SD card, without a file system
+ *
+ * @param[out] dev block device
+ * @param card card initialized with sdmmc_card_init()
+ * @return esp_err_t
+ */
+esp_err_t block_dev_sdmmc_init(block_dev_t *dev, sdmmc_card_t *card);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
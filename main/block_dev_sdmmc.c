@@ -0,0 +1,30 @@
+/* Block device — raw sectors of an SD card driven by the SDMMC host.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "sdmmc_cmd.h"
+#include "block_dev.h"
+
+static esp_err_t block_dev_sdmmc_read(block_dev_t *dev, uint32_t sector, void *buf, uint32_t count)
+{
+    return sdmmc_read_sectors((sdmmc_card_t *)dev->ctx, buf, sector, count);
+}
+
+static esp_err_t block_dev_sdmmc_write(block_dev_t *dev, uint32_t sector, const void *buf, uint32_t count)
+{
+    return sdmmc_write_sectors((sdmmc_card_t *)dev->ctx, buf, sector, count);
+}
+
+esp_err_t block_dev_sdmmc_init(block_dev_t *dev, sdmmc_card_t *card)
+{
+    dev->sector_size = card->csd.sector_size;
+    dev->sector_count = card->csd.capacity;
+    dev->read = block_dev_sdmmc_read;
+    dev->write = block_dev_sdmmc_write;
+    dev->ctx = card;
+    return ESP_OK;
+}
@@ -0,0 +1,64 @@
+/* Compact capture records — on-card layout of the fixed-size record format.
+
+   Shared by the firmware and the host tools in tools/, keep it free of ESP-IDF headers.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAPTURE_RECORD_MAGIC        (0x43425250) /* "PRBC" read as little-endian bytes */
+#define CAPTURE_RECORD_VERSION      (1)
+
+/* capture_record_t::flags */
+#define CAPTURE_RECORD_FLAG_WILDCARD_SSID   (1 << 0) /* broadcast probe, no SSID */
+#define CAPTURE_RECORD_FLAG_MALFORMED       (1 << 1) /* element list overran the frame */
+#define CAPTURE_RECORD_FLAG_SUMMARY         (1 << 2) /* captured under overload, no elements: SSID hash and
+                                                        fingerprint are 0 */
+#define CAPTURE_RECORD_FLAG_SAMPLED         (1 << 3) /* captured while only a share of the transmitters was kept */
+
+/**
+ * @brief File header, written once at the start of every compact capture file
+ *
+ * All fields are little-endian.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         /*!< CAPTURE_RECORD_MAGIC */
+    uint16_t version;       /*!< CAPTURE_RECORD_VERSION */
+    uint16_t record_size;   /*!< sizeof(capture_record_t), lets readers skip fields added later */
+    uint32_t flags;         /*!< Reserved, 0 */
+    uint32_t reserved;      /*!< Reserved, 0 */
+} capture_file_header_t;
+
+/**
+ * @brief One captured probe request
+ *
+ * All fields are little-endian.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t seconds;       /*!< Capture time, seconds since the epoch */
+    uint32_t microseconds;  /*!< Capture time, microseconds */
+    uint8_t mac[6];         /*!< Transmitter address */
+    int8_t rssi;            /*!< Signal strength in dBm */
+    uint8_t channel;        /*!< Channel the frame was received on */
+    uint16_t seq_ctrl;      /*!< Sequence control field, sequence number in the upper 12 bits */
+    uint16_t flags;         /*!< CAPTURE_RECORD_FLAG_* */
+    uint32_t ssid_hash;     /*!< FNV-1a hash of the SSID */
+    uint32_t fingerprint;   /*!< Device fingerprint of the information elements */
+} capture_record_t;
+
+_Static_assert(sizeof(capture_file_header_t) == 16, "compact file header layout changed");
+_Static_assert(sizeof(capture_record_t) == 28, "compact record layout changed, bump CAPTURE_RECORD_VERSION");
+
+#ifdef __cplusplus
+}
+#endif
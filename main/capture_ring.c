@@ -0,0 +1,116 @@
+/* Capture ring — lock-free packet record buffer.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "capture_ring.h"
+
+/* Every record starts with a 32-bit length word; records are padded to 4 bytes */
+#define RING_LEN_SIZE       (sizeof(uint32_t))
+#define RING_WRAP_MARKER    (0xFFFFFFFFu)
+#define RING_ALIGN(x)       (((x) + 3u) & ~3u)
+
+void capture_ring_init(capture_ring_t *ring, void *buf, uint32_t size)
+{
+    ring->buf = (uint8_t *)buf;
+    ring->size = size & ~3u;
+    capture_ring_reset(ring);
+}
+
+void capture_ring_reset(capture_ring_t *ring)
+{
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+    ring->reserved_at = 0;
+    ring->peeked_at = 0;
+}
+
+void *capture_ring_reserve(capture_ring_t *ring, uint32_t length)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t need = RING_ALIGN(RING_LEN_SIZE + length);
+
+    /* head must never catch up with tail, otherwise a full ring looks empty */
+    if (head >= tail)
+    {
+        uint32_t to_end = ring->size - head;
+        if (need < to_end || (need == to_end && tail != 0))
+        {
+            ring->reserved_at = head;
+            return ring->buf + head + RING_LEN_SIZE;
+        }
+        if (need < tail)
+        {
+            /* does not fit before the end: mark the gap and continue from the start */
+            *(uint32_t *)(ring->buf + head) = RING_WRAP_MARKER;
+            ring->reserved_at = 0;
+            return ring->buf + RING_LEN_SIZE;
+        }
+    }
+    else if (head + need < tail)
+    {
+        ring->reserved_at = head;
+        return ring->buf + head + RING_LEN_SIZE;
+    }
+
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return NULL;
+}
+
+void capture_ring_commit(capture_ring_t *ring, uint32_t length)
+{
+    uint32_t next = ring->reserved_at + RING_ALIGN(RING_LEN_SIZE + length);
+
+    *(uint32_t *)(ring->buf + ring->reserved_at) = length;
+    if (next == ring->size)
+    {
+        next = 0;
+    }
+    /* release: the record (and a possible wrap marker) is visible before the new head */
+    atomic_store_explicit(&ring->head, next, memory_order_release);
+}
+
+void *capture_ring_peek(capture_ring_t *ring, uint32_t *length)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail == head)
+    {
+        return NULL;
+    }
+    if (*(uint32_t *)(ring->buf + tail) == RING_WRAP_MARKER)
+    {
+        tail = 0;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    ring->peeked_at = tail;
+    *length = *(uint32_t *)(ring->buf + tail);
+    return ring->buf + tail + RING_LEN_SIZE;
+}
+
+void capture_ring_release(capture_ring_t *ring)
+{
+    uint32_t length = *(uint32_t *)(ring->buf + ring->peeked_at);
+    uint32_t next = ring->peeked_at + RING_ALIGN(RING_LEN_SIZE + length);
+
+    if (next == ring->size)
+    {
+        next = 0;
+    }
+    /* release: we are done reading the record before the producer may reuse it */
+    atomic_store_explicit(&ring->tail, next, memory_order_release);
+}
+
+uint32_t capture_ring_used(const capture_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    return (head >= tail) ? head - tail : ring->size - tail + head;
+}
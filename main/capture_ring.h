@@ -0,0 +1,101 @@
+/* Capture ring — declarations of the lock-free packet record buffer.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Single-producer/single-consumer ring of variable-length records
+ *
+ * Records are stored contiguously (bip-buffer style): a record that does not
+ * fit in the space left before the end of the buffer is placed at the start
+ * instead, so the consumer always sees each record as one contiguous block
+ * and can process it in place.
+ *
+ * The producer (Wi-Fi promiscuous callback) never allocates and never blocks;
+ * when there is no room the record is dropped and counted.
+ */
+typedef struct {
+    uint8_t *buf;               /*!< Backing storage, 4-byte aligned */
+    uint32_t size;              /*!< Size of the backing storage, multiple of 4 */
+    _Atomic uint32_t head;      /*!< Write offset, owned by the producer */
+    _Atomic uint32_t tail;      /*!< Read offset, owned by the consumer */
+    uint32_t reserved_at;       /*!< Producer: offset of the pending reservation */
+    uint32_t peeked_at;         /*!< Consumer: offset of the record being processed */
+    _Atomic uint32_t dropped;   /*!< Records dropped because the ring was full */
+} capture_ring_t;
+
+/**
+ * @brief Initialize the ring over a caller-provided buffer
+ *
+ * @param ring ring to initialize
+ * @param buf backing storage, must be 4-byte aligned
+ * @param size size of the backing storage, rounded down to a multiple of 4
+ */
+void capture_ring_init(capture_ring_t *ring, void *buf, uint32_t size);
+
+/**
+ * @brief Discard all records and reset counters (no producer or consumer may be active)
+ */
+void capture_ring_reset(capture_ring_t *ring);
+
+/**
+ * @brief Reserve space for one record (producer side)
+ *
+ * @param ring ring to write to
+ * @param length number of bytes the record will hold
+ * @return pointer to the record storage, or NULL if the ring is full (the drop is counted)
+ */
+void *capture_ring_reserve(capture_ring_t *ring, uint32_t length);
+
+/**
+ * @brief Publish the record returned by the last capture_ring_reserve() (producer side)
+ *
+ * @param ring ring to write to
+ * @param length length of the record, must not exceed the reserved length
+ */
+void capture_ring_commit(capture_ring_t *ring, uint32_t length);
+
+/**
+ * @brief Get the oldest record without removing it (consumer side)
+ *
+ * @param ring ring to read from
+ * @param[out] length length of the record
+ * @return pointer to the record, or NULL if the ring is empty
+ */
+void *capture_ring_peek(capture_ring_t *ring, uint32_t *length);
+
+/**
+ * @brief Remove the record returned by the last capture_ring_peek() (consumer side)
+ */
+void capture_ring_release(capture_ring_t *ring);
+
+/**
+ * @brief Number of bytes currently occupied by records, including wrap padding
+ */
+uint32_t capture_ring_used(const capture_ring_t *ring);
+
+/**
+ * @brief Number of records dropped because the ring was full
+ */
+static inline uint32_t capture_ring_dropped(const capture_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+/* Capture sink — interface of the output formats, one of which is compiled in.
+
+   The format is chosen with CONFIG_CAPTURE_FORMAT in config.h. Every sink_*.c file implements the
+   functions below for its formats only and is empty otherwise, so the capture path calls the selected
+   encoder directly. Keep this header free of ESP-IDF headers, the host tools in tools/ build the sinks too.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "config.h"
+#include "ie_parser.h"
+#include "overload.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest file header, record head and tail and statistics record a sink produces */
+#define CAPTURE_SINK_HEADER_MAX     (256)
+#define CAPTURE_SINK_HEAD_MAX       (64)
+#define CAPTURE_SINK_TAIL_MAX       (64)
+#define CAPTURE_SINK_STATS_MAX      (128)
+
+/* pcap link type of the selected format */
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_RADIOTAP || CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_RADIOTAP_CSI
+#define CAPTURE_SINK_LINK_TYPE      (127) /* LINKTYPE_IEEE802_11_RADIOTAP */
+#else
+#define CAPTURE_SINK_LINK_TYPE      (105) /* LINKTYPE_IEEE802_11 */
+#endif
+
+/**
+ * @brief 802.11 MAC header of a management frame
+ *
+ */
+typedef struct {
+	int16_t frame_ctrl;
+	int16_t duration;
+	uint8_t addr1[6];
+	uint8_t addr2[6];
+	uint8_t addr3[6];
+	int16_t sequence_number;
+	unsigned char payload[];
+} packet_control_header_t;
+
+/**
+ * @brief Captured frame together with what the parse stage learned about it
+ *
+ */
+typedef struct {
+    const uint8_t *payload;         /*!< 802.11 frame without FCS */
+    uint32_t length;                /*!< Length of the frame as captured */
+    uint32_t orig_length;           /*!< Length of the frame on air, larger than length if it was trimmed */
+    uint32_t seconds;               /*!< Second of capture time */
+    uint32_t microseconds;          /*!< Microsecond of capture time */
+    int8_t rssi;                    /*!< Signal strength in dBm */
+    uint8_t channel;                /*!< Channel the frame was received on */
+    uint8_t rate;                   /*!< Legacy data rate in 500 kbps units, 0 for HT or unknown rates */
+    const ie_probe_info_t *ies;     /*!< Parsed information elements */
+    uint8_t overload;               /*!< overload_mode_t the frame was captured in; summaries carry no elements */
+} capture_frame_t;
+
+/**
+ * @brief Encoded record: head, then body_length bytes at body (e.g. the frame itself), then tail
+ *
+ */
+typedef struct {
+    uint8_t head[CAPTURE_SINK_HEAD_MAX];
+    uint32_t head_length;
+    const uint8_t *body;            /*!< Data stored between head and tail, NULL if none */
+    uint32_t body_length;
+    uint8_t tail[CAPTURE_SINK_TAIL_MAX];
+    uint32_t tail_length;
+} capture_sink_record_t;
+
+/**
+ * @brief Capture counters of the session so far, for formats that can store them
+ *
+ */
+typedef struct {
+    uint32_t seconds;               /*!< Time of the snapshot, seconds */
+    uint32_t microseconds;          /*!< Time of the snapshot, microseconds */
+    uint32_t start_seconds;         /*!< Start of the capture session */
+    uint64_t received;              /*!< Probe requests seen by the Wi-Fi callback */
+    uint64_t accepted;              /*!< Of those, frames that passed the filters (e.g. duplicate suppression) */
+    uint64_t dropped;               /*!< Accepted frames lost because the capture ring was full */
+    uint64_t delivered;             /*!< Frames handed to the output */
+} capture_stats_t;
+
+/**
+ * @brief Encode the header starting every capture file
+ *
+ * @param[out] buf at least CAPTURE_SINK_HEADER_MAX bytes
+ * @return number of bytes written to buf
+ */
+uint32_t capture_sink_file_header(uint8_t *buf);
+
+/**
+ * @brief Encode one frame
+ *
+ * @param frame captured frame
+ * @param[out] record encoded record
+ */
+void capture_sink_record(const capture_frame_t *frame, capture_sink_record_t *record);
+
+/**
+ * @brief Encode a statistics record
+ *
+ * @param stats capture counters
+ * @param[out] buf at least CAPTURE_SINK_STATS_MAX bytes
+ * @return number of bytes written to buf, 0 for formats without statistics records
+ */
+uint32_t capture_sink_stats(const capture_stats_t *stats, uint8_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
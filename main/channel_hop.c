@@ -0,0 +1,182 @@
+/* Channel hopping — adaptive channel scheduler.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+#include "config.h"
+#include "channel_hop.h"
+
+/* Smoothed rates are kept in frames per second with 4 fractional bits */
+#define CHANNEL_HOP_RATE_SHIFT  (4)
+#define CHANNEL_HOP_RATE_ONE    (1 << CHANNEL_HOP_RATE_SHIFT)
+
+static const char *HOP_TAG = "channel_hop";
+
+typedef struct {
+    bool is_running;
+    uint8_t channels[CHANNEL_HOP_MAX_CHANNELS];
+    uint32_t count;
+    uint32_t dwell_ms[CHANNEL_HOP_MAX_CHANNELS];
+    uint32_t rate[CHANNEL_HOP_MAX_CHANNELS];
+    uint32_t frames[CHANNEL_HOP_MAX_CHANNELS];
+    uint32_t time_ms[CHANNEL_HOP_MAX_CHANNELS];
+    volatile uint32_t seen[CHANNEL_HOP_MAX_CHANNELS + 1]; /* frames counted by the callback, indexed by channel */
+    TaskHandle_t task;
+    SemaphoreHandle_t sem_task_over;
+} channel_hop_runtime_t;
+
+static const uint8_t default_channels[] = CONFIG_CHANNEL_HOP_CHANNELS;
+static channel_hop_runtime_t hop_rt = {0};
+
+/* Share the cycle between channels in proportion to their probe density, never below the minimum dwell */
+static void update_dwell_times(void)
+{
+    uint32_t budget = CONFIG_CHANNEL_HOP_CYCLE_MS;
+    uint32_t floor = CONFIG_CHANNEL_HOP_MIN_DWELL_MS * hop_rt.count;
+    uint32_t spare = budget > floor ? budget - floor : 0;
+    uint64_t weight_sum = 0;
+
+    /* every channel weighs at least 1 frame/s so idle channels share the spare time evenly */
+    for (uint32_t i = 0; i < hop_rt.count; i++)
+    {
+        weight_sum += hop_rt.rate[i] + CHANNEL_HOP_RATE_ONE;
+    }
+    for (uint32_t i = 0; i < hop_rt.count; i++)
+    {
+        uint32_t dwell = CONFIG_CHANNEL_HOP_MIN_DWELL_MS +
+                         (uint32_t)((uint64_t)spare * (hop_rt.rate[i] + CHANNEL_HOP_RATE_ONE) / weight_sum);
+        hop_rt.dwell_ms[i] = dwell > CONFIG_CHANNEL_HOP_MAX_DWELL_MS ? CONFIG_CHANNEL_HOP_MAX_DWELL_MS : dwell;
+    }
+}
+
+static void channel_hop_task(void *parameters)
+{
+    uint32_t idx = 0;
+
+    while (hop_rt.is_running)
+    {
+        uint8_t channel = hop_rt.channels[idx];
+        uint32_t seen_before = hop_rt.seen[channel];
+        TickType_t start = xTaskGetTickCount();
+
+        esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+        /* channel_hop_stop() cuts the dwell short with a notification */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(hop_rt.dwell_ms[idx]));
+
+        uint32_t spent_ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+        uint32_t frames = hop_rt.seen[channel] - seen_before;
+        hop_rt.frames[idx] += frames;
+        hop_rt.time_ms[idx] += spent_ms;
+        if (spent_ms > 0)
+        {
+            uint32_t rate = (uint32_t)(((uint64_t)frames * 1000 << CHANNEL_HOP_RATE_SHIFT) / spent_ms);
+            hop_rt.rate[idx] = (hop_rt.rate[idx] * 3 + rate) / 4;
+        }
+
+        if (++idx == hop_rt.count)
+        {
+            idx = 0;
+            update_dwell_times();
+        }
+    }
+    xSemaphoreGive(hop_rt.sem_task_over);
+    vTaskDelete(NULL);
+}
+
+esp_err_t channel_hop_set_channels(const uint8_t *channels, uint32_t count)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_GOTO_ON_FALSE(!hop_rt.is_running, ESP_ERR_INVALID_STATE, err, HOP_TAG, "channel hopping is running");
+    ESP_GOTO_ON_FALSE(count > 0 && count <= CHANNEL_HOP_MAX_CHANNELS, ESP_ERR_INVALID_ARG, err, HOP_TAG,
+                      "invalid number of channels");
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ESP_GOTO_ON_FALSE(channels[i] >= 1 && channels[i] <= CHANNEL_HOP_MAX_CHANNELS, ESP_ERR_INVALID_ARG, err,
+                          HOP_TAG, "invalid channel %u", channels[i]);
+    }
+    memcpy(hop_rt.channels, channels, count);
+    hop_rt.count = count;
+    memset(hop_rt.rate, 0, sizeof(hop_rt.rate));
+    memset(hop_rt.frames, 0, sizeof(hop_rt.frames));
+    memset(hop_rt.time_ms, 0, sizeof(hop_rt.time_ms));
+    update_dwell_times();
+err:
+    return ret;
+}
+
+esp_err_t channel_hop_start(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_GOTO_ON_FALSE(!hop_rt.is_running, ESP_ERR_INVALID_STATE, err, HOP_TAG, "channel hopping is already running");
+    if (hop_rt.count == 0)
+    {
+        ESP_GOTO_ON_ERROR(channel_hop_set_channels(default_channels, sizeof(default_channels)), err, HOP_TAG,
+                          "invalid CONFIG_CHANNEL_HOP_CHANNELS");
+    }
+    hop_rt.sem_task_over = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(hop_rt.sem_task_over, ESP_FAIL, err, HOP_TAG, "create semaphore failed");
+    hop_rt.is_running = true;
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(channel_hop_task, "hopT", CONFIG_CHANNEL_HOP_TASK_STACK_SIZE, NULL,
+                                              CONFIG_CHANNEL_HOP_TASK_PRIORITY, &hop_rt.task,
+                                              CONFIG_CHANNEL_HOP_TASK_CORE), ESP_FAIL,
+                      err_task, HOP_TAG, "create task failed");
+    ESP_LOGI(HOP_TAG, "hopping across %u channels", hop_rt.count);
+    return ret;
+err_task:
+    hop_rt.is_running = false;
+    vSemaphoreDelete(hop_rt.sem_task_over);
+    hop_rt.sem_task_over = NULL;
+err:
+    return ret;
+}
+
+esp_err_t channel_hop_stop(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_GOTO_ON_FALSE(hop_rt.is_running, ESP_ERR_INVALID_STATE, err, HOP_TAG, "channel hopping is already stopped");
+    hop_rt.is_running = false;
+    xTaskNotifyGive(hop_rt.task);
+    xSemaphoreTake(hop_rt.sem_task_over, portMAX_DELAY);
+    vSemaphoreDelete(hop_rt.sem_task_over);
+    hop_rt.sem_task_over = NULL;
+    hop_rt.task = NULL;
+err:
+    return ret;
+}
+
+void channel_hop_count(uint8_t channel)
+{
+    if (channel <= CHANNEL_HOP_MAX_CHANNELS)
+    {
+        hop_rt.seen[channel]++;
+    }
+}
+
+uint32_t channel_hop_get_stats(channel_hop_stats_t *stats, uint32_t max)
+{
+    uint32_t n = hop_rt.count < max ? hop_rt.count : max;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        stats[i].channel = hop_rt.channels[i];
+        stats[i].dwell_ms = hop_rt.dwell_ms[i];
+        stats[i].frames = hop_rt.frames[i];
+        stats[i].time_ms = hop_rt.time_ms[i];
+        stats[i].rate = hop_rt.rate[i] >> CHANNEL_HOP_RATE_SHIFT;
+    }
+    return n;
+}
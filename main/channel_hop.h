@@ -0,0 +1,80 @@
+/* Channel hopping — declarations of the adaptive channel scheduler.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHANNEL_HOP_MAX_CHANNELS    (14)
+
+/**
+ * @brief Capture statistics of one channel in the hopping set
+ *
+ */
+typedef struct {
+    uint8_t channel;    /*!< Wi-Fi channel number */
+    uint32_t dwell_ms;  /*!< Current dwell time on the channel */
+    uint32_t frames;    /*!< Frames captured on the channel since start */
+    uint32_t time_ms;   /*!< Time spent on the channel since start */
+    uint32_t rate;      /*!< Smoothed capture rate in frames per second */
+} channel_hop_stats_t;
+
+/**
+ * @brief Set the channels to hop across
+ *
+ * @param channels list of channels, 1 to 14
+ * @param count number of channels in the list, at most CHANNEL_HOP_MAX_CHANNELS
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the list is empty, too long or holds an invalid channel
+ */
+esp_err_t channel_hop_set_channels(const uint8_t *channels, uint32_t count);
+
+/**
+ * @brief Start hopping, the radio must already be in promiscuous mode
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if already hopping
+ *      - ESP_FAIL if the hopping task can't be created
+ */
+esp_err_t channel_hop_start(void);
+
+/**
+ * @brief Stop hopping, the radio stays on the current channel
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if not hopping
+ */
+esp_err_t channel_hop_stop(void);
+
+/**
+ * @brief Count a captured frame, called from the promiscuous callback
+ *
+ * @param channel channel the frame was received on (rx_ctrl.channel)
+ */
+void channel_hop_count(uint8_t channel);
+
+/**
+ * @brief Get per-channel capture statistics
+ *
+ * @param[out] stats array receiving one entry per channel in the hopping set
+ * @param max size of the stats array
+ * @return number of entries written
+ */
+uint32_t channel_hop_get_stats(channel_hop_stats_t *stats, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,15 +10,183 @@
 #define CONFIG_WIFI_SSID "SSID"
 #define CONFIG_WIFI_PASSWORD "PASSWORD"
 
+// Fast boot: capture starts right after reset on a time kept by the RTC or saved in NVS; SNTP runs in the
+// background (channel hopping pauses while it joins CONFIG_WIFI_SSID) and every clock step it makes is appended
+// to the time sync file, so timestamps taken before can be corrected; 0 waits for SNTP at boot instead
+#define CONFIG_FAST_BOOT_ENABLED 1
+#define CONFIG_TIME_SYNC_FILENAME "timesync.csv"
+#define CONFIG_TIME_SYNC_RETRY_S 300
+#define CONFIG_TIME_SYNC_INTERVAL_S (6 * 3600)
+#define CONFIG_TIME_SYNC_TIMEOUT_S 30
+#define CONFIG_TIME_SYNC_SAVE_S 600
+
+#ifndef CONFIG_SD_MOUNT_POINT
 #define CONFIG_SD_MOUNT_POINT "/sdcard"
+#endif
 #define CONFIG_SD_1_LINE true
 
-#define CONFIG_PCAP_FILENAME_MASK "file_%06d.pcap"
+// Storage backend, selected at compile time
+//  FAT: capture files on the FAT file system of the card
+//  RAW: the capture files as an append-only log of checksummed segments written straight to the card's sectors
+//       from CONFIG_SEGLOG_FIRST_SECTOR on, no file system; resumes after a power loss, tools/segextract turns a
+//       card image back into the files. Overwrites the card; manifest, stats and time sync go to the console only
+#define STORAGE_BACKEND_FAT 0
+#define STORAGE_BACKEND_RAW 1
+#ifndef CONFIG_STORAGE_BACKEND
+#define CONFIG_STORAGE_BACKEND STORAGE_BACKEND_FAT
+#endif
+// Leaves the partition table area of the card alone
+#define CONFIG_SEGLOG_FIRST_SECTOR 2048
+
+// Output format, selected at compile time; the other formats are compiled out
+//  PCAP: full 802.11 frames in pcap files
+//  COMPACT: fixed-size records (tools/prbconv converts them to pcap/CSV)
+//  RADIOTAP: as PCAP, each frame with a radiotap header carrying RSSI, rate and channel
+//  CSV: one text line with time, MAC, RSSI and channel per frame
+//  RADIOTAP_CSI: as RADIOTAP, plus the CSI of received frames in side files (needs CONFIG_ESP32_WIFI_CSI_ENABLED)
+//  PCAPNG: full 802.11 frames in pcapng files, channel and RSSI as packet comments, periodic interface statistics
+#define CAPTURE_FORMAT_PCAP 0
+#define CAPTURE_FORMAT_COMPACT 1
+#define CAPTURE_FORMAT_RADIOTAP 2
+#define CAPTURE_FORMAT_CSV 3
+#define CAPTURE_FORMAT_RADIOTAP_CSI 4
+#define CAPTURE_FORMAT_PCAPNG 5
+#ifndef CONFIG_CAPTURE_FORMAT
+#define CONFIG_CAPTURE_FORMAT CAPTURE_FORMAT_PCAP
+#endif
+
+// Compress the output block by block in the writer task, files get a .lzb suffix (tools/lzbtool decompresses)
+// Takes 2 blocks of staging RAM and an 8 KB hash table; rotation limits still count uncompressed bytes
+#ifndef CONFIG_PCAP_COMPRESSION_ENABLED
+#define CONFIG_PCAP_COMPRESSION_ENABLED 0
+#endif
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_COMPACT
+#define CONFIG_PCAP_FILENAME_EXT ".prb"
+#elif CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_CSV
+#define CONFIG_PCAP_FILENAME_EXT ".csv"
+#elif CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_PCAPNG
+#define CONFIG_PCAP_FILENAME_EXT ".pcapng"
+#else
+#define CONFIG_PCAP_FILENAME_EXT ".pcap"
+#endif
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+#define CONFIG_PCAP_FILENAME_MASK "file_%06d" CONFIG_PCAP_FILENAME_EXT ".lzb"
+#else
+#define CONFIG_PCAP_FILENAME_MASK "file_%06d" CONFIG_PCAP_FILENAME_EXT
+#endif
+#define CONFIG_CSI_FILENAME_MASK "csi_%06d.csv"
+// How often received/dropped counters go into the output, for formats that store them (pcapng)
+#define CONFIG_CAPTURE_STATS_INTERVAL_S 60
+// List of finished capture files (index, name, start/end time, packet count) kept next to them
+#define CONFIG_MANIFEST_FILENAME "manifest.csv"
+// Pipeline counters (frames seen, filtered, queued, dropped, written; heap low-water mark) appended as one
+// CSV line to this file and logged on the console at this interval
+#define CONFIG_TELEMETRY_FILENAME "stats.csv"
+#define CONFIG_TELEMETRY_INTERVAL_S 60
+// Cycle-counter histograms of the callback, ring wait, capture and block write times (p50/p99/max logged
+// at rotation and stop); 0 compiles the instrumentation out, 1 takes about 2 KB of RAM. The ring wait compares
+// cycle counters, so 1 needs CONFIG_SNIFFER_TASK_CORE to be the core of the Wi-Fi task
+#define CONFIG_LATENCY_ENABLED 0
 
+// Capture pipeline: Wi-Fi callback -> ring -> sniffer (parse) task -> blocks -> pcap writer (storage) task
+// Keep the storage stage off the core running the Wi-Fi task (core 0 by default)
 #define CONFIG_SNIFFER_TASK_STACK_SIZE 4096
 #define CONFIG_SNIFFER_TASK_PRIORITY 2
-#define CONFIG_SNIFFER_WORK_QUEUE_LEN 128
+#define CONFIG_SNIFFER_TASK_CORE 0
+#define CONFIG_SNIFFER_RING_SIZE (32 * 1024)
+
+// Trim frames in the Wi-Fi callback before the copy into the ring; pcap records keep the original length
+// Snap length: copy at most this many bytes of each frame, cut at an element boundary; 0 copies whole frames
+#define CONFIG_SNIFFER_SNAPLEN 0
+// Element allow-list: copy only these information elements after the MAC header
+// e.g. SSID (0), rates (1, 50), HT (45), extended (127) and VHT (191) capabilities; the device fingerprint
+// then only covers the kept elements
+#define CONFIG_SNIFFER_IE_FILTER_ENABLED 0
+#define CONFIG_SNIFFER_IE_ALLOW_LIST {0, 1, 45, 50, 127, 191}
+
+// Frame filter, compiled into a rule table at start and checked in the Wi-Fi callback before the copy; the
+// driver already passes only management frames
+// Management subtypes to keep, one bit each (4: probe request, 5: probe response, 8: beacon); the parsed
+// formats read elements where a probe request has them
+#define CONFIG_FILTER_SUBTYPES (1 << 4)
+// Frames weaker than this (dBm) are dropped, -128 keeps all
+#define CONFIG_FILTER_MIN_RSSI -128
+// Per-bit conditions: FILTER_ANY ignores the bit, FILTER_ONLY keeps only frames with it, FILTER_EXCLUDE only without
+//  RANDOMIZED: locally administered transmitter address, as used by MAC randomization
+//  WILDCARD_SSID: probe request for any network rather than a named one
+//  FCS_FAILED: bad frame check sequence, the driver only passes such frames if this is not FILTER_EXCLUDE
+#define FILTER_ANY 0
+#define FILTER_ONLY 1
+#define FILTER_EXCLUDE 2
+#define CONFIG_FILTER_RANDOMIZED FILTER_ANY
+#define CONFIG_FILTER_WILDCARD_SSID FILTER_ANY
+#define CONFIG_FILTER_FCS_FAILED FILTER_EXCLUDE
+// Transmitter OUIs, e.g. {0x0017F2, 0x3CA9F4}: with an allow list only those vendors are kept, the deny list
+// drops vendors before any other rule; 15 entries in both lists together
+#define CONFIG_FILTER_OUI_ALLOW_LIST {}
+#define CONFIG_FILTER_OUI_DENY_LIST {}
+
+// Frames are stamped with the radio's receive counter (rx_ctrl.timestamp), mapped to the system clock by an
+// offset and skew: the clock is sampled next to a frame every interval, the least delayed sample of each window
+// re-anchors the mapping. Backward corrections are slewed out at most this fast so timestamps never go back
+#define CONFIG_TIMEBASE_SAMPLE_MS 1000
+#define CONFIG_TIMEBASE_WINDOW 16
+#define CONFIG_TIMEBASE_SLEW_PPM 5000
+
+// Drop exact repeats (same MAC, sequence number and elements) seen within the window before queuing them
+// The table size is a power of two, each slot takes 20 bytes
+#define CONFIG_DEDUP_ENABLED 1
+#define CONFIG_DEDUP_TABLE_SIZE 1024
+#define CONFIG_DEDUP_WINDOW_MS 1000
+
+// Load shedding when the capture ring fills up, instead of losing whole frames at random: from the summary level
+// on (percent of CONFIG_SNIFFER_RING_SIZE in use) only the MAC header is kept, from the sample level on only the
+// transmitters whose seeded address hash falls in the kept share. A mode is left once the ring is the hysteresis
+// below its level and it was held long enough. The mode is recorded with every frame where the format has room
+#define CONFIG_OVERLOAD_ENABLED 1
+#define CONFIG_OVERLOAD_SUMMARY_PERCENT 50
+#define CONFIG_OVERLOAD_SAMPLE_PERCENT 90
+#define CONFIG_OVERLOAD_HYSTERESIS_PERCENT 25
+#define CONFIG_OVERLOAD_HOLD_MS 1000
+#define CONFIG_OVERLOAD_KEEP_PERCENT 25
+#define CONFIG_OVERLOAD_SEED 0x5EED0001
+
+// Channel hopping: dwell times within each cycle follow the probe density seen on every channel
+#define CONFIG_CHANNEL_HOP_ENABLED 1
+#define CONFIG_CHANNEL_HOP_CHANNELS {1, 6, 11}
+#define CONFIG_CHANNEL_HOP_CYCLE_MS 1500
+#define CONFIG_CHANNEL_HOP_MIN_DWELL_MS 100
+#define CONFIG_CHANNEL_HOP_MAX_DWELL_MS 1000
+#define CONFIG_CHANNEL_HOP_TASK_STACK_SIZE 2048
+#define CONFIG_CHANNEL_HOP_TASK_PRIORITY 3
+#define CONFIG_CHANNEL_HOP_TASK_CORE 0
+
+// Size of each pcap write block, keep it a multiple of the FAT allocation unit
+#ifndef CONFIG_PCAP_BLOCK_SIZE
+#define CONFIG_PCAP_BLOCK_SIZE (16 * 1024)
+#endif
+#define CONFIG_PCAP_BLOCK_COUNT 2
+#define CONFIG_PCAP_WRITER_TASK_STACK_SIZE 4096
+#define CONFIG_PCAP_WRITER_TASK_PRIORITY 2
+#define CONFIG_PCAP_WRITER_TASK_CORE 1
+
+// File rotation, whichever limit is reached first; 0 disables a limit
+// The interval rotates on wall-clock multiples, e.g. 30 rotates at hh:00 and hh:30
+#define CONFIG_PCAP_ROTATE_INTERVAL_MINUTES 30
+#define CONFIG_PCAP_ROTATE_MAX_BYTES (64 * 1024 * 1024)
+#define CONFIG_PCAP_ROTATE_MAX_PACKETS 0
+
+// Reserve the space of each capture file ahead of the writes, so they do not allocate clusters; the unused rest
+// is trimmed when the file is closed. Reserved in extents of at most this many bytes, also the most a power cut
+// can leave reserved but unwritten: a new file gets the previous one plus a quarter (capped at this), a file
+// outgrowing its reservation the next extent, never past CONFIG_PCAP_ROTATE_MAX_BYTES; 0 disables preallocation
+#define CONFIG_PCAP_PREALLOCATE_BYTES (4 * 1024 * 1024)
 
-#define CONFIG_SAVE_FREQUENCY_MINUTES 30
+// Group commit: the writer task syncs the file to the card once this many bytes were written since the last sync,
+// or once the oldest record not yet synced is this old, whichever comes first; 0 disables a budget
+// With both disabled, data is only committed to the FAT when a file is closed
+#define CONFIG_PCAP_COMMIT_BYTES (256 * 1024)
+#define CONFIG_PCAP_COMMIT_INTERVAL_MS 5000
 
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+/* CSI log — channel state information side files written next to the capture files.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "config.h"
+#include "csi_log.h"
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_RADIOTAP_CSI
+
+#if !CONFIG_ESP32_WIFI_CSI_ENABLED
+#error "CAPTURE_FORMAT_RADIOTAP_CSI needs CONFIG_ESP32_WIFI_CSI_ENABLED in sdkconfig"
+#endif
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+#error "CAPTURE_FORMAT_RADIOTAP_CSI writes its side files to the file system, use STORAGE_BACKEND_FAT"
+#endif
+
+#define CSI_LOG_BUFFER_SIZE     (4096)
+
+static const char *CSI_TAG = "csi";
+
+static FILE *csi_fp = NULL;
+static char csi_filename[CONFIG_FATFS_MAX_LFN];
+/* lines are small and frequent, let stdio gather them into card-sized writes */
+static char csi_buffer[CSI_LOG_BUFFER_SIZE];
+
+esp_err_t csi_log_open(uint32_t idx)
+{
+    csi_log_close();
+    snprintf(csi_filename, sizeof(csi_filename), CONFIG_SD_MOUNT_POINT"/"CONFIG_CSI_FILENAME_MASK, idx);
+    csi_fp = fopen(csi_filename, "a");
+    if (!csi_fp)
+    {
+        ESP_LOGE(CSI_TAG, "open %s failed", csi_filename);
+        return ESP_FAIL;
+    }
+    setvbuf(csi_fp, csi_buffer, _IOFBF, sizeof(csi_buffer));
+    if (ftell(csi_fp) == 0)
+    {
+        fputs("time,mac,rssi,channel,length,data\n", csi_fp);
+    }
+    return ESP_OK;
+}
+
+void csi_log_write(const csi_log_entry_t *entry)
+{
+    if (!csi_fp)
+    {
+        return;
+    }
+    fprintf(csi_fp, "%u.%06u,%02x:%02x:%02x:%02x:%02x:%02x,%d,%u,%u,", entry->seconds, entry->microseconds,
+            entry->mac[0], entry->mac[1], entry->mac[2], entry->mac[3], entry->mac[4], entry->mac[5],
+            entry->rssi, entry->channel, entry->length);
+    for (uint32_t i = 0; i < entry->length; i++)
+    {
+        fprintf(csi_fp, i ? " %d" : "%d", entry->data[i]);
+    }
+    fputc('\n', csi_fp);
+}
+
+void csi_log_close(void)
+{
+    if (csi_fp)
+    {
+        if (fclose(csi_fp) != 0)
+        {
+            ESP_LOGE(CSI_TAG, "close %s failed", csi_filename);
+        }
+        csi_fp = NULL;
+    }
+}
+
+#endif
@@ -0,0 +1,59 @@
+/* CSI log — declarations of the channel state information side files.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief CSI of one received frame
+ *
+ */
+typedef struct {
+    uint32_t seconds;           /*!< Second of reception time */
+    uint32_t microseconds;      /*!< Microsecond of reception time */
+    uint8_t mac[6];             /*!< Transmitter address */
+    int8_t rssi;                /*!< Signal strength in dBm */
+    uint8_t channel;            /*!< Channel the frame was received on */
+    const int8_t *data;         /*!< Interleaved imaginary and real parts of the subcarriers */
+    uint16_t length;            /*!< Number of bytes at data */
+} csi_log_entry_t;
+
+/**
+ * @brief Continue the CSI log in the side file of capture file idx, closing the current one
+ *
+ * Opens the file in append mode, so returning to an index keeps what was logged before.
+ *
+ * @param idx index of the capture file, see CONFIG_CSI_FILENAME_MASK
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the file can't be opened
+ */
+esp_err_t csi_log_open(uint32_t idx);
+
+/**
+ * @brief Append one CSV line to the open side file
+ *
+ * @param entry CSI to log
+ */
+void csi_log_write(const csi_log_entry_t *entry);
+
+/**
+ * @brief Flush and close the side file
+ *
+ */
+void csi_log_close(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+/* Duplicate suppression — repeated probe request filter.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "dedup.h"
+#include "fnv1a.h"
+
+/* Slots inspected per lookup; bounds the cost of a lookup when the table is full */
+#define DEDUP_MAX_PROBE     (16)
+
+void dedup_init(dedup_table_t *table, dedup_entry_t *entries, uint32_t count, uint32_t window_ms)
+{
+    memset(entries, 0, count * sizeof(dedup_entry_t));
+    table->entries = entries;
+    table->mask = count - 1;
+    table->window_ms = window_ms;
+    table->checked = 0;
+    table->suppressed = 0;
+}
+
+static uint32_t dedup_key(const uint8_t *mac, uint16_t seq_ctrl, uint32_t ie_hash)
+{
+    uint32_t key = ie_hash;
+
+    for (int i = 0; i < 6; i++)
+    {
+        key = fnv1a_byte(key, mac[i]);
+    }
+    key = (key ^ seq_ctrl) * FNV1A_PRIME;
+    /* final avalanche so the low bits used as slot index depend on every input byte */
+    key ^= key >> 16;
+    key *= 0x7FEB352Du;
+    key ^= key >> 15;
+    /* 0 marks a never used slot */
+    return key | 1;
+}
+
+bool dedup_check(dedup_table_t *table, const uint8_t *mac, uint16_t seq_ctrl, uint32_t ie_hash, uint32_t now_ms)
+{
+    uint32_t key = dedup_key(mac, seq_ctrl, ie_hash);
+    dedup_entry_t *victim = NULL;
+    uint32_t victim_age = 0;
+
+    table->checked++;
+    for (uint32_t i = 0; i < DEDUP_MAX_PROBE; i++)
+    {
+        dedup_entry_t *entry = &table->entries[(key + i) & table->mask];
+
+        /* slots are never emptied again, so nothing is stored past a never used slot; take it rather
+           than evict a frame still within the window */
+        if (entry->key == 0)
+        {
+            if (!victim || victim_age < table->window_ms)
+            {
+                victim = entry;
+            }
+            break;
+        }
+        uint32_t age = now_ms - entry->last_ms;
+        if (entry->key == key && entry->ie_hash == ie_hash && entry->seq_ctrl == seq_ctrl &&
+            memcmp(entry->mac, mac, sizeof(entry->mac)) == 0)
+        {
+            entry->last_ms = now_ms;
+            if (age < table->window_ms)
+            {
+                table->suppressed++;
+                return true;
+            }
+            return false;
+        }
+        /* reuse the first expired slot, otherwise the least recently seen one */
+        if (!victim || (victim_age < table->window_ms && age > victim_age))
+        {
+            victim = entry;
+            victim_age = age;
+        }
+    }
+
+    victim->key = key;
+    victim->ie_hash = ie_hash;
+    victim->last_ms = now_ms;
+    victim->seq_ctrl = seq_ctrl;
+    memcpy(victim->mac, mac, sizeof(victim->mac));
+    return false;
+}
@@ -0,0 +1,69 @@
+/* Duplicate suppression — declarations of the repeated probe request filter.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Slot of the duplicate table
+ *
+ */
+typedef struct {
+    uint32_t key;       /*!< Mixed hash of the whole key, 0 for a never used slot */
+    uint32_t ie_hash;   /*!< Hash of the information elements */
+    uint32_t last_ms;   /*!< Last time the frame was seen */
+    uint16_t seq_ctrl;  /*!< Sequence control field */
+    uint8_t mac[6];     /*!< Transmitter address */
+} dedup_entry_t;
+
+/**
+ * @brief Fixed-memory open-addressing table of recently seen frames
+ *
+ * A frame is a repeat if the same transmitter address, sequence control and information elements
+ * were seen less than window_ms ago. The table only forgets entries (when a probe run is full),
+ * so it may miss a repeat but never suppresses a new frame.
+ */
+typedef struct {
+    dedup_entry_t *entries; /*!< Caller-provided slots */
+    uint32_t mask;          /*!< Number of slots - 1, the slot count is a power of two */
+    uint32_t window_ms;     /*!< Suppression window */
+    uint32_t checked;       /*!< Frames looked up */
+    uint32_t suppressed;    /*!< Frames reported as repeats */
+} dedup_table_t;
+
+/**
+ * @brief Initialize the table over caller-provided slots
+ *
+ * @param table table to initialize
+ * @param entries slot storage
+ * @param count number of slots, must be a power of two
+ * @param window_ms frames repeated within this time are suppressed
+ */
+void dedup_init(dedup_table_t *table, dedup_entry_t *entries, uint32_t count, uint32_t window_ms);
+
+/**
+ * @brief Look a frame up and remember it
+ *
+ * @param table duplicate table
+ * @param mac transmitter address
+ * @param seq_ctrl sequence control field
+ * @param ie_hash hash of the information elements, see ie_hash()
+ * @param now_ms current time in milliseconds, may wrap
+ * @return true if the frame repeats one seen within the window and should be dropped
+ */
+bool dedup_check(dedup_table_t *table, const uint8_t *mac, uint16_t seq_ctrl, uint32_t ie_hash, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,36 @@
+/* File extent — space reservation for capture files written sequentially.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <unistd.h>
+#include "file_extent.h"
+
+esp_err_t file_extent_reserve(FILE *fp, uint32_t offset, uint32_t length)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (length == 0)
+    {
+        return ret;
+    }
+    /* seeking past the end of a file open for writing extends its cluster chain, the byte sets the size */
+    if (fseek(fp, offset + length - 1, SEEK_SET) != 0 || fputc(0, fp) == EOF || fflush(fp) != 0)
+    {
+        ret = ESP_FAIL;
+    }
+    if (fseek(fp, offset, SEEK_SET) != 0)
+    {
+        ret = ESP_FAIL;
+    }
+    return ret;
+}
+
+esp_err_t file_extent_trim(const char *path, uint32_t length)
+{
+    return truncate(path, length) == 0 ? ESP_OK : ESP_FAIL;
+}
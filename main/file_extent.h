@@ -0,0 +1,52 @@
+/* File extent — declarations of space reservation for capture files written sequentially.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reserve the space of a file ahead of the position it is written at
+ *
+ * Grows the file to offset + length bytes and returns to offset, so the file system allocates all clusters
+ * at once instead of one by one while the data is written. On FAT they are taken from the free space
+ * after the last allocation, i.e. contiguous unless the card is fragmented. The reserved bytes are
+ * not cleared: until written they hold whatever the card held, stale data of deleted files included.
+ * Zeroing them would write every byte twice; instead, reserve in bounded extents, so a power cut leaves
+ * at most one extent of such data after the last write, which pcaprecover tells from records.
+ * Trim the file with file_extent_trim() once it is closed.
+ *
+ * @param fp file opened for writing, positioned at offset, its end
+ * @param offset bytes written so far, 0 for a new file
+ * @param length bytes to reserve
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the file could not be grown, e.g. the card is full; it still can be written
+ */
+esp_err_t file_extent_reserve(FILE *fp, uint32_t offset, uint32_t length);
+
+/**
+ * @brief Cut a closed file to the bytes actually written, freeing the rest of its reserved space
+ *
+ * @param path file name
+ * @param length bytes written
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the file could not be truncated
+ */
+esp_err_t file_extent_trim(const char *path, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+/* FNV-1a — 32-bit hash shared by the duplicate filter, the IE walker and the LZB frame checksum.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FNV1A_OFFSET_BASIS  (2166136261u)   /*!< Hash of an empty buffer, seed of a new hash */
+#define FNV1A_PRIME         (16777619u)
+
+/**
+ * @brief Add one byte to a 32-bit FNV-1a hash
+ *
+ * @param hash hash so far, FNV1A_OFFSET_BASIS to start a new one
+ * @param byte byte to add
+ * @return updated hash
+ */
+static inline uint32_t fnv1a_byte(uint32_t hash, uint8_t byte)
+{
+    return (hash ^ byte) * FNV1A_PRIME;
+}
+
+/**
+ * @brief Add a buffer to a 32-bit FNV-1a hash
+ *
+ * @param hash hash so far, FNV1A_OFFSET_BASIS to start a new one
+ * @param data buffer to add
+ * @param length number of bytes
+ * @return updated hash
+ */
+static inline uint32_t fnv1a(uint32_t hash, const uint8_t *data, uint32_t length)
+{
+    while (length--)
+    {
+        hash = fnv1a_byte(hash, *data++);
+    }
+    return hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+/* Frame filter — rule table checked in the promiscuous callback before any copy.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "esp_wifi_types.h"
+#include "frame_filter.h"
+#include "config.h"
+
+static const uint32_t filter_oui_allow[] = CONFIG_FILTER_OUI_ALLOW_LIST;
+static const uint32_t filter_oui_deny[] = CONFIG_FILTER_OUI_DENY_LIST;
+
+#define FILTER_LIST_LEN(list)   (sizeof(list) / sizeof((list)[0]))
+
+_Static_assert(FILTER_LIST_LEN(filter_oui_deny) + FILTER_LIST_LEN(filter_oui_allow) + 1 <= FRAME_FILTER_MAX_RULES,
+               "too many OUIs in CONFIG_FILTER_OUI_ALLOW_LIST and CONFIG_FILTER_OUI_DENY_LIST");
+_Static_assert((CONFIG_FILTER_SUBTYPES & ~FRAME_FILTER_KEY_SUBTYPES) == 0, "CONFIG_FILTER_SUBTYPES has 16 bits");
+
+/* Add a FILTER_ANY/ONLY/EXCLUDE condition on one key bit */
+static void add_condition(frame_filter_rule_t *rule, uint64_t bit, int setting)
+{
+    if (setting != FILTER_ANY)
+    {
+        rule->mask |= bit;
+        rule->value |= setting == FILTER_ONLY ? bit : 0;
+    }
+}
+
+static void add_rule(frame_filter_t *filter, const frame_filter_rule_t *rule)
+{
+    filter->rules[filter->count++] = *rule;
+}
+
+void frame_filter_compile(frame_filter_t *filter)
+{
+    frame_filter_rule_t keep = {
+        .any = CONFIG_FILTER_SUBTYPES,
+        .min_rssi = CONFIG_FILTER_MIN_RSSI,
+        .keep = true,
+    };
+
+    memset(filter, 0, sizeof(*filter));
+    for (const uint32_t *oui = filter_oui_deny; oui < filter_oui_deny + FILTER_LIST_LEN(filter_oui_deny); oui++)
+    {
+        frame_filter_rule_t deny = {
+            .mask = FRAME_FILTER_KEY_OUI,
+            .value = (uint64_t)*oui << FRAME_FILTER_KEY_OUI_SHIFT,
+            .any = ~0ULL,
+            .min_rssi = INT32_MIN,
+            .keep = false,
+        };
+        add_rule(filter, &deny);
+    }
+
+    add_condition(&keep, FRAME_FILTER_KEY_LOCAL, CONFIG_FILTER_RANDOMIZED);
+    add_condition(&keep, FRAME_FILTER_KEY_WILDCARD, CONFIG_FILTER_WILDCARD_SSID);
+    add_condition(&keep, FRAME_FILTER_KEY_FCS_FAILED, CONFIG_FILTER_FCS_FAILED);
+    if (FILTER_LIST_LEN(filter_oui_allow) == 0)
+    {
+        add_rule(filter, &keep);
+    }
+    for (const uint32_t *oui = filter_oui_allow; oui < filter_oui_allow + FILTER_LIST_LEN(filter_oui_allow); oui++)
+    {
+        frame_filter_rule_t allow = keep;
+        allow.mask |= FRAME_FILTER_KEY_OUI;
+        allow.value |= (uint64_t)*oui << FRAME_FILTER_KEY_OUI_SHIFT;
+        add_rule(filter, &allow);
+    }
+    filter->fallback = false;
+
+    /* Only management frames reach the callback; failed ones only if a rule may keep them */
+    filter->promiscuous_mask = WIFI_PROMIS_FILTER_MASK_MGMT;
+    if (CONFIG_FILTER_FCS_FAILED != FILTER_EXCLUDE)
+    {
+        filter->promiscuous_mask |= WIFI_PROMIS_FILTER_MASK_FCSFAIL;
+    }
+}
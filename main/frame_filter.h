@@ -0,0 +1,110 @@
+/* Frame filter — declarations of the rule table checked in the promiscuous callback before any copy.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_FILTER_MAX_RULES          (16)
+
+/* Bits of the frame key, see frame_filter_key() */
+#define FRAME_FILTER_KEY_SUBTYPE(s)     (1ULL << (s))   /* management subtype, one bit each */
+#define FRAME_FILTER_KEY_SUBTYPES       (0xFFFFULL)
+#define FRAME_FILTER_KEY_LOCAL          (1ULL << 16)    /* locally administered (randomized) transmitter */
+#define FRAME_FILTER_KEY_WILDCARD       (1ULL << 17)    /* probe request for the wildcard SSID */
+#define FRAME_FILTER_KEY_FCS_FAILED     (1ULL << 18)
+#define FRAME_FILTER_KEY_OUI_SHIFT      (24)
+#define FRAME_FILTER_KEY_OUI            (0xFFFFFFULL << FRAME_FILTER_KEY_OUI_SHIFT)
+
+#define FRAME_FILTER_SUBTYPE_PROBE_REQ  (4)
+
+/**
+ * @brief One rule: matches when the masked key equals the value, the key has one of the any bits and
+ *        the frame is at least as strong as min_rssi
+ *
+ */
+typedef struct {
+    uint64_t mask;      /*!< Key bits compared */
+    uint64_t value;     /*!< Their required value */
+    uint64_t any;       /*!< At least one of these key bits must be set */
+    int32_t min_rssi;   /*!< Weaker frames do not match */
+    bool keep;          /*!< Verdict of a match */
+} frame_filter_rule_t;
+
+/**
+ * @brief Ordered rule table, the first matching rule decides
+ *
+ */
+typedef struct {
+    frame_filter_rule_t rules[FRAME_FILTER_MAX_RULES];
+    uint32_t count;
+    bool fallback;              /*!< Verdict when no rule matches */
+    uint32_t promiscuous_mask;  /*!< Matching driver filter, for esp_wifi_set_promiscuous_filter() */
+} frame_filter_t;
+
+/**
+ * @brief Build the table from the CONFIG_FILTER_* settings
+ *
+ * Denied OUIs come first, then one keep rule for every allowed OUI (or a single one without an allow
+ * list) carrying the subtype, address, SSID, FCS and signal conditions; anything else is dropped.
+ *
+ * @param[out] filter table to fill
+ */
+void frame_filter_compile(frame_filter_t *filter);
+
+/**
+ * @brief Pack what the rules look at into one word
+ *
+ * @param frame 802.11 frame, at least the 24-byte MAC header
+ * @param length frame length without FCS
+ * @param fcs_failed the driver reported a bad FCS
+ * @return key for frame_filter_match()
+ */
+static inline uint64_t frame_filter_key(const uint8_t *frame, uint32_t length, bool fcs_failed)
+{
+    uint32_t subtype = frame[0] >> 4;
+    bool management = (frame[0] & 0x0C) == 0;
+    bool wildcard = management && subtype == FRAME_FILTER_SUBTYPE_PROBE_REQ && length >= 26 &&
+                    frame[24] == 0 && frame[25] == 0;
+
+    return ((uint64_t)(frame[10] << 16 | frame[11] << 8 | frame[12]) << FRAME_FILTER_KEY_OUI_SHIFT) |
+           (FRAME_FILTER_KEY_SUBTYPE(subtype) * management) |
+           (FRAME_FILTER_KEY_LOCAL * ((frame[10] & 0x02) != 0)) |
+           (FRAME_FILTER_KEY_WILDCARD * wildcard) |
+           (FRAME_FILTER_KEY_FCS_FAILED * fcs_failed);
+}
+
+/**
+ * @brief Run the rules over a frame
+ *
+ * @param filter compiled table
+ * @param key frame key, see frame_filter_key()
+ * @param rssi signal strength of the frame
+ * @return true to keep the frame
+ */
+static inline bool frame_filter_match(const frame_filter_t *filter, uint64_t key, int32_t rssi)
+{
+    for (uint32_t i = 0; i < filter->count; i++)
+    {
+        const frame_filter_rule_t *rule = &filter->rules[i];
+        if (((key & rule->mask) == rule->value) & ((key & rule->any) != 0) & (rssi >= rule->min_rssi))
+        {
+            return rule->keep;
+        }
+    }
+    return filter->fallback;
+}
+
+#ifdef __cplusplus
+}
+#endif
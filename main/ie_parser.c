@@ -0,0 +1,109 @@
+/* IE parser — probe request information element walker and device fingerprint.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "ie_parser.h"
+#include "fnv1a.h"
+
+#define IE_HEADER_LEN       (2)
+#define IE_OUI_LEN          (3)
+
+uint32_t ie_hash(const uint8_t *data, uint32_t length)
+{
+    return fnv1a(FNV1A_OFFSET_BASIS, data, length);
+}
+
+bool ie_parse_probe(const uint8_t *ies, uint32_t length, ie_probe_info_t *info)
+{
+    const uint8_t *pos = ies;
+    const uint8_t *end = ies + length;
+    uint32_t fingerprint = FNV1A_OFFSET_BASIS;
+
+    memset(info, 0, sizeof(*info));
+    while (end - pos >= IE_HEADER_LEN)
+    {
+        uint8_t id = pos[0];
+        uint8_t len = pos[1];
+        const uint8_t *body = pos + IE_HEADER_LEN;
+
+        if (end - body < len)
+        {
+            info->malformed = true;
+            break;
+        }
+        if (info->element_count < UINT8_MAX)
+        {
+            info->element_count++;
+        }
+        /* element order is characteristic of the driver, the per-probe values are not */
+        fingerprint = fnv1a_byte(fingerprint, id);
+        switch (id)
+        {
+        case IE_ID_SSID:
+            info->ssid.data = body;
+            info->ssid.length = len;
+            break;
+        case IE_ID_DS_PARAMETER_SET:
+            break;
+        case IE_ID_SUPPORTED_RATES:
+            info->rates.data = body;
+            info->rates.length = len;
+            fingerprint = fnv1a(fingerprint, body, len);
+            break;
+        case IE_ID_EXTENDED_RATES:
+            info->ext_rates.data = body;
+            info->ext_rates.length = len;
+            fingerprint = fnv1a(fingerprint, body, len);
+            break;
+        case IE_ID_HT_CAPABILITIES:
+            info->ht_caps.data = body;
+            info->ht_caps.length = len;
+            fingerprint = fnv1a(fingerprint, body, len);
+            break;
+        case IE_ID_VHT_CAPABILITIES:
+            info->vht_caps.data = body;
+            info->vht_caps.length = len;
+            fingerprint = fnv1a(fingerprint, body, len);
+            break;
+        case IE_ID_EXTENDED_CAPS:
+            info->ext_caps.data = body;
+            info->ext_caps.length = len;
+            fingerprint = fnv1a(fingerprint, body, len);
+            break;
+        case IE_ID_VENDOR_SPECIFIC:
+            /* only the OUI and vendor type, the rest often carries per-probe data (e.g. WPS UUID) */
+            if (len > IE_OUI_LEN)
+            {
+                uint32_t vendor = (uint32_t)body[0] << 24 | (uint32_t)body[1] << 16 | (uint32_t)body[2] << 8 | body[3];
+                if (info->vendor_count < IE_MAX_VENDORS)
+                {
+                    info->vendors[info->vendor_count++] = vendor;
+                }
+                fingerprint = fnv1a(fingerprint, body, IE_OUI_LEN + 1);
+            }
+            break;
+        case IE_ID_EXTENSION:
+            /* the element ID extension tells e.g. HE capabilities apart */
+            if (len > 0)
+            {
+                fingerprint = fnv1a_byte(fingerprint, body[0]);
+            }
+            break;
+        default:
+            break;
+        }
+        pos = body + len;
+    }
+    /* a trailing single byte can't hold an element header */
+    if (pos != end)
+    {
+        info->malformed = true;
+    }
+    info->fingerprint = fingerprint;
+    return !info->malformed;
+}
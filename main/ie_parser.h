@@ -0,0 +1,83 @@
+/* IE parser — declarations of the probe request information element walker.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IE_ID_SSID              (0)
+#define IE_ID_SUPPORTED_RATES   (1)
+#define IE_ID_DS_PARAMETER_SET  (3)
+#define IE_ID_HT_CAPABILITIES   (45)
+#define IE_ID_EXTENDED_RATES    (50)
+#define IE_ID_EXTENDED_CAPS     (127)
+#define IE_ID_VHT_CAPABILITIES  (191)
+#define IE_ID_VENDOR_SPECIFIC   (221)
+#define IE_ID_EXTENSION         (255)
+
+#define IE_MAX_VENDORS          (8)
+
+/**
+ * @brief Pointer into the frame and length of one information element body
+ *
+ */
+typedef struct {
+    const uint8_t *data;    /*!< First byte of the element body, NULL if the element is absent */
+    uint8_t length;         /*!< Length of the element body */
+} ie_field_t;
+
+/**
+ * @brief Elements of a probe request relevant for device identification
+ *
+ * All fields point into the parsed buffer, nothing is copied.
+ */
+typedef struct {
+    ie_field_t ssid;                        /*!< SSID, length 0 for a broadcast (wildcard) probe */
+    ie_field_t rates;                       /*!< Supported rates */
+    ie_field_t ext_rates;                   /*!< Extended supported rates */
+    ie_field_t ht_caps;                     /*!< HT capabilities */
+    ie_field_t vht_caps;                    /*!< VHT capabilities */
+    ie_field_t ext_caps;                    /*!< Extended capabilities */
+    uint32_t vendors[IE_MAX_VENDORS];       /*!< Vendor elements as OUI << 8 | vendor type, in frame order */
+    uint8_t vendor_count;                   /*!< Number of vendor elements stored in vendors */
+    uint8_t element_count;                  /*!< Number of elements in the frame, at most 255 */
+    bool malformed;                         /*!< An element overran the buffer, parsing stopped there */
+    uint32_t fingerprint;                   /*!< Hash of the device-specific elements, see ie_parse_probe() */
+} ie_probe_info_t;
+
+/**
+ * @brief Walk the information elements of a probe request and compute its device fingerprint
+ *
+ * The fingerprint covers element order, rates, HT/VHT/extended capabilities and vendor OUIs, but not
+ * the values that change from probe to probe of the same device (SSID, DS parameter set channel).
+ * Never reads outside [ies, ies + length), whatever the content.
+ *
+ * @param ies first byte after the 24-byte MAC header
+ * @param length number of bytes of information elements (without FCS)
+ * @param[out] info parsed elements
+ * @return true if the whole buffer was a well-formed element list
+ */
+bool ie_parse_probe(const uint8_t *ies, uint32_t length, ie_probe_info_t *info);
+
+/**
+ * @brief 32-bit FNV-1a hash of a buffer, e.g. an SSID
+ *
+ * @param data buffer to hash
+ * @param length number of bytes
+ * @return hash, the FNV offset basis for an empty buffer
+ */
+uint32_t ie_hash(const uint8_t *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,124 @@
+/* Latency — log-bucketed histograms of the time spent in each capture stage.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "latency.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+#else
+#include <stdio.h>
+#endif
+
+#define LATENCY_SUB_MASK            ((1u << LATENCY_SUB_BITS) - 1)
+
+static inline uint32_t latency_bucket(uint32_t ticks)
+{
+    if (ticks < (1u << LATENCY_SUB_BITS))
+    {
+        return ticks;
+    }
+    uint32_t shift = 31 - __builtin_clz(ticks) - LATENCY_SUB_BITS;
+    return ((shift + 1) << LATENCY_SUB_BITS) | ((ticks >> shift) & LATENCY_SUB_MASK);
+}
+
+/* Largest value falling into a bucket */
+static uint32_t latency_bucket_limit(uint32_t bucket)
+{
+    if (bucket < (1u << LATENCY_SUB_BITS))
+    {
+        return bucket;
+    }
+    uint32_t shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t lower = (uint64_t)((1u << LATENCY_SUB_BITS) | (bucket & LATENCY_SUB_MASK)) << shift;
+    return lower + (1ull << shift) - 1;
+}
+
+/* Value below which permille/1000 of the samples fall, at bucket resolution */
+static uint32_t latency_percentile(const latency_histogram_t *histogram, uint32_t permille)
+{
+    uint32_t rank = ((uint64_t)histogram->count * permille + 999) / 1000;
+    uint32_t seen = 0;
+
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t limit = latency_bucket_limit(i);
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void latency_histogram_add(latency_histogram_t *histogram, uint32_t ticks)
+{
+    histogram->buckets[latency_bucket(ticks)]++;
+    histogram->count++;
+    histogram->total += ticks;
+    if (ticks > histogram->max)
+    {
+        histogram->max = ticks;
+    }
+}
+
+void latency_histogram_summary(const latency_histogram_t *histogram, uint32_t ticks_per_us,
+                               latency_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (histogram->count == 0)
+    {
+        return;
+    }
+    summary->count = histogram->count;
+    summary->mean = (float)histogram->total / histogram->count / ticks_per_us;
+    summary->p50 = (float)latency_percentile(histogram, 500) / ticks_per_us;
+    summary->p99 = (float)latency_percentile(histogram, 990) / ticks_per_us;
+    summary->max = (float)histogram->max / ticks_per_us;
+}
+
+#if CONFIG_LATENCY_ENABLED
+
+static latency_histogram_t latency_stages[LATENCY_STAGE_COUNT];
+static const char *latency_stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_CALLBACK] = "callback",
+    [LATENCY_QUEUE] = "ring wait",
+    [LATENCY_CAPTURE] = "capture",
+    [LATENCY_WRITE] = "block write",
+    [LATENCY_COMMIT] = "file sync",
+};
+
+void latency_record(latency_stage_t stage, uint32_t ticks)
+{
+    latency_histogram_add(&latency_stages[stage], ticks);
+}
+
+void latency_get(latency_stage_t stage, latency_summary_t *summary)
+{
+    latency_histogram_summary(&latency_stages[stage], LATENCY_TICKS_PER_US, summary);
+}
+
+void latency_log(void)
+{
+    latency_summary_t summary;
+
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        latency_get(i, &summary);
+#ifdef ESP_PLATFORM
+        ESP_LOGI("latency", "%-11s %8u samples, p50 %.1f us, p99 %.1f us, max %.1f us", latency_stage_names[i],
+                 summary.count, summary.p50, summary.p99, summary.max);
+#else
+        printf("%-11s %8u samples, p50 %.1f us, p99 %.1f us, max %.1f us\n", latency_stage_names[i],
+               summary.count, summary.p50, summary.p99, summary.max);
+#endif
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+/* Latency — log-bucketed histograms of the time spent in each capture stage.
+
+   Stages are timed with the CPU cycle counter on the ESP32 and with the monotonic clock in nanoseconds on
+   the host, so the same histograms work in host tools and simulation. Every histogram takes fixed memory and
+   is only updated from one task. With CONFIG_LATENCY_ENABLED set to 0 the instrumentation compiles out.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "config.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#else
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Each power of two is split into 2^LATENCY_SUB_BITS buckets, i.e. values are kept within 25% */
+#define LATENCY_SUB_BITS            (2)
+#define LATENCY_BUCKETS             ((32 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+#ifdef ESP_PLATFORM
+#define LATENCY_TICKS_PER_US        (CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ)
+#else
+#define LATENCY_TICKS_PER_US        (1000)
+#endif
+
+/**
+ * @brief Timed stages of the capture pipeline
+ *
+ */
+typedef enum {
+    LATENCY_CALLBACK = 0,   /*!< Inside the promiscuous callback */
+    LATENCY_QUEUE,          /*!< From the ring commit until the sniffer task takes the frame */
+    LATENCY_CAPTURE,        /*!< Encoding the frame into the write blocks */
+    LATENCY_WRITE,          /*!< Writing one block to the card */
+    LATENCY_COMMIT,         /*!< Syncing the file to the card (group commit) */
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+/**
+ * @brief Histogram of one stage, in ticks
+ *
+ */
+typedef struct {
+    uint32_t count;                     /*!< Samples recorded */
+    uint32_t max;                       /*!< Longest sample */
+    uint64_t total;                     /*!< Sum of all samples */
+    uint32_t buckets[LATENCY_BUCKETS];  /*!< Samples per bucket, see latency_bucket() */
+} latency_histogram_t;
+
+/**
+ * @brief Percentiles of one stage, in microseconds
+ *
+ */
+typedef struct {
+    uint32_t count;     /*!< Samples recorded */
+    float mean;         /*!< Average */
+    float p50;          /*!< Median, upper bound of its bucket */
+    float p99;          /*!< 99th percentile, upper bound of its bucket */
+    float max;          /*!< Longest sample */
+} latency_summary_t;
+
+/**
+ * @brief Current time in ticks, wraps around
+ *
+ */
+static inline uint32_t latency_ticks(void)
+{
+#ifdef ESP_PLATFORM
+    return esp_cpu_get_ccount();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000000u + (uint32_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Add a sample to a histogram
+ *
+ * @param histogram histogram
+ * @param ticks sample
+ */
+void latency_histogram_add(latency_histogram_t *histogram, uint32_t ticks);
+
+/**
+ * @brief Percentiles of a histogram
+ *
+ * @param histogram histogram
+ * @param ticks_per_us tick rate of the samples
+ * @param[out] summary percentiles in microseconds, all 0 without samples
+ */
+void latency_histogram_summary(const latency_histogram_t *histogram, uint32_t ticks_per_us,
+                               latency_summary_t *summary);
+
+#if CONFIG_LATENCY_ENABLED
+
+/**
+ * @brief Add a sample to the histogram of a pipeline stage, only from the task running the stage
+ *
+ * @param stage stage
+ * @param ticks duration of the stage
+ */
+void latency_record(latency_stage_t stage, uint32_t ticks);
+
+/**
+ * @brief Percentiles of a pipeline stage
+ *
+ * @param stage stage
+ * @param[out] summary percentiles in microseconds
+ */
+void latency_get(latency_stage_t stage, latency_summary_t *summary);
+
+/**
+ * @brief Log p50/p99/max of all pipeline stages
+ *
+ */
+void latency_log(void);
+
+#define LATENCY_START(name)         uint32_t name = latency_ticks()
+#define LATENCY_END(stage, name)    latency_record(stage, latency_ticks() - (name))
+
+#else
+
+#define LATENCY_START(name)
+#define LATENCY_END(stage, name)
+#define latency_log()
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,219 @@
+/* LZB — small LZ77 block codec in the LZ4 block format.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <string.h>
+#include "lzb.h"
+#include "fnv1a.h"
+
+#define LZB_MIN_MATCH       (4)
+#define LZB_LAST_LITERALS   (5)     /* a block always ends with at least this many literals */
+#define LZB_MF_LIMIT        (12)    /* the last match starts at least this many bytes before the end */
+#define LZB_MAX_OFFSET      (0xFFFF)
+#define LZB_RUN_MASK        (0x0F)
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash4(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - LZB_HASH_BITS);
+}
+
+/* Length beyond the 4-bit token field: 255 per byte until a byte below 255 */
+static uint8_t *put_length(uint8_t *op, uint32_t length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+/* Extra bytes put_length() needs for a length that does not fit into the token */
+static inline uint32_t length_bytes(uint32_t length)
+{
+    return length >= LZB_RUN_MASK ? (length - LZB_RUN_MASK) / 255 + 1 : 0;
+}
+
+uint32_t lzb_compress(const uint8_t *src, uint32_t length, uint8_t *dst, uint32_t capacity, uint16_t *table)
+{
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *iend = src + length;
+    const uint8_t *match_limit = iend - LZB_LAST_LITERALS;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + capacity;
+
+    if (length > LZB_MAX_BLOCK_SIZE)
+    {
+        return 0;
+    }
+    memset(table, 0, LZB_TABLE_SIZE * sizeof(uint16_t));
+    if (length >= LZB_MF_LIMIT + 1)
+    {
+        const uint8_t *mf_limit = iend - LZB_MF_LIMIT;
+        while (ip <= mf_limit)
+        {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash4(sequence);
+            const uint8_t *ref = src + table[h];
+
+            table[h] = (uint16_t)(ip - src);
+            /* an empty slot points at the block start, the compare rejects it unless it really matches */
+            if (ref >= ip || ip - ref > LZB_MAX_OFFSET || read32(ref) != sequence)
+            {
+                ip++;
+                continue;
+            }
+            const uint8_t *end = ip + LZB_MIN_MATCH;
+            ref += LZB_MIN_MATCH;
+            while (end < match_limit && *end == *ref)
+            {
+                end++;
+                ref++;
+            }
+            uint32_t literals = ip - anchor;
+            uint32_t match = end - ip - LZB_MIN_MATCH;
+            uint32_t offset = end - ref;
+            if (1 + length_bytes(literals) + literals + 2 + length_bytes(match) > (uint32_t)(oend - op))
+            {
+                return 0;
+            }
+            uint8_t *token = op++;
+            if (literals >= LZB_RUN_MASK)
+            {
+                *token = LZB_RUN_MASK << 4;
+                op = put_length(op, literals - LZB_RUN_MASK);
+            }
+            else
+            {
+                *token = literals << 4;
+            }
+            memcpy(op, anchor, literals);
+            op += literals;
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+            if (match >= LZB_RUN_MASK)
+            {
+                *token |= LZB_RUN_MASK;
+                op = put_length(op, match - LZB_RUN_MASK);
+            }
+            else
+            {
+                *token |= match;
+            }
+            ip = end;
+            anchor = ip;
+        }
+    }
+
+    uint32_t literals = iend - anchor;
+    if (1 + length_bytes(literals) + literals > (uint32_t)(oend - op))
+    {
+        return 0;
+    }
+    if (literals >= LZB_RUN_MASK)
+    {
+        *op++ = LZB_RUN_MASK << 4;
+        op = put_length(op, literals - LZB_RUN_MASK);
+    }
+    else
+    {
+        *op++ = literals << 4;
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+    return op - dst;
+}
+
+/* Length continued in extra bytes; false if the input ends first */
+static bool get_length(const uint8_t **ip, const uint8_t *iend, uint32_t *length)
+{
+    uint8_t byte;
+
+    do
+    {
+        if (*ip >= iend)
+        {
+            return false;
+        }
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+int32_t lzb_decompress(const uint8_t *src, uint32_t length, uint8_t *dst, uint32_t capacity)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + length;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + capacity;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+        uint32_t literals = token >> 4;
+        if (literals == LZB_RUN_MASK && !get_length(&ip, iend, &literals))
+        {
+            return -1;
+        }
+        if (literals > (uint32_t)(iend - ip) || literals > (uint32_t)(oend - op))
+        {
+            return -1;
+        }
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == iend)
+        {
+            /* the last sequence has no match */
+            break;
+        }
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+        uint32_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst))
+        {
+            return -1;
+        }
+        uint32_t match = token & LZB_RUN_MASK;
+        if (match == LZB_RUN_MASK && !get_length(&ip, iend, &match))
+        {
+            return -1;
+        }
+        match += LZB_MIN_MATCH;
+        if (match > (uint32_t)(oend - op))
+        {
+            return -1;
+        }
+        /* byte by byte, the match may overlap the bytes it produces */
+        const uint8_t *ref = op - offset;
+        while (match--)
+        {
+            *op++ = *ref++;
+        }
+    }
+    return op - dst;
+}
+
+uint32_t lzb_checksum(const uint8_t *data, uint32_t length)
+{
+    return fnv1a(FNV1A_OFFSET_BASIS, data, length);
+}
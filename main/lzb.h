@@ -0,0 +1,77 @@
+/* LZB — small LZ77 block codec and the framing of compressed capture files.
+
+   Blocks use the LZ4 block format (token, literals, 16-bit offset, match length), the compressor needs
+   only its hash table. A compressed file is a sequence of frames, each an lzb_frame_header_t followed by
+   one independently decodable block, so everything before a damaged frame and after the next intact
+   frame header can still be recovered. Shared by the firmware and the host tools in tools/, keep it free
+   of ESP-IDF headers.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LZB_FRAME_MAGIC         (0x31425A4C) /* "LZB1" read as little-endian bytes */
+#define LZB_HASH_BITS           (12)
+#define LZB_TABLE_SIZE          (1 << LZB_HASH_BITS)    /* entries of the compressor hash table */
+#define LZB_MAX_BLOCK_SIZE      (0xFFFF)                /* positions in the hash table are 16-bit */
+
+/**
+ * @brief Header in front of every block of a compressed file
+ *
+ * All fields are little-endian. A frame whose stored length equals its raw length holds the data
+ * uncompressed, the compressor only keeps output shorter than the input.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             /*!< LZB_FRAME_MAGIC, lets readers find the next frame after damage */
+    uint32_t raw_length;        /*!< Length of the data after decompression */
+    uint32_t stored_length;     /*!< Number of bytes following the header */
+    uint32_t checksum;          /*!< lzb_checksum() of the data after decompression */
+} lzb_frame_header_t;
+
+_Static_assert(sizeof(lzb_frame_header_t) == 16, "compressed frame header layout changed");
+
+/**
+ * @brief Compress one block
+ *
+ * @param src data to compress, at most LZB_MAX_BLOCK_SIZE bytes
+ * @param length number of bytes at src
+ * @param[out] dst compressed block
+ * @param capacity size of dst
+ * @param table LZB_TABLE_SIZE entries of scratch memory
+ * @return length of the compressed block, 0 if it does not fit into capacity
+ */
+uint32_t lzb_compress(const uint8_t *src, uint32_t length, uint8_t *dst, uint32_t capacity, uint16_t *table);
+
+/**
+ * @brief Decompress one block, never reading or writing outside the given buffers
+ *
+ * @param src compressed block
+ * @param length number of bytes at src
+ * @param[out] dst decompressed data
+ * @param capacity size of dst
+ * @return length of the decompressed data, -1 if the block is corrupt or does not fit into capacity
+ */
+int32_t lzb_decompress(const uint8_t *src, uint32_t length, uint8_t *dst, uint32_t capacity);
+
+/**
+ * @brief Checksum of the uncompressed data of a frame (32-bit FNV-1a)
+ *
+ * @param data buffer to hash
+ * @param length number of bytes
+ * @return checksum
+ */
+uint32_t lzb_checksum(const uint8_t *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,35 +25,50 @@
 #include "wifi_connect.h"
 #include "esp_sntp.h"
 #include "pcap_lib.h"
+#include "manifest.h"
+#include "channel_hop.h"
 #include "sniffer.h"
+#include "telemetry.h"
+#include "latency.h"
+#include "time_sync.h"
 
 /* Defines -------------------------------------------------------------------*/
 #define ESP_INTR_FLAG_DEFAULT 0
+#define TELEMETRY_PATH CONFIG_SD_MOUNT_POINT"/"CONFIG_TELEMETRY_FILENAME
+#define TIME_SYNC_PATH CONFIG_SD_MOUNT_POINT"/"CONFIG_TIME_SYNC_FILENAME
 
 /* Global variables-----------------------------------------------------------*/
 static const char *TAG = "main";
 
 static volatile bool stop_probing = false;
-static volatile bool change_file = false;
 static bool sd_mounted = false;
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+static sdmmc_card_t sd_card;
+static block_dev_t sd_dev;
+#endif
 static xQueueHandle gpio_evt_queue = NULL;
 
 /* Function prototypes -------------------------------------------------------*/
+#if !CONFIG_FAST_BOOT_ENABLED
 static void obtain_time(void);
+static void initialize_sntp(void);
+#endif
 static void initialize_gpio(void);
 static void initialize_nvs(void);
-static void initialize_sntp(void);
 static void initialize_wifi(void);
 static bool mount_sd(void);
 static bool unmount_sd(void);
-static uint32_t get_file_index(uint32_t max_files);
+static void log_pipeline_stats(void);
+static void dump_telemetry(void);
+static bool log_time_events(void);
+static void append_time_event(uint32_t uptime_ms, const char *event, time_source_t source, int64_t time_us,
+                              int64_t correction_us);
 
 /* Interrupt service prototypes ----------------------------------------------*/
 static void IRAM_ATTR gpio_isr_handler(void* arg);
 
 /* Task prototypes -----------------------------------------------------------*/
 static void gpio_task(void* arg);
-static void save_task(void* arg);
 
 /* Main function -------------------------------------------------------------*/
 void app_main(void)
@@ -62,11 +77,17 @@ void app_main(void)
     struct tm timeinfo;
     char strftime_buf[64];
     uint32_t file_idx = 0;
+    time_t next_telemetry;
 
     // Initialize peripherals and time
     initialize_gpio();
     initialize_nvs();
+#if CONFIG_FAST_BOOT_ENABLED
+    // Approximate time now, SNTP corrects it in the background once capturing
+    time_sync_restore();
+#else
     obtain_time();
+#endif
 
     // update 'current_time' variable with current time
     time(&current_time);
@@ -85,19 +106,30 @@ void app_main(void)
     {
         return;
     }
-    file_idx = get_file_index(65535);
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+    // Continue the segment log after its last intact segment
+    ESP_ERROR_CHECK(pcap_attach_log(&sd_dev, esp_random(), &file_idx));
+#else
+    ESP_ERROR_CHECK(manifest_get_next_index(&file_idx));
+#endif
 
     // Open first pcap file
     ESP_ERROR_CHECK(pcap_open(file_idx));
     initialize_wifi();
     initialize_sniffer();
     ESP_ERROR_CHECK(sniffer_start());
-    
-    //start periodical save task
-    xTaskCreate(save_task, "save_task", 1024, NULL, 10, NULL);
+    // File rotation is driven by the policy in pcap_lib (CONFIG_PCAP_ROTATE_*)
+#if CONFIG_FAST_BOOT_ENABLED
+    if (time_sync_start() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "time sync not started, timestamps stay on the %s time",
+                 time_sync_source_name(time_sync_source()));
+    }
+#endif
 
     // Turn off LED when set up ends
     ESP_ERROR_CHECK(gpio_set_level(CONFIG_GPIO_LED_PIN, CONFIG_GPIO_LED_OFF));
+    next_telemetry = time(NULL) + CONFIG_TELEMETRY_INTERVAL_S;
 
     while(true)
     {
@@ -108,8 +140,14 @@ void app_main(void)
             if (sd_mounted == true)
             {
                 // Close current pcap and unmount SD
+                log_pipeline_stats();
                 ESP_ERROR_CHECK(sniffer_stop());
                 ESP_ERROR_CHECK(pcap_close());
+                dump_telemetry();
+                log_time_events();
+#if CONFIG_FAST_BOOT_ENABLED
+                time_sync_save();
+#endif
                 sd_mounted = unmount_sd();
             }
 
@@ -117,14 +155,19 @@ void app_main(void)
             ESP_ERROR_CHECK(gpio_set_level(CONFIG_GPIO_LED_PIN, CONFIG_GPIO_LED_ON));
             return;
         }
-        else if (change_file == true)
-        {
-            ESP_ERROR_CHECK(sniffer_stop());
-            ESP_ERROR_CHECK(pcap_close());
-            ESP_ERROR_CHECK(pcap_open(++file_idx));
-            ESP_ERROR_CHECK(sniffer_start());
 
-            change_file = false;
+        // Counters are dumped from here so no file is open on the card when it gets unmounted
+        time_t now = time(NULL);
+        if (now >= next_telemetry)
+        {
+            dump_telemetry();
+            next_telemetry = now + CONFIG_TELEMETRY_INTERVAL_S;
+        }
+        if (log_time_events())
+        {
+            // A deadline from before a clock step would fire at once or wait out the step
+            next_telemetry = time(NULL) + CONFIG_TELEMETRY_INTERVAL_S;
+            sniffer_clock_stepped();
         }
 
         vTaskDelay(10);
@@ -152,19 +195,6 @@ static void gpio_task(void* arg)
     }
 }
 
-static void save_task(void* arg)
-{
-    const TickType_t xDelay = (1000 * 60 * CONFIG_SAVE_FREQUENCY_MINUTES) / portTICK_PERIOD_MS;
-
-    while(stop_probing == false)
-    {
-        vTaskDelay(xDelay);
-        change_file = true;
-    }
-
-    vTaskDelete(NULL);
-}
-
 /* Function definitions ------------------------------------------------------*/
 static void initialize_gpio(void)
 {
@@ -205,13 +235,6 @@ static void initialize_nvs(void)
     ESP_ERROR_CHECK(err);
 }
 
-static void initialize_sntp(void)
-{
-    sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    sntp_setservername(0, "pool.ntp.org");
-    sntp_init();
-}
-
 static void initialize_wifi(void)
 {
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -221,6 +244,14 @@ static void initialize_wifi(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_NULL));
 }
 
+#if !CONFIG_FAST_BOOT_ENABLED
+static void initialize_sntp(void)
+{
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, "pool.ntp.org");
+    sntp_init();
+}
+
 static void obtain_time(void)
 {
     ESP_ERROR_CHECK(esp_netif_init());
@@ -238,19 +269,12 @@ static void obtain_time(void)
 
     ESP_ERROR_CHECK(wifi_disconnect() );
 }
+#endif
 
 static bool mount_sd(void)
 {
     esp_err_t ret;
     ESP_LOGI(TAG, "Initializing SD card");
-    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
-        .format_if_mount_failed = false,
-        .max_files = 4,
-        .allocation_unit_size = 16 * 1024
-    };
-
-    // initialize SD card and mount FAT filesystem.
-    sdmmc_card_t *card;
 
     ESP_LOGI(TAG, "Using SDMMC peripheral");
     sdmmc_host_t host = SDMMC_HOST_DEFAULT();
@@ -274,6 +298,36 @@ static bool mount_sd(void)
     ESP_ERROR_CHECK(gpio_set_pull_mode(GPIO_NUM_2, GPIO_PULLUP_ONLY));  // D0, needed in 4- and 1-line modes
     ESP_ERROR_CHECK(gpio_set_pull_mode(GPIO_NUM_13, GPIO_PULLUP_ONLY)); // D3, needed in 4- and 1-line modes
 
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+    // initialize SD card without a filesystem, the segment log writes its sectors directly
+    ret = sdmmc_host_init();
+    if (ret == ESP_OK)
+    {
+        ret = sdmmc_host_init_slot(host.slot, &slot_config);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = sdmmc_card_init(&host, &sd_card);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize the card (%s). "
+                    "Make sure SD card lines have pull-up resistors in place.",
+                    esp_err_to_name(ret));
+        sdmmc_host_deinit();
+        return false;
+    }
+    block_dev_sdmmc_init(&sd_dev, &sd_card);
+    return true;
+#else
+    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        .max_files = 5,
+        .allocation_unit_size = 16 * 1024
+    };
+
+    // initialize SD card and mount FAT filesystem.
+    sdmmc_card_t *card;
     const char mount_point[] = CONFIG_SD_MOUNT_POINT;
 
     ret = esp_vfs_fat_sdmmc_mount(mount_point, &host, &slot_config, &mount_config, &card);
@@ -295,31 +349,168 @@ static bool mount_sd(void)
     }
 
     return true;
+#endif
 }
 
 static bool unmount_sd(void)
 {
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+    // every segment is on the card once written, nothing to flush
+    sdmmc_host_deinit();
+    ESP_LOGI(TAG, "Card released");
+#else
     if (esp_vfs_fat_sdmmc_unmount() != ESP_OK) {
         ESP_LOGE(TAG, "Card unmount failed");
         return sd_mounted;
     }
     ESP_LOGI(TAG, "Card unmounted");
+#endif
     return false;
 }
 
-static uint32_t get_file_index(uint32_t max_files)
+static void log_pipeline_stats(void)
 {
-    uint32_t idx;
-    char filename[CONFIG_FATFS_MAX_LFN];
+    sniffer_pipeline_stats_t stats;
+
+    sniffer_get_pipeline_stats(&stats);
+    ESP_LOGI(TAG, "ingest->parse ring: %u/%u bytes (peak %u), %u dropped",
+             stats.ring_used, stats.ring_size, stats.ring_peak, stats.ring_dropped);
+    ESP_LOGI(TAG, "parse->storage blocks: %u/%u (peak %u), %u parse stalls",
+             stats.blocks_queued, stats.block_count, stats.blocks_peak, stats.parse_stalls);
+    ESP_LOGI(TAG, "file rotations: %u, frames dropped during rotations: %u, file syncs: %u",
+             stats.rotations, stats.rotation_drops, stats.commits);
+    ESP_LOGI(TAG, "duplicates: %u of %u frames suppressed, %u malformed frames",
+             stats.dedup_suppressed, stats.dedup_checked, stats.ie_malformed);
+    ESP_LOGI(TAG, "trimmed frames: %u, %u bytes not copied", stats.trimmed, stats.trimmed_bytes);
+    ESP_LOGI(TAG, "receive clock: skew %d ppb, %u updates, %u clock steps, last correction %d us",
+             stats.clock_skew_ppb, stats.clock_refits, stats.clock_steps, stats.clock_correction_us);
+    if (stats.compressed_in > 0)
+    {
+        ESP_LOGI(TAG, "compression: %u -> %u bytes (%u%%)", stats.compressed_in, stats.compressed_out,
+                 (uint32_t)((uint64_t)stats.compressed_out * 100 / stats.compressed_in));
+    }
 
-    for(idx = 0; idx < max_files; idx++)
+    channel_hop_stats_t channels[CHANNEL_HOP_MAX_CHANNELS];
+    uint32_t count = channel_hop_get_stats(channels, CHANNEL_HOP_MAX_CHANNELS);
+    for (uint32_t i = 0; i < count; i++)
     {
-        sprintf(filename, CONFIG_SD_MOUNT_POINT"/"CONFIG_PCAP_FILENAME_MASK, idx);
-        if (access(filename, F_OK) != 0)
+        ESP_LOGI(TAG, "channel %u: %u frames in %u ms, %u frames/s, dwell %u ms", channels[i].channel,
+                 channels[i].frames, channels[i].time_ms, channels[i].rate, channels[i].dwell_ms);
+    }
+    latency_log();
+}
+
+static void dump_telemetry(void)
+{
+    uint64_t counters[TELEMETRY_COUNTER_COUNT];
+    sniffer_pipeline_stats_t stats;
+    uint32_t heap_free = esp_get_free_heap_size();
+    uint32_t heap_min = esp_get_minimum_free_heap_size();
+    struct stat st;
+
+    telemetry_snapshot(counters);
+    sniffer_get_pipeline_stats(&stats);
+    ESP_LOGI(TAG, "frames: %llu seen, %llu filtered, %llu duplicates, %llu queued (%llu as summaries), "
+             "%llu written; dropped: %llu ring full, %llu write failed, %llu sampled out; %llu bytes written",
+             (unsigned long long)counters[TELEMETRY_FRAMES_SEEN],
+             (unsigned long long)counters[TELEMETRY_FRAMES_FILTERED],
+             (unsigned long long)counters[TELEMETRY_FRAMES_DUPLICATE],
+             (unsigned long long)counters[TELEMETRY_FRAMES_QUEUED],
+             (unsigned long long)counters[TELEMETRY_FRAMES_SUMMARIZED],
+             (unsigned long long)counters[TELEMETRY_FRAMES_WRITTEN],
+             (unsigned long long)counters[TELEMETRY_DROP_RING_FULL],
+             (unsigned long long)counters[TELEMETRY_DROP_WRITE_FAILED],
+             (unsigned long long)counters[TELEMETRY_FRAMES_SAMPLED_OUT],
+             (unsigned long long)counters[TELEMETRY_BYTES_WRITTEN]);
+    ESP_LOGI(TAG, "high-water marks: ring %u/%u bytes, blocks %u/%u; heap %u bytes free, low-water mark %u",
+             stats.ring_peak, stats.ring_size, stats.blocks_peak, stats.block_count, heap_free, heap_min);
+    if (CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW)
+    {
+        // no file system on the card
+        return;
+    }
+
+    bool new_file = stat(TELEMETRY_PATH, &st) != 0;
+    FILE *fp = fopen(TELEMETRY_PATH, "a");
+    if (fp == NULL)
+    {
+        ESP_LOGW(TAG, "open %s failed", TELEMETRY_PATH);
+        return;
+    }
+    if (new_file)
+    {
+        fputs("time", fp);
+        for (int i = 0; i < TELEMETRY_COUNTER_COUNT; i++)
         {
-            break;
+            fprintf(fp, ",%s", telemetry_counter_name(i));
         }
+        fputs(",ring_peak,blocks_peak,heap_free,heap_min\n", fp);
+    }
+    fprintf(fp, "%ld", (long)time(NULL));
+    for (int i = 0; i < TELEMETRY_COUNTER_COUNT; i++)
+    {
+        fprintf(fp, ",%llu", (unsigned long long)counters[i]);
     }
+    fprintf(fp, ",%u,%u,%u,%u\n", stats.ring_peak, stats.blocks_peak, heap_free, heap_min);
+    fclose(fp);
+}
+
+/* First captured frame and clock steps into the time sync file, from the main loop like the telemetry;
+   true if the clock was stepped since the last call */
+static bool log_time_events(void)
+{
+    bool stepped = false;
+    static bool first_frame_logged = false;
+    time_sync_correction_t correction;
+
+    if (!first_frame_logged)
+    {
+        sniffer_pipeline_stats_t stats;
+        sniffer_get_pipeline_stats(&stats);
+        if (stats.first_frame_ms)
+        {
+            ESP_LOGI(TAG, "first frame captured %u ms after boot, time from %s", stats.first_frame_ms,
+                     time_sync_source_name(time_sync_source()));
+            append_time_event(stats.first_frame_ms, "first_frame", time_sync_source(),
+                              (int64_t)time(NULL) * 1000000, 0);
+            first_frame_logged = true;
+        }
+    }
+    while (time_sync_get_correction(&correction))
+    {
+        ESP_LOGI(TAG, "clock stepped by %lld us, earlier timestamps from %s time", (long long)correction.correction_us,
+                 time_sync_source_name(correction.source));
+        append_time_event(correction.uptime_ms, "sync", correction.source, correction.before_us,
+                          correction.correction_us);
+        stepped = true;
+    }
+    return stepped;
+}
 
-    return idx;
+static void append_time_event(uint32_t uptime_ms, const char *event, time_source_t source, int64_t time_us,
+                              int64_t correction_us)
+{
+    struct stat st;
+
+    if (CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW)
+    {
+        // no file system on the card, the event is only logged
+        return;
+    }
+    bool new_file = stat(TIME_SYNC_PATH, &st) != 0;
+    FILE *fp = fopen(TIME_SYNC_PATH, "a");
+
+    if (fp == NULL)
+    {
+        ESP_LOGW(TAG, "open %s failed", TIME_SYNC_PATH);
+        return;
+    }
+    if (new_file)
+    {
+        fputs("uptime_ms,event,source,time,correction_us,file_index\n", fp);
+    }
+    fprintf(fp, "%u,%s,%s,%lld.%06lld,%lld,%u\n", uptime_ms, event, time_sync_source_name(source),
+            (long long)(time_us / 1000000), (long long)(time_us % 1000000), (long long)correction_us,
+            pcap_get_capture_index());
+    fclose(fp);
 }
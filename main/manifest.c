@@ -0,0 +1,177 @@
+/* Capture manifest — file index tracking and list of finished capture files.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "config.h"
+#include "capture_sink.h"
+#include "lzb.h"
+#include "manifest.h"
+
+#define MANIFEST_NVS_NAMESPACE  "sniffer"
+#define MANIFEST_NVS_KEY        "next_file"
+#define MANIFEST_PATH           CONFIG_SD_MOUNT_POINT"/"CONFIG_MANIFEST_FILENAME
+#define MANIFEST_MAGIC_LEN      (4)     /* leading bytes of a capture file compared with what the firmware writes */
+
+static const char *MANIFEST_TAG = "manifest";
+
+static void file_path(char *path, size_t size, uint32_t idx)
+{
+    snprintf(path, size, CONFIG_SD_MOUNT_POINT"/"CONFIG_PCAP_FILENAME_MASK, idx);
+}
+
+/* Whether a capture file is missing or was never written: the pre-opened next file has its space reserved
+   (file_extent.h), so after a power cut it has a size but starts with zeros or stale data, not a file header */
+static bool file_unwritten(const char *path)
+{
+    uint8_t expected[CAPTURE_SINK_HEADER_MAX];
+    uint8_t found[MANIFEST_MAGIC_LEN];
+
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+    uint32_t magic = LZB_FRAME_MAGIC;
+    memcpy(expected, &magic, sizeof(magic));
+#else
+    capture_sink_file_header(expected);
+#endif
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        return true;
+    }
+    size_t length = fread(found, 1, sizeof(found), fp);
+    fclose(fp);
+    return length < sizeof(found) || memcmp(found, expected, sizeof(found)) != 0;
+}
+
+/* The stored index is valid if its file is free (or an unwritten pre-opened file) and the one before exists */
+static bool index_matches_card(uint32_t idx)
+{
+    char path[CONFIG_FATFS_MAX_LFN];
+    struct stat st;
+
+    file_path(path, sizeof(path), idx);
+    if (!file_unwritten(path))
+    {
+        return false;
+    }
+    if (idx == 0)
+    {
+        return true;
+    }
+    file_path(path, sizeof(path), idx - 1);
+    return stat(path, &st) == 0;
+}
+
+/* One pass over the card directory, returns the index following the highest capture file */
+static esp_err_t scan_directory(uint32_t *idx)
+{
+    esp_err_t ret = ESP_OK;
+    char expected[CONFIG_FATFS_MAX_LFN];
+    struct dirent *entry;
+    uint32_t next = 0;
+
+    DIR *dir = opendir(CONFIG_SD_MOUNT_POINT);
+    ESP_GOTO_ON_FALSE(dir, ESP_FAIL, err, MANIFEST_TAG, "open %s failed", CONFIG_SD_MOUNT_POINT);
+    while ((entry = readdir(dir)) != NULL)
+    {
+        const char *digits = entry->d_name;
+        while (*digits && !isdigit((unsigned char)*digits))
+        {
+            digits++;
+        }
+        if (!*digits)
+        {
+            continue;
+        }
+        uint32_t found = strtoul(digits, NULL, 10);
+        /* accept only names produced by the filename mask */
+        snprintf(expected, sizeof(expected), CONFIG_PCAP_FILENAME_MASK, found);
+        if (strcasecmp(expected, entry->d_name) == 0 && found + 1 > next)
+        {
+            next = found + 1;
+        }
+    }
+    closedir(dir);
+    *idx = next;
+err:
+    return ret;
+}
+
+esp_err_t manifest_get_next_index(uint32_t *idx)
+{
+    esp_err_t ret = ESP_OK;
+    nvs_handle_t handle;
+    uint32_t stored = 0;
+    bool found = false;
+
+    if (nvs_open(MANIFEST_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        found = nvs_get_u32(handle, MANIFEST_NVS_KEY, &stored) == ESP_OK;
+        nvs_close(handle);
+    }
+    if (found && index_matches_card(stored))
+    {
+        *idx = stored;
+        return ret;
+    }
+
+    ESP_LOGW(MANIFEST_TAG, "no valid file index in NVS, scanning card");
+    ESP_GOTO_ON_ERROR(scan_directory(idx), err, MANIFEST_TAG, "scan card failed");
+    manifest_store_next_index(*idx);
+err:
+    return ret;
+}
+
+esp_err_t manifest_store_next_index(uint32_t idx)
+{
+    esp_err_t ret = ESP_OK;
+    nvs_handle_t handle;
+
+    ESP_GOTO_ON_ERROR(nvs_open(MANIFEST_NVS_NAMESPACE, NVS_READWRITE, &handle), err, MANIFEST_TAG, "open NVS failed");
+    ret = nvs_set_u32(handle, MANIFEST_NVS_KEY, idx);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(MANIFEST_TAG, "store file index failed");
+    }
+err:
+    return ret;
+}
+
+esp_err_t manifest_append(const manifest_entry_t *entry)
+{
+    esp_err_t ret = ESP_OK;
+    char name[CONFIG_FATFS_MAX_LFN];
+    struct stat st;
+    bool create = stat(MANIFEST_PATH, &st) != 0;
+
+    FILE *fp = fopen(MANIFEST_PATH, "a");
+    ESP_GOTO_ON_FALSE(fp, ESP_FAIL, err, MANIFEST_TAG, "open manifest failed");
+    if (create)
+    {
+        fprintf(fp, "index,file,start,end,packets\n");
+    }
+    snprintf(name, sizeof(name), CONFIG_PCAP_FILENAME_MASK, entry->index);
+    fprintf(fp, "%u,%s,%u,%u,%u\n", entry->index, name, entry->start, entry->end, entry->packets);
+    ESP_GOTO_ON_FALSE(fclose(fp) == 0, ESP_FAIL, err, MANIFEST_TAG, "write manifest failed");
+err:
+    return ret;
+}
@@ -0,0 +1,66 @@
+/* Capture manifest — declarations of file index and manifest functions.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Manifest line describing one finished capture file
+ *
+ */
+typedef struct {
+    uint32_t index;     /*!< File index used in CONFIG_PCAP_FILENAME_MASK */
+    uint32_t start;     /*!< Unix time the file became the capture target */
+    uint32_t end;       /*!< Unix time the file was closed */
+    uint32_t packets;   /*!< Number of packets stored in the file */
+} manifest_entry_t;
+
+/**
+ * @brief Get the index of the first free capture file
+ *
+ * The index is kept in NVS and checked against the card with two lookups; if NVS has no index or it
+ * does not match the card (e.g. a different card was inserted), the card directory is scanned once.
+ * A file with that index counts as free while it does not start with a file header, like the pre-opened
+ * next file left at its reserved size by a power cut.
+ *
+ * @param[out] idx index of the first free capture file
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the card directory can't be read
+ */
+esp_err_t manifest_get_next_index(uint32_t *idx);
+
+/**
+ * @brief Remember the index of the first free capture file in NVS
+ *
+ * @param idx index of the first free capture file
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - others: failed to write NVS
+ */
+esp_err_t manifest_store_next_index(uint32_t idx);
+
+/**
+ * @brief Append a finished file to the manifest on the card
+ *
+ * @param entry description of the finished file
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the manifest can't be written
+ */
+esp_err_t manifest_append(const manifest_entry_t *entry);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+/* Overload control — load shedding stages of the capture callback.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include "overload.h"
+#include "fnv1a.h"
+
+static const char *overload_names[OVERLOAD_MODE_COUNT] = {
+    [OVERLOAD_FULL] = "full",
+    [OVERLOAD_SUMMARY] = "summary",
+    [OVERLOAD_SAMPLED] = "sampled",
+};
+
+static uint32_t overload_level(uint32_t ring_size, uint32_t percent)
+{
+    /* a level above the ring is never reached */
+    return percent >= 100 ? UINT32_MAX : (uint32_t)((uint64_t)ring_size * percent / 100);
+}
+
+void overload_init(overload_t *ctl, uint32_t ring_size, uint32_t summary_percent, uint32_t sample_percent,
+                   uint32_t hysteresis_percent, uint32_t hold_ms, uint32_t keep_percent, uint32_t seed)
+{
+    ctl->summary_level = overload_level(ring_size, summary_percent);
+    ctl->sample_level = overload_level(ring_size, sample_percent);
+    ctl->hysteresis = overload_level(ring_size, hysteresis_percent);
+    ctl->hold_ms = hold_ms;
+    ctl->keep_below = keep_percent >= 100 ? UINT32_MAX : (uint32_t)(((uint64_t)keep_percent << 32) / 100);
+    ctl->seed = seed;
+    ctl->mode = OVERLOAD_FULL;
+    ctl->since_ms = 0;
+    ctl->changes = 0;
+}
+
+overload_mode_t overload_update(overload_t *ctl, uint32_t used, uint32_t now_ms)
+{
+    overload_mode_t target = used >= ctl->sample_level ? OVERLOAD_SAMPLED :
+                             used >= ctl->summary_level ? OVERLOAD_SUMMARY : OVERLOAD_FULL;
+
+    if (target < ctl->mode)
+    {
+        uint32_t level = ctl->mode == OVERLOAD_SAMPLED ? ctl->sample_level : ctl->summary_level;
+        if (used + ctl->hysteresis >= level || now_ms - ctl->since_ms < ctl->hold_ms)
+        {
+            return ctl->mode;
+        }
+        target = ctl->mode - 1;
+    }
+    if (target != ctl->mode)
+    {
+        ctl->mode = target;
+        ctl->since_ms = now_ms;
+        ctl->changes++;
+    }
+    return ctl->mode;
+}
+
+uint32_t overload_mac_hash(uint32_t seed, const uint8_t *mac)
+{
+    uint32_t hash = seed;
+
+    for (int i = 0; i < 6; i++)
+    {
+        hash = fnv1a_byte(hash, mac[i]);
+    }
+    /* final avalanche, the kept share is taken from the high bits */
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+const char *overload_mode_name(overload_mode_t mode)
+{
+    return mode < OVERLOAD_MODE_COUNT ? overload_names[mode] : "unknown";
+}
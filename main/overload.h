@@ -0,0 +1,101 @@
+/* Overload control — declarations of the load shedding stages of the capture callback.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief How much of each frame the callback keeps, from the lightest to the heaviest shedding
+ *
+ */
+typedef enum {
+    OVERLOAD_FULL = 0,      /*!< Frames as configured */
+    OVERLOAD_SUMMARY,       /*!< MAC header only: addresses and sequence number, with time, RSSI and channel */
+    OVERLOAD_SAMPLED,       /*!< Summaries of the transmitters in the kept hash range only */
+    OVERLOAD_MODE_COUNT,
+} overload_mode_t;
+
+/**
+ * @brief Load shedding state, driven by the capture ring occupancy
+ *
+ * A mode is entered as soon as the ring holds its entry level, skipping modes if need be. It is left one
+ * step at a time, once the ring is below the entry level less the hysteresis and the mode has been held
+ * for hold_ms, so it does not flap while summaries drain the ring. Sampling keeps a transmitter if the
+ * seeded hash of its address falls below the kept share: the same transmitters are always kept, and the
+ * ones kept at a smaller share are a subset of those kept at a larger one.
+ */
+typedef struct {
+    uint32_t summary_level;     /*!< Ring bytes in use entering OVERLOAD_SUMMARY */
+    uint32_t sample_level;      /*!< Ring bytes in use entering OVERLOAD_SAMPLED */
+    uint32_t hysteresis;        /*!< Bytes below an entry level to leave the mode */
+    uint32_t hold_ms;           /*!< Shortest time in a mode before stepping down */
+    uint32_t keep_below;        /*!< Transmitters whose hash is below this are kept when sampling */
+    uint32_t seed;              /*!< Seed of the transmitter hash */
+    overload_mode_t mode;       /*!< Current mode */
+    uint32_t since_ms;          /*!< When the current mode was entered */
+    uint32_t changes;           /*!< Mode changes so far */
+} overload_t;
+
+/**
+ * @brief Initialize the controller in OVERLOAD_FULL
+ *
+ * @param ctl controller
+ * @param ring_size capture ring size in bytes
+ * @param summary_percent ring occupancy entering OVERLOAD_SUMMARY, 100 or more never enters it
+ * @param sample_percent ring occupancy entering OVERLOAD_SAMPLED, 100 or more never enters it
+ * @param hysteresis_percent occupancy below an entry level to leave the mode
+ * @param hold_ms shortest time in a mode before stepping down
+ * @param keep_percent share of transmitters kept when sampling
+ * @param seed seed of the transmitter hash
+ */
+void overload_init(overload_t *ctl, uint32_t ring_size, uint32_t summary_percent, uint32_t sample_percent,
+                   uint32_t hysteresis_percent, uint32_t hold_ms, uint32_t keep_percent, uint32_t seed);
+
+/**
+ * @brief Update the mode for the current ring occupancy
+ *
+ * @param ctl controller
+ * @param used capture ring bytes in use
+ * @param now_ms current time in milliseconds, may wrap
+ * @return mode the next frame is captured in
+ */
+overload_mode_t overload_update(overload_t *ctl, uint32_t used, uint32_t now_ms);
+
+/**
+ * @brief Seeded hash of a transmitter address
+ *
+ */
+uint32_t overload_mac_hash(uint32_t seed, const uint8_t *mac);
+
+/**
+ * @brief Whether a transmitter is in the kept share when sampling
+ *
+ * @param ctl controller
+ * @param mac transmitter address
+ * @return true to keep its frames
+ */
+static inline bool overload_keep(const overload_t *ctl, const uint8_t *mac)
+{
+    return overload_mac_hash(ctl->seed, mac) < ctl->keep_below;
+}
+
+/**
+ * @brief Short name of a mode ("full", "summary", "sampled")
+ *
+ */
+const char *overload_mode_name(overload_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
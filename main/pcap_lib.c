@@ -7,6 +7,7 @@
 */
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include "argtable3/argtable3.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -24,58 +25,740 @@
 #include "sdkconfig.h"
 #include "config.h"
 #include "pcap_lib.h"
+#include "manifest.h"
+#include "capture_sink.h"
+#include "lzb.h"
+#include "telemetry.h"
+#include "latency.h"
+#include "file_extent.h"
 
 static const char *PCAP_TAG = "pcap";
 
-#define PCAP_MEMORY_BUFFER_SIZE CONFIG_SNIFFER_PCAP_MEMORY_SIZE
-#define SNIFFER_PROCESS_APPTRACE_TIMEOUT_US (100)
-#define SNIFFER_APPTRACE_RETRY              (10)
-#define TRACE_TIMER_FLUSH_INT_MS            (1000)
+#define PCAP_RAW                            (CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW)
+#define PCAP_BLOCK_NO_DATA                  (0xFFFFFFFF)
+#define PCAP_LOG_INTERVAL_MS                (5000) /* repeated write errors are logged at most this often */
 
-static pcap_cmd_runtime_t pcap_rt = {0};
+/* Requests to the writer task, carried in pcap_block_t::flags */
+#define PCAP_BLOCK_SWITCH                   (1 << 0) /* continue in the pre-opened file after this block */
+#define PCAP_BLOCK_PREPARE                  (1 << 1) /* pre-open the file following the current one */
+#define PCAP_BLOCK_SYNC                     (1 << 2) /* signal sem_sync once everything before is written */
+#define PCAP_BLOCK_COMMIT                   (1 << 3) /* sync the file to the card once everything before is written */
+
+#if CONFIG_ESP32_WIFI_TASK_PINNED_TO_CORE_0 && (CONFIG_PCAP_WRITER_TASK_CORE == 0)
+#warning "pcap writer task shares core 0 with the Wi-Fi task"
+#endif
+
+static pcap_cmd_runtime_t pcap_rt = {
+    .policy = {
+        .max_bytes = CONFIG_PCAP_ROTATE_MAX_BYTES,
+        .max_packets = CONFIG_PCAP_ROTATE_MAX_PACKETS,
+        .interval_s = CONFIG_PCAP_ROTATE_INTERVAL_MINUTES * 60,
+        .prealloc_bytes = CONFIG_PCAP_PREALLOCATE_BYTES,
+    },
+};
+static const char *pcap_rotate_reason_str[] = {
+    [PCAP_ROTATE_NONE] = "none",
+    [PCAP_ROTATE_REQUESTED] = "requested",
+    [PCAP_ROTATE_BYTES] = "size limit",
+    [PCAP_ROTATE_PACKETS] = "packet limit",
+    [PCAP_ROTATE_TIME] = "time boundary",
+};
+static uint8_t pcap_block_buf[CONFIG_PCAP_BLOCK_COUNT][CONFIG_PCAP_BLOCK_SIZE] __attribute__((aligned(4)));
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+_Static_assert(CONFIG_PCAP_BLOCK_SIZE <= LZB_MAX_BLOCK_SIZE, "block too large for the compressor");
+/* Compressed frames gather here until a whole block can be written; holds one partial block plus one frame */
+static uint8_t pcap_out_buf[2 * CONFIG_PCAP_BLOCK_SIZE + sizeof(lzb_frame_header_t)] __attribute__((aligned(4)));
+static uint16_t pcap_lzb_table[LZB_TABLE_SIZE];
+#endif
+#if PCAP_RAW
+/* Header and payload of the segment being written */
+static uint8_t pcap_segment_buf[SEGLOG_SLOT_SIZE(CONFIG_PCAP_BLOCK_SIZE)] __attribute__((aligned(4)));
+#endif
+
+/* Space to reserve from offset on: the previous file plus a quarter for a new file (the whole extent for the
+   first), at most one extent of the policy and never past the size limit */
+static uint32_t pcap_extent_size(uint32_t offset)
+{
+    uint32_t size = pcap_rt.policy.prealloc_bytes;
+
+    if (offset == 0 && pcap_rt.last_written > 0 && pcap_rt.last_written + pcap_rt.last_written / 4 < size)
+    {
+        size = pcap_rt.last_written + pcap_rt.last_written / 4;
+    }
+    if (pcap_rt.policy.max_bytes && offset + size > pcap_rt.policy.max_bytes)
+    {
+        size = offset < pcap_rt.policy.max_bytes ? pcap_rt.policy.max_bytes - offset : 0;
+    }
+    return size;
+}
+
+/* Allocate the clusters of the next extent of a file now rather than while its blocks are written; fp is
+   positioned at offset. Returns the end of the reserved space, 0 if nothing was reserved */
+static uint32_t pcap_file_reserve(FILE *fp, const char *filename, uint32_t offset)
+{
+    uint32_t size = pcap_extent_size(offset);
+
+    if (PCAP_RAW || size == 0)
+    {
+        return 0;
+    }
+    if (file_extent_reserve(fp, offset, size) != ESP_OK)
+    {
+        ESP_LOGW(PCAP_TAG, "reserving %u bytes for %s failed, it grows as it is written", size, filename);
+        return 0;
+    }
+    return offset + size;
+}
+
+/* Close the current file and give back the reserved space it did not use */
+static esp_err_t pcap_file_close(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (PCAP_RAW)
+    {
+        /* every segment is complete on the card once written */
+        pcap_rt.last_written = pcap_rt.file_written;
+        pcap_rt.file_written = 0;
+        return ret;
+    }
+    if (fclose(pcap_rt.fp) != 0)
+    {
+        ret = ESP_FAIL;
+    }
+    if (file_extent_trim(pcap_rt.filename, pcap_rt.file_written) != ESP_OK)
+    {
+        ESP_LOGE(PCAP_TAG, "trim %s to %u bytes failed", pcap_rt.filename, pcap_rt.file_written);
+        ret = ESP_FAIL;
+    }
+    pcap_rt.last_written = pcap_rt.file_written;
+    pcap_rt.file_written = 0;
+    return ret;
+}
+
+/* Open the file following the current one (writer task context) */
+static void pcap_prepare_next(void)
+{
+    static telemetry_ratelimit_t open_log;
+    uint32_t suppressed;
+
+    if (PCAP_RAW || pcap_rt.next_fp)
+    {
+        return;
+    }
+    snprintf(pcap_rt.next_filename, sizeof(pcap_rt.next_filename), CONFIG_SD_MOUNT_POINT"/"CONFIG_PCAP_FILENAME_MASK,
+             pcap_rt.file_idx + 1);
+    pcap_rt.next_fp = fopen(pcap_rt.next_filename, "wb+");
+    if (!pcap_rt.next_fp)
+    {
+        if (telemetry_ratelimit(&open_log, PCAP_LOG_INTERVAL_MS, &suppressed))
+        {
+            ESP_LOGE(PCAP_TAG, "pre-open %s failed (%u more since the last error)", pcap_rt.next_filename, suppressed);
+        }
+        return;
+    }
+    setvbuf(pcap_rt.next_fp, NULL, _IONBF, 0);
+    pcap_rt.next_reserved = pcap_file_reserve(pcap_rt.next_fp, pcap_rt.next_filename, 0);
+}
+
+/* Close the current file and continue in the pre-opened one (writer task context) */
+static void pcap_switch_file(void)
+{
+    if (PCAP_RAW)
+    {
+        /* segments carry the index of their file, there is nothing to close or open */
+        pcap_file_close();
+        pcap_rt.file_idx++;
+        snprintf(pcap_rt.filename, sizeof(pcap_rt.filename), CONFIG_PCAP_FILENAME_MASK, pcap_rt.file_idx);
+        pcap_rt.rotations++;
+        ESP_LOGI(PCAP_TAG, "switched to %s in the segment log", pcap_rt.filename);
+        return;
+    }
+    pcap_prepare_next();
+    if (!pcap_rt.next_fp)
+    {
+        /* keep capturing into the current file, the next block starts with a file header we must not write;
+           the capture path counts the records back into this file and rotates again once the pre-open works */
+        ESP_LOGE(PCAP_TAG, "rotation failed, keep writing %s", pcap_rt.filename);
+        pcap_rt.skip_header = true;
+        pcap_rt.rotation_failures++;
+        pcap_rt.switch_failed = true;
+        return;
+    }
+    if (pcap_file_close() != ESP_OK)
+    {
+        ESP_LOGE(PCAP_TAG, "close %s failed", pcap_rt.filename);
+    }
+    manifest_append(&pcap_rt.closing);
+    pcap_rt.uncommitted = 0;
+    pcap_rt.fp = pcap_rt.next_fp;
+    pcap_rt.next_fp = NULL;
+    pcap_rt.file_reserved = pcap_rt.next_reserved;
+    strcpy(pcap_rt.filename, pcap_rt.next_filename);
+    pcap_rt.file_idx++;
+    manifest_store_next_index(pcap_rt.file_idx + 1);
+    pcap_rt.rotations++;
+    ESP_LOGI(PCAP_TAG, "switched to %s", pcap_rt.filename);
+    pcap_prepare_next();
+}
+
+static void pcap_file_write(const uint8_t *data, uint32_t length)
+{
+    static telemetry_ratelimit_t write_log;
+    uint32_t suppressed;
+
+    LATENCY_START(write_start);
+#if PCAP_RAW
+    uint32_t written = seglog_append(&pcap_rt.log, pcap_rt.file_idx, data, length) == ESP_OK ? length : 0;
+#else
+    if (pcap_rt.file_reserved && pcap_rt.file_written + length > pcap_rt.file_reserved)
+    {
+        /* one extent at a time, so a power cut leaves at most that much reserved but unwritten */
+        pcap_rt.file_reserved = pcap_file_reserve(pcap_rt.fp, pcap_rt.filename, pcap_rt.file_written);
+    }
+    uint32_t written = fwrite(data, 1, length, pcap_rt.fp);
+#endif
+    LATENCY_END(LATENCY_WRITE, write_start);
+    if (written != length)
+    {
+        if (telemetry_ratelimit(&write_log, PCAP_LOG_INTERVAL_MS, &suppressed))
+        {
+            ESP_LOGE(PCAP_TAG, "write block to %s failed (%u more since the last error)", pcap_rt.filename, suppressed);
+        }
+        pcap_rt.write_error = true;
+        return;
+    }
+    telemetry_add(TELEMETRY_BYTES_WRITTEN, length);
+    pcap_rt.uncommitted += length;
+    pcap_rt.file_written += length;
+}
+
+/* Make everything written so far survive a power cut: data and FAT entry of the file (writer task context) */
+static void pcap_file_commit(void)
+{
+    /* segments are durable once written, no file system metadata to update */
+    if (PCAP_RAW || pcap_rt.uncommitted == 0)
+    {
+        return;
+    }
+    LATENCY_START(commit_start);
+    if (fflush(pcap_rt.fp) != 0 || fsync(fileno(pcap_rt.fp)) != 0)
+    {
+        ESP_LOGE(PCAP_TAG, "sync %s failed", pcap_rt.filename);
+    }
+    LATENCY_END(LATENCY_COMMIT, commit_start);
+    pcap_rt.uncommitted = 0;
+    pcap_rt.commits++;
+}
+
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+/* Compress data into one independently decodable frame and write every full block gathered so far */
+static void pcap_write_compressed(const uint8_t *data, uint32_t length)
+{
+    uint8_t *frame = pcap_out_buf + pcap_rt.out_fill;
+    lzb_frame_header_t header = {
+        .magic = LZB_FRAME_MAGIC,
+        .raw_length = length,
+        .checksum = lzb_checksum(data, length),
+    };
+
+    /* anything not shorter than the input is stored as it is */
+    header.stored_length = lzb_compress(data, length, frame + sizeof(header), length - 1, pcap_lzb_table);
+    if (header.stored_length == 0)
+    {
+        memcpy(frame + sizeof(header), data, length);
+        header.stored_length = length;
+    }
+    memcpy(frame, &header, sizeof(header));
+    pcap_rt.out_fill += sizeof(header) + header.stored_length;
+    pcap_rt.bytes_in += length;
+    pcap_rt.bytes_out += sizeof(header) + header.stored_length;
+    /* one write per block, as without compression; a stored frame is longer than its input by its header, so
+       incompressible data can fill more than one block and all of them must go for the next frame to fit */
+    while (pcap_rt.out_fill >= CONFIG_PCAP_BLOCK_SIZE)
+    {
+        pcap_file_write(pcap_out_buf, CONFIG_PCAP_BLOCK_SIZE);
+        pcap_rt.out_fill -= CONFIG_PCAP_BLOCK_SIZE;
+        memmove(pcap_out_buf, pcap_out_buf + CONFIG_PCAP_BLOCK_SIZE, pcap_rt.out_fill);
+    }
+}
+#endif
+
+/* Write what the compression stage still holds, before the file is switched or closed */
+static void pcap_write_flush(void)
+{
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+    if (pcap_rt.out_fill > 0)
+    {
+        pcap_file_write(pcap_out_buf, pcap_rt.out_fill);
+        pcap_rt.out_fill = 0;
+    }
+#endif
+}
+
+static void pcap_writer_task(void *parameters)
+{
+    pcap_block_t block;
+
+    while (true)
+    {
+        if (xQueueReceive(pcap_rt.full_queue, &block, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        if (block.index != PCAP_BLOCK_NO_DATA)
+        {
+            uint32_t offset = 0;
+            if (pcap_rt.skip_header)
+            {
+                offset = pcap_rt.header_length;
+                pcap_rt.skip_header = false;
+            }
+            if (block.length > offset)
+            {
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+                pcap_write_compressed(pcap_rt.blocks[block.index] + offset, block.length - offset);
+#else
+                /* one write per block keeps the file offset aligned to the block size */
+                pcap_file_write(pcap_rt.blocks[block.index] + offset, block.length - offset);
+#endif
+            }
+            xQueueSend(pcap_rt.free_queue, &block.index, portMAX_DELAY);
+        }
+        if (block.flags & (PCAP_BLOCK_SWITCH | PCAP_BLOCK_SYNC | PCAP_BLOCK_COMMIT))
+        {
+            pcap_write_flush();
+        }
+        /* a switch closes the file, which commits it anyway */
+        if (!(block.flags & PCAP_BLOCK_SWITCH) && ((block.flags & PCAP_BLOCK_COMMIT) ||
+            (CONFIG_PCAP_COMMIT_BYTES && pcap_rt.uncommitted >= CONFIG_PCAP_COMMIT_BYTES)))
+        {
+            pcap_file_commit();
+        }
+        if (pcap_rt.switch_failed && !(block.flags & PCAP_BLOCK_SWITCH))
+        {
+            /* retry the pre-open of a failed switch with every block */
+            pcap_prepare_next();
+            pcap_rt.switch_failed = !pcap_rt.next_fp;
+        }
+        if (block.flags & PCAP_BLOCK_SWITCH)
+        {
+            pcap_switch_file();
+            pcap_rt.switch_pending = false;
+        }
+        if (block.flags & PCAP_BLOCK_PREPARE)
+        {
+            pcap_prepare_next();
+        }
+        if (block.flags & PCAP_BLOCK_SYNC)
+        {
+            xSemaphoreGive(pcap_rt.sem_sync);
+        }
+    }
+}
+
+static esp_err_t pcap_writer_init(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    pcap_rt.free_queue = xQueueCreate(CONFIG_PCAP_BLOCK_COUNT, sizeof(uint32_t));
+    ESP_GOTO_ON_FALSE(pcap_rt.free_queue, ESP_FAIL, err, PCAP_TAG, "create free block queue failed");
+    /* room for every block plus control requests, so a request never waits for a block write */
+    pcap_rt.full_queue = xQueueCreate(CONFIG_PCAP_BLOCK_COUNT + 2, sizeof(pcap_block_t));
+    ESP_GOTO_ON_FALSE(pcap_rt.full_queue, ESP_FAIL, err_full, PCAP_TAG, "create full block queue failed");
+    pcap_rt.sem_sync = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(pcap_rt.sem_sync, ESP_FAIL, err_sem, PCAP_TAG, "create semaphore failed");
+    for (uint32_t i = 0; i < CONFIG_PCAP_BLOCK_COUNT; i++)
+    {
+        pcap_rt.blocks[i] = pcap_block_buf[i];
+        xQueueSend(pcap_rt.free_queue, &i, 0);
+    }
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(pcap_writer_task, "pcapWriterT", CONFIG_PCAP_WRITER_TASK_STACK_SIZE,
+                                              NULL, CONFIG_PCAP_WRITER_TASK_PRIORITY, &pcap_rt.writer_task,
+                                              CONFIG_PCAP_WRITER_TASK_CORE), ESP_FAIL,
+                      err_task, PCAP_TAG, "create writer task failed");
+    return ret;
+err_task:
+    vSemaphoreDelete(pcap_rt.sem_sync);
+    pcap_rt.sem_sync = NULL;
+err_sem:
+    vQueueDelete(pcap_rt.full_queue);
+    pcap_rt.full_queue = NULL;
+err_full:
+    vQueueDelete(pcap_rt.free_queue);
+    pcap_rt.free_queue = NULL;
+err:
+    return ret;
+}
+
+/* Hand the block being filled over to the writer task, together with optional PCAP_BLOCK_* requests */
+static void pcap_block_submit(uint32_t flags)
+{
+    pcap_block_t block = {
+        .index = PCAP_BLOCK_NO_DATA,
+        .length = 0,
+        .flags = flags,
+    };
+
+    if (pcap_rt.has_block)
+    {
+        if (pcap_rt.fill.length > 0)
+        {
+            block.index = pcap_rt.fill.index;
+            block.length = pcap_rt.fill.length;
+        }
+        else
+        {
+            xQueueSend(pcap_rt.free_queue, &pcap_rt.fill.index, portMAX_DELAY);
+        }
+        pcap_rt.has_block = false;
+    }
+    /* a partial block moves the file offset off the block size, the next block is shortened to get back;
+     * segments of the raw backend each have their own slot */
+    pcap_rt.block_offset = (pcap_rt.block_offset + block.length) % CONFIG_PCAP_BLOCK_SIZE;
+    if (PCAP_RAW || (flags & PCAP_BLOCK_SWITCH))
+    {
+        pcap_rt.block_offset = 0;
+    }
+    if (block.length > 0 || block.flags != 0)
+    {
+        xQueueSend(pcap_rt.full_queue, &block, portMAX_DELAY);
+        uint32_t queued = uxQueueMessagesWaiting(pcap_rt.full_queue);
+        if (queued > pcap_rt.blocks_peak)
+        {
+            pcap_rt.blocks_peak = queued;
+        }
+    }
+}
+
+/* Append data to the current block; records may span two consecutive blocks */
+static void pcap_block_append(const void *data, uint32_t length)
+{
+    const uint8_t *src = (const uint8_t *)data;
+
+    while (length > 0)
+    {
+        if (!pcap_rt.has_block)
+        {
+            /* waits only if the writer task still holds every block */
+            if (xQueueReceive(pcap_rt.free_queue, &pcap_rt.fill.index, 0) != pdTRUE)
+            {
+                pcap_rt.stalls++;
+                xQueueReceive(pcap_rt.free_queue, &pcap_rt.fill.index, portMAX_DELAY);
+            }
+            pcap_rt.fill.length = 0;
+            pcap_rt.has_block = true;
+        }
+        uint32_t limit = CONFIG_PCAP_BLOCK_SIZE - pcap_rt.block_offset;
+        uint32_t chunk = limit - pcap_rt.fill.length;
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+        if (!pcap_rt.dirty)
+        {
+            pcap_rt.dirty = true;
+            pcap_rt.dirty_since = xTaskGetTickCount();
+        }
+        memcpy(pcap_rt.blocks[pcap_rt.fill.index] + pcap_rt.fill.length, src, chunk);
+        pcap_rt.fill.length += chunk;
+        src += chunk;
+        length -= chunk;
+        if (pcap_rt.fill.length == limit)
+        {
+            pcap_block_submit(0);
+        }
+    }
+}
+
+/* Submit the partial block and wait until the writer task has processed everything */
+static void pcap_block_drain(void)
+{
+    pcap_block_submit(PCAP_BLOCK_SYNC);
+    xSemaphoreTake(pcap_rt.sem_sync, portMAX_DELAY);
+    pcap_rt.dirty = false;
+}
+
+static void pcap_append_file_header(void)
+{
+    uint8_t header[CAPTURE_SINK_HEADER_MAX];
+
+    pcap_rt.header_length = capture_sink_file_header(header);
+    pcap_block_append(header, pcap_rt.header_length);
+    pcap_rt.bytes += pcap_rt.header_length;
+}
+
+/* Next multiple of the rotation interval since the epoch, i.e. aligned to the hour for intervals dividing 60 minutes */
+static time_t pcap_next_boundary(time_t now)
+{
+    if (pcap_rt.policy.interval_s == 0)
+    {
+        return 0;
+    }
+    return (now / pcap_rt.policy.interval_s + 1) * pcap_rt.policy.interval_s;
+}
+
+void pcap_get_writer_stats(pcap_writer_stats_t *stats)
+{
+    stats->block_count = CONFIG_PCAP_BLOCK_COUNT;
+    stats->blocks_queued = pcap_rt.full_queue ? uxQueueMessagesWaiting(pcap_rt.full_queue) : 0;
+    stats->blocks_peak = pcap_rt.blocks_peak;
+    stats->stalls = pcap_rt.stalls;
+    stats->rotations = pcap_rt.rotations;
+    stats->rotation_failures = pcap_rt.rotation_failures;
+    stats->bytes_in = pcap_rt.bytes_in;
+    stats->bytes_out = pcap_rt.bytes_out;
+    stats->commits = pcap_rt.commits;
+}
+
+uint32_t pcap_get_capture_index(void)
+{
+    /* once pcap_service() started a switch, new records already belong to the next file */
+    return pcap_rt.switch_pending ? pcap_rt.file_idx + 1 : pcap_rt.file_idx;
+}
+
+void pcap_set_rotation_policy(const pcap_rotation_policy_t *policy)
+{
+    pcap_rt.policy = *policy;
+    pcap_rt.next_boundary = pcap_next_boundary(time(NULL));
+}
+
+void pcap_clock_stepped(void)
+{
+    pcap_rt.next_boundary = pcap_next_boundary(time(NULL));
+}
+
+esp_err_t pcap_rotate(void)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_FALSE(pcap_rt.is_opened, ESP_ERR_INVALID_STATE, err, PCAP_TAG, "no .pcap file stream is open");
+    ESP_GOTO_ON_FALSE(!pcap_rt.rotate_requested && !pcap_rt.switch_pending, ESP_ERR_INVALID_STATE, err, PCAP_TAG,
+                      "rotation already pending");
+    pcap_rt.rotate_requested = true;
+err:
+    return ret;
+}
+
+/* Rotation policy: explicit request, size, packet count or wall-clock boundary, whichever comes first */
+static pcap_rotate_reason_t pcap_rotation_due(time_t now)
+{
+    if (pcap_rt.rotate_requested)
+    {
+        return PCAP_ROTATE_REQUESTED;
+    }
+    if (pcap_rt.policy.max_bytes && pcap_rt.bytes >= pcap_rt.policy.max_bytes)
+    {
+        return PCAP_ROTATE_BYTES;
+    }
+    if (pcap_rt.policy.max_packets && pcap_rt.packets >= pcap_rt.policy.max_packets)
+    {
+        return PCAP_ROTATE_PACKETS;
+    }
+    if (pcap_rt.next_boundary && now >= pcap_rt.next_boundary)
+    {
+        return PCAP_ROTATE_TIME;
+    }
+    return PCAP_ROTATE_NONE;
+}
+
+/* The writer task could not switch files, so the records since the switch went into the current file: count
+   them there again (capture path) */
+static void pcap_merge_failed_switch(void)
+{
+    /* keyed on the failure count, the writer task may already have cleared switch_failed again */
+    if (pcap_rt.failures_merged == pcap_rt.rotation_failures)
+    {
+        return;
+    }
+    pcap_rt.started = pcap_rt.closing.start;
+    pcap_rt.packets += pcap_rt.closing.packets;
+    /* the file header counted for the new file was not written */
+    pcap_rt.bytes += pcap_rt.closing_bytes - pcap_rt.header_length;
+    pcap_rt.failures_merged = pcap_rt.rotation_failures;
+}
+
+pcap_rotate_reason_t pcap_service(void)
+{
+    if (!pcap_rt.is_writing || pcap_rt.switch_pending)
+    {
+        return PCAP_ROTATE_NONE;
+    }
+    time_t now = time(NULL);
+    pcap_merge_failed_switch();
+    /* after a failed switch, rotate again only once the writer task has the next file open */
+    pcap_rotate_reason_t reason = pcap_rt.switch_failed ? PCAP_ROTATE_NONE : pcap_rotation_due(now);
+    if (reason != PCAP_ROTATE_NONE)
+    {
+        /* called between records: everything so far belongs to the current file,
+         * the writer task picks up the manifest entry when it reaches the switch */
+        ESP_LOGI(PCAP_TAG, "rotate %s after %u packets, %u bytes (%s)", pcap_rt.filename, pcap_rt.packets,
+                 pcap_rt.bytes, pcap_rotate_reason_str[reason]);
+        pcap_rt.closing.index = pcap_rt.file_idx;
+        pcap_rt.closing.start = pcap_rt.started;
+        pcap_rt.closing.end = now;
+        pcap_rt.closing.packets = pcap_rt.packets;
+        pcap_rt.closing_bytes = pcap_rt.bytes;
+        pcap_rt.started = now;
+        pcap_rt.packets = 0;
+        pcap_rt.bytes = 0;
+        pcap_rt.next_boundary = pcap_next_boundary(now);
+        pcap_rt.switch_pending = true;
+        pcap_block_submit(PCAP_BLOCK_SWITCH);
+        pcap_rt.dirty = false;
+        pcap_append_file_header();
+        pcap_rt.rotate_requested = false;
+    }
+    else if (CONFIG_PCAP_COMMIT_INTERVAL_MS && pcap_rt.dirty &&
+             xTaskGetTickCount() - pcap_rt.dirty_since >= pdMS_TO_TICKS(CONFIG_PCAP_COMMIT_INTERVAL_MS))
+    {
+        /* under load blocks fill up before the interval and the byte budget commits on full blocks */
+        pcap_block_submit(PCAP_BLOCK_COMMIT);
+        pcap_rt.dirty = false;
+    }
+    return reason;
+}
 
 esp_err_t pcap_close(void)
 {
     esp_err_t ret = ESP_OK;
     ESP_GOTO_ON_FALSE(pcap_rt.is_opened, ESP_ERR_INVALID_STATE, err, PCAP_TAG, ".pcap file is already closed");
-    ESP_GOTO_ON_ERROR(pcap_del_session(pcap_rt.pcap_handle) != ESP_OK, err, PCAP_TAG, "stop pcap session failed");
+    pcap_rt.rotate_requested = false;
+    pcap_block_drain();
+    pcap_merge_failed_switch();
+    manifest_entry_t entry = {
+        .index = pcap_rt.file_idx,
+        .start = pcap_rt.started,
+        .end = time(NULL),
+        .packets = pcap_rt.packets,
+    };
+    if (!PCAP_RAW)
+    {
+        manifest_append(&entry);
+    }
+    if (pcap_rt.next_fp)
+    {
+        /* nothing was written into the pre-opened file yet */
+        fclose(pcap_rt.next_fp);
+        pcap_rt.next_fp = NULL;
+        remove(pcap_rt.next_filename);
+    }
+    ESP_GOTO_ON_FALSE(pcap_file_close() == ESP_OK && !pcap_rt.write_error, ESP_FAIL, err_close, PCAP_TAG, "close .pcap file failed");
+err_close:
     pcap_rt.is_opened = false;
     pcap_rt.link_type_set = false;
-    pcap_rt.pcap_handle = NULL;
+    pcap_rt.write_error = false;
+    pcap_rt.skip_header = false;
+    pcap_rt.switch_failed = false;
+    pcap_rt.fp = NULL;
 err:
     return ret;
 }
 
+#if PCAP_RAW
+esp_err_t pcap_attach_log(block_dev_t *dev, uint32_t new_id, uint32_t *next_idx)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t last;
+
+    ESP_GOTO_ON_FALSE(!pcap_rt.is_opened, ESP_ERR_INVALID_STATE, err, PCAP_TAG, "capture file still open");
+    ESP_GOTO_ON_ERROR(seglog_open(&pcap_rt.log, dev, CONFIG_SEGLOG_FIRST_SECTOR, CONFIG_PCAP_BLOCK_SIZE,
+                                  CONFIG_PCAP_FILENAME_MASK, new_id, pcap_segment_buf), err, PCAP_TAG,
+                      "open segment log failed");
+    /* a file cut off by a power loss stays as it is, the capture goes on in the next one */
+    *next_idx = seglog_last_file(&pcap_rt.log, &last) ? last + 1 : 0;
+err:
+    return ret;
+}
+#endif
+
 esp_err_t pcap_open(uint32_t idx)
 {
     esp_err_t ret = ESP_OK;
+    pcap_block_t prepare = {
+        .index = PCAP_BLOCK_NO_DATA,
+        .length = 0,
+        .flags = PCAP_BLOCK_PREPARE,
+    };
 
+    if (!pcap_rt.writer_task)
+    {
+        ESP_GOTO_ON_ERROR(pcap_writer_init(), err, PCAP_TAG, "pcap writer init failed");
+    }
+
+    pcap_rt.file_written = 0;
+#if PCAP_RAW
+    ESP_GOTO_ON_FALSE(pcap_rt.log.dev, ESP_ERR_INVALID_STATE, err, PCAP_TAG, "no segment log attached");
+    snprintf(pcap_rt.filename, sizeof(pcap_rt.filename), CONFIG_PCAP_FILENAME_MASK, idx);
+#else
     /* Create file to write, binary format */
     snprintf(pcap_rt.filename, sizeof(pcap_rt.filename), CONFIG_SD_MOUNT_POINT"/"CONFIG_PCAP_FILENAME_MASK, idx);
-    FILE *fp = NULL;
-    fp = fopen(pcap_rt.filename, "wb+");
-    ESP_GOTO_ON_FALSE(fp, ESP_FAIL, err, PCAP_TAG, "open file failed");
-    pcap_config_t pcap_config = {
-        .fp = fp,
-        .major_version = PCAP_DEFAULT_VERSION_MAJOR,
-        .minor_version = PCAP_DEFAULT_VERSION_MINOR,
-        .time_zone = PCAP_DEFAULT_TIME_ZONE_GMT,
-    };
-    ESP_GOTO_ON_ERROR(pcap_new_session(&pcap_config, &pcap_rt.pcap_handle), err, PCAP_TAG, "pcap init failed");
+    pcap_rt.fp = fopen(pcap_rt.filename, "wb+");
+    ESP_GOTO_ON_FALSE(pcap_rt.fp, ESP_FAIL, err, PCAP_TAG, "open file failed");
+    /* data reaches the file in whole blocks, a stdio buffer would only add a copy */
+    setvbuf(pcap_rt.fp, NULL, _IONBF, 0);
+    pcap_rt.file_reserved = pcap_file_reserve(pcap_rt.fp, pcap_rt.filename, 0);
+#endif
+    pcap_rt.file_idx = idx;
+    pcap_rt.started = time(NULL);
+    pcap_rt.packets = 0;
+    pcap_rt.bytes = 0;
+    pcap_rt.block_offset = 0;
+    pcap_rt.next_boundary = pcap_next_boundary(pcap_rt.started);
+    if (!PCAP_RAW)
+    {
+        manifest_store_next_index(idx + 1);
+    }
     pcap_rt.is_opened = true;
+    /* let the writer task open the following file in the background, ready for rotation */
+    xQueueSend(pcap_rt.full_queue, &prepare, portMAX_DELAY);
     ESP_LOGI(PCAP_TAG, "open file successfully");
-    return ret;
 err:
-    if (fp) 
+    return ret;
+}
+
+/* Record in the format of the compiled-in sink, the frame body is copied straight from the ring */
+static uint32_t pcap_append_frame(const capture_frame_t *frame)
+{
+    capture_sink_record_t record;
+
+    capture_sink_record(frame, &record);
+    pcap_block_append(record.head, record.head_length);
+    if (record.body_length > 0)
+    {
+        pcap_block_append(record.body, record.body_length);
+    }
+    if (record.tail_length > 0)
     {
-        fclose(fp);
+        pcap_block_append(record.tail, record.tail_length);
     }
+    return record.head_length + record.body_length + record.tail_length;
+}
+
+esp_err_t packet_capture(const capture_frame_t *frame)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_FALSE(pcap_rt.is_writing, ESP_ERR_INVALID_STATE, err, PCAP_TAG, "pcap session is not started");
+    pcap_rt.bytes += pcap_append_frame(frame);
+    pcap_rt.packets++;
+    ret = pcap_rt.write_error ? ESP_FAIL : ESP_OK;
+err:
     return ret;
 }
 
-esp_err_t packet_capture(void *payload, uint32_t length, uint32_t seconds, uint32_t microseconds)
+esp_err_t packet_capture_stats(const capture_stats_t *stats)
 {
-    return pcap_capture_packet(pcap_rt.pcap_handle, payload, length, seconds, microseconds);
+    esp_err_t ret = ESP_OK;
+    uint8_t record[CAPTURE_SINK_STATS_MAX];
+
+    ESP_GOTO_ON_FALSE(pcap_rt.is_writing, ESP_ERR_INVALID_STATE, err, PCAP_TAG, "pcap session is not started");
+    uint32_t length = capture_sink_stats(stats, record);
+    if (length > 0)
+    {
+        pcap_block_append(record, length);
+        pcap_rt.bytes += length;
+    }
+err:
+    return ret;
 }
 
 esp_err_t sniff_packet_start(pcap_link_type_t link_type)
@@ -90,9 +773,11 @@ esp_err_t sniff_packet_start(pcap_link_type_t link_type)
     }
     else 
     {
+        ESP_GOTO_ON_FALSE(link_type == CAPTURE_SINK_LINK_TYPE, ESP_ERR_INVALID_ARG, err, PCAP_TAG,
+                          "link type does not match the capture format");
         pcap_rt.link_type = link_type;
-        /* Create file to write, binary format */
-        pcap_write_header(pcap_rt.pcap_handle, link_type);
+        /* File header goes first into the block buffer */
+        pcap_append_file_header();
         pcap_rt.link_type_set = true;
     }
     pcap_rt.is_writing = true;
@@ -104,4 +789,4 @@ esp_err_t sniff_packet_stop(void)
 {
     pcap_rt.is_writing = false;
     return ESP_OK;
-}
\ No newline at end of file
+}
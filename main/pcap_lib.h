@@ -8,33 +8,142 @@
 */
 #pragma once
 
+#include <stdio.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "pcap.h"
+#include "config.h"
+#include "manifest.h"
+#include "capture_sink.h"
+#include "seglog.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Full block handed over to the writer task
+ *
+ */
+typedef struct {
+    uint32_t index;  /*!< Index of the block in pcap_cmd_runtime_t::blocks, or none for a bare request */
+    uint32_t length; /*!< Number of valid bytes, equal to block size except for the last block of a file */
+    uint32_t flags;  /*!< Requests to the writer task, handled after the block is written */
+} pcap_block_t;
+
+/**
+ * @brief When to continue the capture in a new file; limits set to 0 are disabled
+ *
+ */
+typedef struct {
+    uint32_t max_bytes;     /*!< Rotate once the file holds this many bytes */
+    uint32_t max_packets;   /*!< Rotate once the file holds this many packets */
+    uint32_t interval_s;    /*!< Rotate on every wall-clock multiple of this interval (aligned to the hour) */
+    uint32_t prealloc_bytes;/*!< Reserve space in extents of at most this much, 0 disables */
+} pcap_rotation_policy_t;
+
+/**
+ * @brief Why a file rotation happened
+ *
+ */
+typedef enum {
+    PCAP_ROTATE_NONE = 0,   /*!< No rotation */
+    PCAP_ROTATE_REQUESTED,  /*!< Explicit pcap_rotate() */
+    PCAP_ROTATE_BYTES,      /*!< Size limit reached */
+    PCAP_ROTATE_PACKETS,    /*!< Packet count limit reached */
+    PCAP_ROTATE_TIME,       /*!< Wall-clock boundary crossed */
+} pcap_rotate_reason_t;
+
 typedef struct {
     bool is_opened;
     bool is_writing;
     bool link_type_set;
+    bool write_error;
+    volatile bool rotate_requested; /*!< Switch to the next file at the next record boundary */
+    volatile bool switch_pending;   /*!< Switch submitted, not yet done by the writer task */
+    bool skip_header;           /*!< Writer: rotation failed, drop the file header starting the next block */
+    volatile bool switch_failed;    /*!< Writer: the last switch failed, cleared once the next file is pre-opened */
+    uint32_t failures_merged;   /*!< Capture path: failed switches whose counters went back to the current file */
+    uint32_t header_length;     /*!< Length of the file header of the compiled-in sink */
+    uint32_t file_idx;          /*!< Index of the file being written */
+    uint32_t started;           /*!< Unix time the current file became the capture target */
+    uint32_t packets;           /*!< Packets captured into the current file */
+    uint32_t bytes;             /*!< Bytes captured into the current file */
+    pcap_rotation_policy_t policy;
+    time_t next_boundary;       /*!< Wall-clock time of the next time-based rotation, 0 if disabled */
+    manifest_entry_t closing;   /*!< Manifest entry of the file being switched away from */
+    uint32_t closing_bytes;     /*!< Bytes captured into the file being switched away from */
     char filename[CONFIG_FATFS_MAX_LFN];
-    pcap_file_handle_t pcap_handle;
+    FILE *fp;
+    char next_filename[CONFIG_FATFS_MAX_LFN];
+    FILE *next_fp;              /*!< Next file, opened in the background by the writer task */
     pcap_link_type_t link_type;
+    uint8_t *blocks[CONFIG_PCAP_BLOCK_COUNT]; /*!< RAM blocks, one filled by the capture path while the others are written */
+    bool has_block;             /*!< Capture path currently owns a block */
+    bool dirty;                 /*!< Capture path: records appended since the last commit request */
+    uint32_t dirty_since;       /*!< Capture path: tick count of the oldest of those records */
+    uint32_t block_offset;      /*!< Capture path: file offset after the submitted blocks, modulo the block size */
+    pcap_block_t fill;          /*!< Block being filled by the capture path */
+    QueueHandle_t free_queue;   /*!< Indices of blocks available for filling */
+    QueueHandle_t full_queue;   /*!< Blocks waiting to be written to the file */
+    SemaphoreHandle_t sem_sync; /*!< Given by the writer task once a PCAP_BLOCK_SYNC request is reached */
+    TaskHandle_t writer_task;
+    uint32_t rotations;         /*!< Completed file switches */
+    uint32_t rotation_failures; /*!< Switches that failed, the capture went on in the current file */
+    uint32_t blocks_peak;       /*!< Highest number of blocks waiting for the writer task */
+    uint32_t stalls;            /*!< Times the capture path had to wait for a free block */
+    uint32_t out_fill;          /*!< Writer: compressed bytes waiting for a full block */
+    uint32_t bytes_in;          /*!< Writer: bytes handed to the compression stage */
+    uint32_t bytes_out;         /*!< Writer: bytes the compression stage produced, frame headers included */
+    uint32_t uncommitted;       /*!< Writer: bytes written to the current file since its last sync */
+    uint32_t commits;           /*!< Writer: file syncs done by the group commit */
+    uint32_t file_written;      /*!< Writer: bytes written to the current file */
+    uint32_t last_written;      /*!< Writer: bytes written to the previous file, sizes the next reservation */
+    uint32_t file_reserved;     /*!< Writer: end of the space reserved for the current file, 0 if none */
+    uint32_t next_reserved;     /*!< Writer: space reserved for the pre-opened file */
+    seglog_t log;               /*!< Segment log taking the place of the files with STORAGE_BACKEND_RAW */
 } pcap_cmd_runtime_t;
 
 /**
- * @brief Capture a pcap package with parameters
+ * @brief Occupancy of the handoff between the capture path and the writer task
  *
- * @param payload pointer of the captured data
- * @param length length of captured data
- * @param seconds second of capture time
- * @param microseconds microsecond of capture time
+ */
+typedef struct {
+    uint32_t block_count;   /*!< Number of blocks */
+    uint32_t blocks_queued; /*!< Blocks currently waiting to be written */
+    uint32_t blocks_peak;   /*!< Highest number of blocks waiting to be written */
+    uint32_t stalls;        /*!< Times the capture path waited for the writer task */
+    uint32_t rotations;     /*!< Completed file switches */
+    uint32_t rotation_failures; /*!< Switches that failed, the capture went on in the current file */
+    uint32_t bytes_in;      /*!< Bytes compressed by the writer, 0 without CONFIG_PCAP_COMPRESSION_ENABLED */
+    uint32_t bytes_out;     /*!< Compressed size of those bytes */
+    uint32_t commits;       /*!< File syncs done by the group commit, closed files not counted */
+} pcap_writer_stats_t;
+
+/**
+ * @brief Capture a frame in the format selected by CONFIG_CAPTURE_FORMAT
+ *
+ * @param frame captured frame and its metadata
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-esp_err_t packet_capture(void *payload, uint32_t length, uint32_t seconds, uint32_t microseconds);
+esp_err_t packet_capture(const capture_frame_t *frame);
+
+/**
+ * @brief Store the capture counters, if the format selected by CONFIG_CAPTURE_FORMAT has a record for them
+ *
+ * Called from the task calling packet_capture(), between packets.
+ *
+ * @param stats capture counters of the session so far
+ * @return esp_err_t
+ *      - ESP_OK on success, also if the format has no statistics records
+ *      - ESP_ERR_INVALID_STATE if the pcap session is not started
+ */
+esp_err_t packet_capture_stats(const capture_stats_t *stats);
 
 /**
  * @brief Tell the pcap component to start sniff and write
@@ -55,12 +164,81 @@ esp_err_t sniff_packet_start(pcap_link_type_t link_type);
  */
 esp_err_t sniff_packet_stop(void);
 
+/**
+ * @brief Get occupancy of the pcap writer (storage stage)
+ *
+ * @param[out] stats writer statistics
+ */
+void pcap_get_writer_stats(pcap_writer_stats_t *stats);
+
+/**
+ * @brief Index of the file the records passed to packet_capture() now go to
+ *
+ * @return file index, ahead of the file being written while a rotation is pending
+ */
+uint32_t pcap_get_capture_index(void);
+
 /**
  * @brief Register pcap command
  *
  */
 void register_pcap_cmd(void);
 
+/**
+ * @brief Request a switch to the next file without stopping the capture
+ *
+ * The capture path switches at the next record boundary (see pcap_service()) and the writer task
+ * continues in the file it pre-opened in the background, so no frame is lost during the switch.
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if no file is open or a rotation is already pending
+ */
+esp_err_t pcap_rotate(void);
+
+/**
+ * @brief Set the rotation policy, replacing the defaults from config.h
+ *
+ * @param policy new rotation policy
+ */
+void pcap_set_rotation_policy(const pcap_rotation_policy_t *policy);
+
+/**
+ * @brief Recompute the next time-based rotation after the system clock was stepped
+ *
+ * The boundary is a wall-clock time, a step would fire it at once or hold it off by the step.
+ * Must be called by the task calling pcap_service().
+ */
+void pcap_clock_stepped(void);
+
+/**
+ * @brief Evaluate the rotation policy and switch files if due
+ *
+ * Must be called between packets by the task calling packet_capture(), also when no packets arrive.
+ * Also hands a partial block to the writer task once its oldest record waited CONFIG_PCAP_COMMIT_INTERVAL_MS,
+ * to be synced to the card.
+ *
+ * @return reason of the rotation started by this call, PCAP_ROTATE_NONE if none
+ */
+pcap_rotate_reason_t pcap_service(void);
+
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+/**
+ * @brief Write the capture files into the segment log on a raw device instead of the file system
+ *
+ * Opens the log at CONFIG_SEGLOG_FIRST_SECTOR, creating it if the device holds none, and resumes after
+ * its last intact segment. Must be called before pcap_open().
+ *
+ * @param dev device, e.g. the SD card
+ * @param new_id identifier in case a new log is created, should be random
+ * @param[out] next_idx index to pass to pcap_open(), following the last file in the log
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - error of seglog_open() otherwise
+ */
+esp_err_t pcap_attach_log(block_dev_t *dev, uint32_t new_id, uint32_t *next_idx);
+#endif
+
 esp_err_t pcap_close(void);
 esp_err_t pcap_open(uint32_t idx);
 #ifdef __cplusplus
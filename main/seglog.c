@@ -0,0 +1,281 @@
+/* Segment log — append-only capture log of checksummed segments on raw sectors, without a file system.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stddef.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "seglog.h"
+#ifdef ESP_PLATFORM
+#include "esp_rom_crc.h"
+#endif
+
+static const char *SEGLOG_TAG = "seglog";
+
+_Static_assert(sizeof(seglog_log_header_t) <= SEGLOG_SECTOR_SIZE, "log header does not fit a sector");
+
+uint32_t seglog_crc32(const void *data, uint32_t length)
+{
+#ifdef ESP_PLATFORM
+    return esp_rom_crc32_le(0, data, length);
+#else
+    static uint32_t table[256];
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    if (table[1] == 0)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+    while (length--)
+    {
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+#endif
+}
+
+static uint32_t seglog_slot_sector(const seglog_t *log, uint32_t slot)
+{
+    return log->first_sector + 1 + slot * log->slot_sectors;
+}
+
+uint32_t seglog_slot_size(const seglog_t *log)
+{
+    return log->slot_sectors * SEGLOG_SECTOR_SIZE;
+}
+
+/* Check the log header in sector and take the geometry from it */
+static esp_err_t seglog_load(seglog_t *log, block_dev_t *dev, uint32_t first_sector, uint8_t *sector)
+{
+    seglog_log_header_t header;
+
+    memset(log, 0, sizeof(*log));
+    log->dev = dev;
+    log->first_sector = first_sector;
+    if (dev->sector_size != SEGLOG_SECTOR_SIZE || first_sector >= dev->sector_count)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t ret = dev->read(dev, first_sector, sector, 1);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    memcpy(&header, sector, sizeof(header));
+    if (header.magic != SEGLOG_LOG_MAGIC || header.version != SEGLOG_VERSION ||
+        header.crc != seglog_crc32(&header, offsetof(seglog_log_header_t, crc)) || header.slot_sectors == 0 ||
+        SEGLOG_SLOT_SIZE(header.payload_max) != header.slot_sectors * SEGLOG_SECTOR_SIZE)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    log->log_id = header.log_id;
+    log->slot_sectors = header.slot_sectors;
+    log->payload_max = header.payload_max;
+    log->slot_count = (dev->sector_count - first_sector - 1) / header.slot_sectors;
+    memcpy(log->name_mask, header.name_mask, sizeof(log->name_mask));
+    log->name_mask[sizeof(log->name_mask) - 1] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t seglog_mount(seglog_t *log, block_dev_t *dev, uint32_t first_sector)
+{
+    uint8_t sector[SEGLOG_SECTOR_SIZE] __attribute__((aligned(4)));
+
+    return seglog_load(log, dev, first_sector, sector);
+}
+
+/* Header of the segment in a slot, read into log->buffer; ESP_ERR_NOT_FOUND if it is not one of this log */
+static esp_err_t seglog_read_header(seglog_t *log, uint32_t slot, seglog_header_t *header)
+{
+    esp_err_t ret = log->dev->read(log->dev, seglog_slot_sector(log, slot), log->buffer, 1);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    memcpy(header, log->buffer, sizeof(*header));
+    if (header->magic != SEGLOG_SEGMENT_MAGIC || header->log_id != log->log_id || header->sequence != slot ||
+        header->length > log->payload_max ||
+        header->header_crc != seglog_crc32(header, offsetof(seglog_header_t, header_crc)))
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t seglog_read(seglog_t *log, uint32_t slot, seglog_header_t *header, const uint8_t **payload)
+{
+    if (slot >= log->slot_count)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = seglog_read_header(log, slot, header);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    uint32_t sectors = SEGLOG_SLOT_SIZE(header->length) / SEGLOG_SECTOR_SIZE;
+    if (sectors > 1)
+    {
+        ret = log->dev->read(log->dev, seglog_slot_sector(log, slot) + 1, log->buffer + SEGLOG_SECTOR_SIZE,
+                             sectors - 1);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+    *payload = log->buffer + sizeof(seglog_header_t);
+    return seglog_crc32(*payload, header->length) == header->payload_crc ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+/* Find the end of the log: segments fill the slots from the first one on, so the intact ones form a prefix */
+static esp_err_t seglog_resume(seglog_t *log)
+{
+    seglog_header_t header;
+    const uint8_t *payload;
+    uint32_t low = 0;
+    uint32_t high = log->slot_count;
+    esp_err_t ret;
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        ret = seglog_read_header(log, middle, &header);
+        if (ret == ESP_OK)
+        {
+            low = middle + 1;
+        }
+        else if (ret == ESP_ERR_NOT_FOUND)
+        {
+            high = middle;
+        }
+        else
+        {
+            return ret;
+        }
+    }
+    /* the last segment may have been cut short by a power loss, it is written again */
+    while (low > 0 && (ret = seglog_read(log, low - 1, &header, &payload)) != ESP_OK)
+    {
+        if (ret != ESP_ERR_INVALID_CRC && ret != ESP_ERR_NOT_FOUND)
+        {
+            return ret;
+        }
+        ESP_LOGW(SEGLOG_TAG, "segment %u is damaged, overwriting it", low - 1);
+        low--;
+    }
+    log->next_slot = low;
+    log->last_file = low > 0 ? header.file_index : 0;
+    return ESP_OK;
+}
+
+static esp_err_t seglog_create(seglog_t *log, uint32_t new_id)
+{
+    seglog_log_header_t header = {
+        .magic = SEGLOG_LOG_MAGIC,
+        .version = SEGLOG_VERSION,
+        .log_id = new_id,
+        .slot_sectors = log->slot_sectors,
+        .payload_max = log->payload_max,
+    };
+
+    strncpy(header.name_mask, log->name_mask, sizeof(header.name_mask) - 1);
+    header.crc = seglog_crc32(&header, offsetof(seglog_log_header_t, crc));
+    memset(log->buffer, 0, SEGLOG_SECTOR_SIZE);
+    memcpy(log->buffer, &header, sizeof(header));
+    log->log_id = new_id;
+    log->next_slot = 0;
+    log->last_file = 0;
+    return log->dev->write(log->dev, log->first_sector, log->buffer, 1);
+}
+
+esp_err_t seglog_open(seglog_t *log, block_dev_t *dev, uint32_t first_sector, uint32_t payload_max,
+                      const char *name_mask, uint32_t new_id, uint8_t *buffer)
+{
+    esp_err_t ret = seglog_load(log, dev, first_sector, buffer);
+    uint32_t slot_sectors = SEGLOG_SLOT_SIZE(payload_max) / SEGLOG_SECTOR_SIZE;
+
+    log->buffer = buffer;
+    if (ret == ESP_ERR_NOT_FOUND)
+    {
+        log->slot_sectors = slot_sectors;
+        log->payload_max = payload_max;
+        log->slot_count = (dev->sector_count - first_sector - 1) / slot_sectors;
+        strncpy(log->name_mask, name_mask, sizeof(log->name_mask) - 1);
+        ESP_GOTO_ON_FALSE(log->slot_count > 0, ESP_ERR_INVALID_SIZE, err, SEGLOG_TAG, "device too small");
+        ESP_GOTO_ON_ERROR(seglog_create(log, new_id), err, SEGLOG_TAG, "write log header failed");
+        ESP_LOGI(SEGLOG_TAG, "new log %08x, %u segments of %u bytes", log->log_id, log->slot_count, payload_max);
+        return ESP_OK;
+    }
+    ESP_GOTO_ON_ERROR(ret, err, SEGLOG_TAG, "read log header failed");
+    ESP_GOTO_ON_FALSE(log->slot_sectors == slot_sectors && log->payload_max == payload_max &&
+                      strncmp(log->name_mask, name_mask, sizeof(log->name_mask) - 1) == 0,
+                      ESP_ERR_INVALID_STATE, err, SEGLOG_TAG,
+                      "device holds a log of %u byte segments of %s, extract and erase it first",
+                      log->payload_max, log->name_mask);
+    ESP_GOTO_ON_ERROR(seglog_resume(log), err, SEGLOG_TAG, "scan for the end of the log failed");
+    ESP_LOGI(SEGLOG_TAG, "log %08x resumed after %u of %u segments", log->log_id, log->next_slot, log->slot_count);
+err:
+    return ret;
+}
+
+esp_err_t seglog_append(seglog_t *log, uint32_t file_index, const void *data, uint32_t length)
+{
+    const uint8_t *src = (const uint8_t *)data;
+
+    while (length > 0)
+    {
+        uint32_t chunk = length < log->payload_max ? length : log->payload_max;
+        if (log->next_slot >= log->slot_count)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        seglog_header_t header = {
+            .magic = SEGLOG_SEGMENT_MAGIC,
+            .log_id = log->log_id,
+            .sequence = log->next_slot,
+            .file_index = file_index,
+            .length = chunk,
+            .payload_crc = seglog_crc32(src, chunk),
+        };
+        header.header_crc = seglog_crc32(&header, offsetof(seglog_header_t, header_crc));
+
+        /* header and payload go out in one multi-sector write, only the sectors in use */
+        uint32_t used = sizeof(header) + chunk;
+        uint32_t size = SEGLOG_SLOT_SIZE(chunk);
+        memcpy(log->buffer, &header, sizeof(header));
+        memcpy(log->buffer + sizeof(header), src, chunk);
+        memset(log->buffer + used, 0, size - used);
+        esp_err_t ret = log->dev->write(log->dev, seglog_slot_sector(log, log->next_slot), log->buffer,
+                                        size / SEGLOG_SECTOR_SIZE);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+        log->next_slot++;
+        log->last_file = file_index;
+        src += chunk;
+        length -= chunk;
+    }
+    return ESP_OK;
+}
+
+bool seglog_last_file(const seglog_t *log, uint32_t *file_index)
+{
+    *file_index = log->last_file;
+    return log->next_slot > 0;
+}
@@ -0,0 +1,172 @@
+/* Segment log — declarations of the append-only capture log on raw sectors.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "block_dev.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Layout from the first sector on: one sector with the log header, then fixed-size slots, each holding one
+ * segment: a seglog_header_t followed by up to payload_max bytes of one capture file. Segments are written in
+ * slot order and numbered by their slot, so the end of the log is found by a binary search over the slots.
+ * All fields are little-endian, as on the ESP32.
+ */
+#define SEGLOG_SECTOR_SIZE      (512)
+#define SEGLOG_LOG_MAGIC        (0x484C4753)    /* "SGLH" */
+#define SEGLOG_SEGMENT_MAGIC    (0x53474553)    /* "SEGS" */
+#define SEGLOG_VERSION          (1)
+#define SEGLOG_NAME_MAX         (32)
+
+/* Bytes of a slot carrying up to payload bytes */
+#define SEGLOG_SLOT_SIZE(payload) \
+    ((sizeof(seglog_header_t) + (payload) + SEGLOG_SECTOR_SIZE - 1) / SEGLOG_SECTOR_SIZE * SEGLOG_SECTOR_SIZE)
+
+/**
+ * @brief Log header, in the first sector
+ *
+ */
+typedef struct {
+    uint32_t magic;         /*!< SEGLOG_LOG_MAGIC */
+    uint32_t version;       /*!< SEGLOG_VERSION */
+    uint32_t log_id;        /*!< Random, tells the segments of this log from those of an earlier one */
+    uint32_t slot_sectors;  /*!< Sectors per slot */
+    uint32_t payload_max;   /*!< Payload bytes per segment at most */
+    char name_mask[SEGLOG_NAME_MAX]; /*!< File name of the capture files, printf format taking the file index */
+    uint32_t crc;           /*!< CRC-32 of the fields above */
+} seglog_log_header_t;
+
+/**
+ * @brief Segment header, at the start of every slot
+ *
+ */
+typedef struct {
+    uint32_t magic;         /*!< SEGLOG_SEGMENT_MAGIC */
+    uint32_t log_id;        /*!< Log the segment belongs to */
+    uint32_t sequence;      /*!< Number of the segment, equal to its slot */
+    uint32_t file_index;    /*!< Capture file the payload is part of */
+    uint32_t length;        /*!< Payload bytes */
+    uint32_t payload_crc;   /*!< CRC-32 of the payload */
+    uint32_t reserved;
+    uint32_t header_crc;    /*!< CRC-32 of the fields above */
+} seglog_header_t;
+
+/**
+ * @brief Open segment log
+ *
+ */
+typedef struct {
+    block_dev_t *dev;
+    uint32_t first_sector;  /*!< Sector of the log header */
+    uint32_t slot_sectors;  /*!< Sectors per slot */
+    uint32_t slot_count;    /*!< Slots fitting on the device */
+    uint32_t payload_max;   /*!< Payload bytes per segment at most */
+    uint32_t log_id;        /*!< Identifier of the log */
+    uint32_t next_slot;     /*!< Slot of the next segment, i.e. number of segments in the log */
+    uint32_t last_file;     /*!< File index of the last segment, if there is one */
+    uint8_t *buffer;        /*!< One slot, set by the caller */
+    char name_mask[SEGLOG_NAME_MAX]; /*!< File name of the capture files */
+} seglog_t;
+
+/**
+ * @brief Open the log on a device for appending, creating it if the device holds none
+ *
+ * An existing log is resumed after its last intact segment; a segment cut short by a power loss is
+ * overwritten.
+ *
+ * @param[out] log log
+ * @param dev device with SEGLOG_SECTOR_SIZE sectors
+ * @param first_sector sector of the log header
+ * @param payload_max payload bytes per segment
+ * @param name_mask file name of the capture files, recorded for the extractor
+ * @param new_id identifier in case a new log is created, should be random
+ * @param buffer SEGLOG_SLOT_SIZE(payload_max) bytes, 4-byte aligned
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the device holds a log with a different geometry or file name
+ *      - ESP_ERR_INVALID_SIZE if the device is too small or its sector size is not SEGLOG_SECTOR_SIZE
+ *      - error of the device otherwise
+ */
+esp_err_t seglog_open(seglog_t *log, block_dev_t *dev, uint32_t first_sector, uint32_t payload_max,
+                      const char *name_mask, uint32_t new_id, uint8_t *buffer);
+
+/**
+ * @brief Open an existing log for reading
+ *
+ * Sets up everything but log->buffer, which must then point to seglog_slot_size() bytes.
+ *
+ * @param[out] log log
+ * @param dev device
+ * @param first_sector sector of the log header
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if there is no valid log header
+ */
+esp_err_t seglog_mount(seglog_t *log, block_dev_t *dev, uint32_t first_sector);
+
+/**
+ * @brief Bytes of one slot of the log
+ *
+ */
+uint32_t seglog_slot_size(const seglog_t *log);
+
+/**
+ * @brief Append data of a capture file, as one segment or more if longer than payload_max
+ *
+ * Every segment is one write to the device; the data is durable once the call returns.
+ *
+ * @param log log opened with seglog_open()
+ * @param file_index capture file the data belongs to
+ * @param data data
+ * @param length bytes
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NO_MEM if the log is full
+ *      - error of the device otherwise
+ */
+esp_err_t seglog_append(seglog_t *log, uint32_t file_index, const void *data, uint32_t length);
+
+/**
+ * @brief Read the segment in a slot into log->buffer
+ *
+ * @param log log
+ * @param slot slot
+ * @param[out] header header of the segment
+ * @param[out] payload payload of the segment, within log->buffer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the slot holds no segment of this log
+ *      - ESP_ERR_INVALID_CRC if the segment header is intact but the payload is not
+ *      - error of the device otherwise
+ */
+esp_err_t seglog_read(seglog_t *log, uint32_t slot, seglog_header_t *header, const uint8_t **payload);
+
+/**
+ * @brief File index of the last segment in the log
+ *
+ * @param log log
+ * @param[out] file_index file index
+ * @return true if the log holds a segment
+ */
+bool seglog_last_file(const seglog_t *log, uint32_t *file_index);
+
+/**
+ * @brief CRC-32 (IEEE 802.3, as zlib) of a buffer
+ *
+ */
+uint32_t seglog_crc32(const void *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+/* Compact sink — fixed-size binary records, see capture_record.h.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "capture_sink.h"
+#include "capture_record.h"
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_COMPACT
+
+_Static_assert(sizeof(capture_file_header_t) <= CAPTURE_SINK_HEADER_MAX, "file header does not fit");
+_Static_assert(sizeof(capture_record_t) <= CAPTURE_SINK_HEAD_MAX, "record does not fit");
+
+uint32_t capture_sink_file_header(uint8_t *buf)
+{
+    capture_file_header_t header = {
+        .magic = CAPTURE_RECORD_MAGIC,
+        .version = CAPTURE_RECORD_VERSION,
+        .record_size = sizeof(capture_record_t),
+    };
+
+    memcpy(buf, &header, sizeof(header));
+    return sizeof(header);
+}
+
+void capture_sink_record(const capture_frame_t *frame, capture_sink_record_t *out)
+{
+    const packet_control_header_t *hdr = (const packet_control_header_t *)frame->payload;
+    capture_record_t record = {
+        .seconds = frame->seconds,
+        .microseconds = frame->microseconds,
+        .rssi = frame->rssi,
+        .channel = frame->channel,
+        .seq_ctrl = hdr->sequence_number,
+        .flags = 0,
+        .ssid_hash = ie_hash(frame->ies->ssid.data, frame->ies->ssid.length),
+        .fingerprint = frame->ies->fingerprint,
+    };
+
+    memcpy(record.mac, hdr->addr2, sizeof(record.mac));
+    if (frame->overload != OVERLOAD_FULL)
+    {
+        record.flags |= CAPTURE_RECORD_FLAG_SUMMARY;
+        record.ssid_hash = 0;
+        record.fingerprint = 0;
+        if (frame->overload == OVERLOAD_SAMPLED)
+        {
+            record.flags |= CAPTURE_RECORD_FLAG_SAMPLED;
+        }
+    }
+    else if (frame->ies->ssid.length == 0)
+    {
+        record.flags |= CAPTURE_RECORD_FLAG_WILDCARD_SSID;
+    }
+    if (frame->ies->malformed)
+    {
+        record.flags |= CAPTURE_RECORD_FLAG_MALFORMED;
+    }
+    memcpy(out->head, &record, sizeof(record));
+    out->head_length = sizeof(record);
+    out->body = NULL;
+    out->body_length = 0;
+    out->tail_length = 0;
+}
+
+uint32_t capture_sink_stats(const capture_stats_t *stats, uint8_t *buf)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/* CSV sink — one text line with time, transmitter MAC and RSSI per frame.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "capture_sink.h"
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_CSV
+
+static const char csv_header[] = "time,mac,rssi,channel,mode\n";
+
+_Static_assert(sizeof(csv_header) - 1 <= CAPTURE_SINK_HEADER_MAX, "CSV header does not fit");
+
+uint32_t capture_sink_file_header(uint8_t *buf)
+{
+    memcpy(buf, csv_header, sizeof(csv_header) - 1);
+    return sizeof(csv_header) - 1;
+}
+
+void capture_sink_record(const capture_frame_t *frame, capture_sink_record_t *record)
+{
+    const packet_control_header_t *hdr = (const packet_control_header_t *)frame->payload;
+    /* longest line: 10 + 1 + 6 digits, 17 for the MAC, 4 for the RSSI, 3 for the channel, 7 for the mode,
+       separators */
+    int length = snprintf((char *)record->head, CAPTURE_SINK_HEAD_MAX,
+                          "%u.%06u,%02x:%02x:%02x:%02x:%02x:%02x,%d,%u,%s\n",
+                          (unsigned)frame->seconds, (unsigned)frame->microseconds,
+                          hdr->addr2[0], hdr->addr2[1], hdr->addr2[2], hdr->addr2[3], hdr->addr2[4], hdr->addr2[5],
+                          frame->rssi, frame->channel, overload_mode_name(frame->overload));
+
+    record->head_length = length;
+    record->body = NULL;
+    record->body_length = 0;
+    record->tail_length = 0;
+}
+
+uint32_t capture_sink_stats(const capture_stats_t *stats, uint8_t *buf)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,123 @@
+/* pcap sink — 802.11 frames in pcap files, raw or with a radiotap header.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "capture_sink.h"
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_PCAP || CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_RADIOTAP || \
+    CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_RADIOTAP_CSI
+
+#define PCAP_MAGIC                  (0xA1B2C3D4)
+#define PCAP_VERSION_MAJOR          (2)
+#define PCAP_VERSION_MINOR          (4)
+#define PCAP_SNAPLEN                (0xFFFF)
+
+#if CONFIG_CAPTURE_FORMAT != CAPTURE_FORMAT_PCAP
+#define SINK_RADIOTAP               (1)
+#define RADIOTAP_PRESENT_FLAGS      (1 << 1)
+#define RADIOTAP_PRESENT_RATE       (1 << 2)
+#define RADIOTAP_PRESENT_CHANNEL    (1 << 3)
+#define RADIOTAP_PRESENT_ANTSIGNAL  (1 << 5)
+#define RADIOTAP_CHAN_2GHZ          (0x0080)
+#endif
+
+/* pcap file header, see https://wiki.wireshark.org/Development/LibpcapFileFormat */
+typedef struct {
+    uint32_t magic;
+    uint16_t major;
+    uint16_t minor;
+    uint32_t zone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t link_type;
+} pcap_file_header_t;
+
+/* pcap per-packet record header */
+typedef struct {
+    uint32_t seconds;
+    uint32_t microseconds;
+    uint32_t capture_length;
+    uint32_t packet_length;
+} pcap_packet_header_t;
+
+#if SINK_RADIOTAP
+/* Radiotap header with flags, rate, channel and antenna signal, see https://www.radiotap.org */
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t pad;
+    uint16_t length;
+    uint32_t present;
+    uint8_t flags;              /* no FCS at the end of the frame */
+    uint8_t rate;               /* 500 kbps units */
+    uint16_t channel_freq;      /* MHz */
+    uint16_t channel_flags;
+    int8_t antenna_signal;      /* dBm */
+} radiotap_header_t;
+
+_Static_assert(sizeof(pcap_packet_header_t) + sizeof(radiotap_header_t) <= CAPTURE_SINK_HEAD_MAX,
+               "record head does not fit");
+#endif
+
+uint32_t capture_sink_file_header(uint8_t *buf)
+{
+    pcap_file_header_t header = {
+        .magic = PCAP_MAGIC,
+        .major = PCAP_VERSION_MAJOR,
+        .minor = PCAP_VERSION_MINOR,
+        .zone = 0,
+        .sigfigs = 0,
+        .snaplen = PCAP_SNAPLEN,
+        .link_type = CAPTURE_SINK_LINK_TYPE,
+    };
+
+    memcpy(buf, &header, sizeof(header));
+    return sizeof(header);
+}
+
+void capture_sink_record(const capture_frame_t *frame, capture_sink_record_t *record)
+{
+    pcap_packet_header_t header = {
+        .seconds = frame->seconds,
+        .microseconds = frame->microseconds,
+        .capture_length = frame->length,
+        .packet_length = frame->orig_length,
+    };
+    uint32_t length = sizeof(header);
+
+#if SINK_RADIOTAP
+    radiotap_header_t radiotap = {
+        .version = 0,
+        .pad = 0,
+        .length = sizeof(radiotap_header_t),
+        .present = RADIOTAP_PRESENT_FLAGS | RADIOTAP_PRESENT_RATE | RADIOTAP_PRESENT_CHANNEL |
+                   RADIOTAP_PRESENT_ANTSIGNAL,
+        .flags = 0,
+        .rate = frame->rate,
+        .channel_freq = frame->channel == 14 ? 2484 : 2407 + 5 * frame->channel,
+        .channel_flags = RADIOTAP_CHAN_2GHZ,
+        .antenna_signal = frame->rssi,
+    };
+
+    header.capture_length += sizeof(radiotap);
+    header.packet_length += sizeof(radiotap);
+    memcpy(record->head + length, &radiotap, sizeof(radiotap));
+    length += sizeof(radiotap);
+#endif
+    memcpy(record->head, &header, sizeof(header));
+    record->head_length = length;
+    record->body = frame->payload;
+    record->body_length = frame->length;
+    record->tail_length = 0;
+}
+
+uint32_t capture_sink_stats(const capture_stats_t *stats, uint8_t *buf)
+{
+    return 0;
+}
+
+#endif
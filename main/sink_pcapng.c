@@ -0,0 +1,258 @@
+/* pcapng sink — 802.11 frames in pcapng files with channel/RSSI per packet and interface statistics.
+
+   See https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-02.html for the block layouts. Blocks are
+   written in host byte order, readers tell it from the byte-order magic of the section header.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_app_desc.h"
+#else
+#include "esp_ota_ops.h"
+#define esp_app_get_description()   esp_ota_get_app_description()
+#endif
+#include "capture_sink.h"
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_PCAPNG
+
+#define PCAPNG_BLOCK_SHB            (0x0A0D0D0A)
+#define PCAPNG_BLOCK_IDB            (0x00000001)
+#define PCAPNG_BLOCK_ISB            (0x00000005)
+#define PCAPNG_BLOCK_EPB            (0x00000006)
+#define PCAPNG_BYTE_ORDER_MAGIC     (0x1A2B3C4D)
+#define PCAPNG_SNAPLEN              (0xFFFF)
+
+#define PCAPNG_OPT_END              (0)
+#define PCAPNG_OPT_COMMENT          (1)
+#define PCAPNG_SHB_HARDWARE         (2)
+#define PCAPNG_SHB_OS               (3)
+#define PCAPNG_SHB_USERAPPL         (4)
+#define PCAPNG_IF_NAME              (2)
+#define PCAPNG_ISB_STARTTIME        (2)
+#define PCAPNG_ISB_ENDTIME          (3)
+#define PCAPNG_ISB_IFRECV           (4)
+#define PCAPNG_ISB_FILTERACCEPT     (6)
+#define PCAPNG_ISB_OSDROP           (7)
+#define PCAPNG_ISB_USRDELIV         (8)
+
+#define PCAPNG_ALIGN(x)             (((x) + 3) & ~3u)
+/* block type and total length in front, total length again at the end */
+#define PCAPNG_BLOCK_OVERHEAD       (12)
+#define PCAPNG_OPTION_SIZE(len)     (4 + PCAPNG_ALIGN(len))
+
+#ifdef IDF_VER
+#define PCAPNG_OS                   "ESP-IDF " IDF_VER
+#else
+#define PCAPNG_OS                   "ESP-IDF"
+#endif
+#define PCAPNG_HARDWARE             "ESP32"
+#define PCAPNG_APPLICATION          "esp32-probe-sniffer"
+/* application name, a space and the firmware version from the app description (at most 32 characters) */
+#define PCAPNG_USERAPPL_MAX         (sizeof(PCAPNG_APPLICATION) + 32)
+#define PCAPNG_INTERFACE            "esp32 wlan"
+/* "channel 14, rssi -128 dBm, sampled" */
+#define PCAPNG_COMMENT_MAX          (40)
+
+_Static_assert(PCAPNG_BLOCK_OVERHEAD + 16 + PCAPNG_OPTION_SIZE(sizeof(PCAPNG_HARDWARE)) +
+               PCAPNG_OPTION_SIZE(sizeof(PCAPNG_OS)) + PCAPNG_OPTION_SIZE(PCAPNG_USERAPPL_MAX) + 4 +
+               PCAPNG_BLOCK_OVERHEAD + 8 + PCAPNG_OPTION_SIZE(sizeof(PCAPNG_INTERFACE)) + 4 <= CAPTURE_SINK_HEADER_MAX,
+               "section header does not fit");
+_Static_assert(3 + PCAPNG_OPTION_SIZE(PCAPNG_COMMENT_MAX) + 4 + 4 <= CAPTURE_SINK_TAIL_MAX, "packet tail does not fit");
+_Static_assert(PCAPNG_BLOCK_OVERHEAD + 12 + 6 * PCAPNG_OPTION_SIZE(8) + 4 <= CAPTURE_SINK_STATS_MAX,
+               "statistics block does not fit");
+
+static inline uint8_t *put16(uint8_t *p, uint16_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+static inline uint8_t *put32(uint8_t *p, uint32_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+/* 64-bit values in pcapng timestamps are split into the upper and the lower 32 bits */
+static inline uint8_t *put_timestamp(uint8_t *p, uint64_t value)
+{
+    p = put32(p, value >> 32);
+    return put32(p, (uint32_t)value);
+}
+
+static inline uint8_t *put64(uint8_t *p, uint64_t value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+static uint8_t *put_option(uint8_t *p, uint16_t code, const void *value, uint16_t length)
+{
+    p = put16(p, code);
+    p = put16(p, length);
+    memcpy(p, value, length);
+    memset(p + length, 0, PCAPNG_ALIGN(length) - length);
+    return p + PCAPNG_ALIGN(length);
+}
+
+static inline uint8_t *put_option_end(uint8_t *p)
+{
+    return put32(p, PCAPNG_OPT_END);
+}
+
+/* Fill in the total length at both ends of the block starting at block and ending before end */
+static uint32_t finish_block(uint8_t *block, uint8_t *end)
+{
+    uint32_t length = end + 4 - block;
+
+    put32(block + 4, length);
+    put32(end, length);
+    return length;
+}
+
+static char *put_decimal(char *p, int32_t value)
+{
+    char digits[10];
+    uint32_t magnitude = value < 0 ? -value : value;
+    uint32_t count = 0;
+
+    if (value < 0)
+    {
+        *p++ = '-';
+    }
+    do
+    {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    while (count)
+    {
+        *p++ = digits[--count];
+    }
+    return p;
+}
+
+static inline uint64_t timestamp_us(uint32_t seconds, uint32_t microseconds)
+{
+    return (uint64_t)seconds * 1000000 + microseconds;
+}
+
+uint32_t capture_sink_file_header(uint8_t *buf)
+{
+    uint8_t *p = buf;
+    uint8_t *block = p;
+    const char *version = esp_app_get_description()->version;
+    char userappl[PCAPNG_USERAPPL_MAX];
+    uint16_t userappl_len = sizeof(PCAPNG_APPLICATION) - 1;
+
+    /* application and firmware version, so a capture can be traced back to the build that wrote it */
+    memcpy(userappl, PCAPNG_APPLICATION, userappl_len);
+    if (version[0])
+    {
+        uint16_t version_len = strnlen(version, PCAPNG_USERAPPL_MAX - sizeof(PCAPNG_APPLICATION));
+
+        userappl[userappl_len++] = ' ';
+        memcpy(userappl + userappl_len, version, version_len);
+        userappl_len += version_len;
+    }
+
+    /* section header: byte order, version 1.0, unknown section length */
+    p = put32(p, PCAPNG_BLOCK_SHB);
+    p += 4;
+    p = put32(p, PCAPNG_BYTE_ORDER_MAGIC);
+    p = put16(p, 1);
+    p = put16(p, 0);
+    p = put64(p, UINT64_MAX);
+    p = put_option(p, PCAPNG_SHB_HARDWARE, PCAPNG_HARDWARE, sizeof(PCAPNG_HARDWARE) - 1);
+    p = put_option(p, PCAPNG_SHB_OS, PCAPNG_OS, sizeof(PCAPNG_OS) - 1);
+    p = put_option(p, PCAPNG_SHB_USERAPPL, userappl, userappl_len);
+    p = put_option_end(p);
+    p = block + finish_block(block, p);
+
+    /* the one interface, microsecond timestamps (the default resolution) */
+    block = p;
+    p = put32(p, PCAPNG_BLOCK_IDB);
+    p += 4;
+    p = put16(p, CAPTURE_SINK_LINK_TYPE);
+    p = put16(p, 0);
+    p = put32(p, PCAPNG_SNAPLEN);
+    p = put_option(p, PCAPNG_IF_NAME, PCAPNG_INTERFACE, sizeof(PCAPNG_INTERFACE) - 1);
+    p = put_option_end(p);
+    p = block + finish_block(block, p);
+    return p - buf;
+}
+
+void capture_sink_record(const capture_frame_t *frame, capture_sink_record_t *record)
+{
+    uint8_t *p = record->head;
+    uint64_t timestamp = timestamp_us(frame->seconds, frame->microseconds);
+    uint32_t padding = PCAPNG_ALIGN(frame->length) - frame->length;
+    char comment[PCAPNG_COMMENT_MAX];
+    char *c = comment;
+
+    /* channel and RSSI as packet comment, shown by Wireshark and matched by frame.comment */
+    memcpy(c, "channel ", 8);
+    c = put_decimal(c + 8, frame->channel);
+    memcpy(c, ", rssi ", 7);
+    c = put_decimal(c + 7, frame->rssi);
+    memcpy(c, " dBm", 4);
+    c += 4;
+    /* frames shed by the overload control say so, analysts weigh them accordingly */
+    if (frame->overload != OVERLOAD_FULL)
+    {
+        const char *mode = overload_mode_name(frame->overload);
+        uint32_t length = strlen(mode);
+        memcpy(c, ", ", 2);
+        memcpy(c + 2, mode, length);
+        c += 2 + length;
+    }
+
+    p = put32(p, PCAPNG_BLOCK_EPB);
+    p += 4;
+    p = put32(p, 0);
+    p = put_timestamp(p, timestamp);
+    p = put32(p, frame->length);
+    p = put32(p, frame->orig_length);
+    record->head_length = p - record->head;
+    record->body = frame->payload;
+    record->body_length = frame->length;
+
+    p = record->tail;
+    memset(p, 0, padding);
+    p = put_option(p + padding, PCAPNG_OPT_COMMENT, comment, c - comment);
+    p = put_option_end(p);
+    uint32_t length = record->head_length + frame->length + (p - record->tail) + 4;
+    put32(record->head + 4, length);
+    p = put32(p, length);
+    record->tail_length = p - record->tail;
+}
+
+uint32_t capture_sink_stats(const capture_stats_t *stats, uint8_t *buf)
+{
+    uint8_t *p = buf;
+    uint64_t now = timestamp_us(stats->seconds, stats->microseconds);
+    uint8_t value[8];
+
+    p = put32(p, PCAPNG_BLOCK_ISB);
+    p += 4;
+    p = put32(p, 0);
+    p = put_timestamp(p, now);
+    put_timestamp(value, timestamp_us(stats->start_seconds, 0));
+    p = put_option(p, PCAPNG_ISB_STARTTIME, value, sizeof(value));
+    put_timestamp(value, now);
+    p = put_option(p, PCAPNG_ISB_ENDTIME, value, sizeof(value));
+    p = put_option(p, PCAPNG_ISB_IFRECV, &stats->received, sizeof(stats->received));
+    p = put_option(p, PCAPNG_ISB_FILTERACCEPT, &stats->accepted, sizeof(stats->accepted));
+    p = put_option(p, PCAPNG_ISB_OSDROP, &stats->dropped, sizeof(stats->dropped));
+    p = put_option(p, PCAPNG_ISB_USRDELIV, &stats->delivered, sizeof(stats->delivered));
+    p = put_option_end(p);
+    return finish_block(buf, p);
+}
+
+#endif
@@ -16,10 +16,22 @@
 #include <sys/fcntl.h>
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "esp_console.h"
 #include "esp_app_trace.h"
 #include "sniffer.h"
 #include "pcap_lib.h"
+#include "capture_ring.h"
+#include "channel_hop.h"
+#include "dedup.h"
+#include "frame_filter.h"
+#include "overload.h"
+#include "ie_parser.h"
+#include "capture_sink.h"
+#include "csi_log.h"
+#include "telemetry.h"
+#include "timebase.h"
+#include "latency.h"
 #include "esp_check.h"
 #include "sdkconfig.h"
 #include "config.h"
@@ -30,6 +42,26 @@
 #define SNIFFER_PROCESS_PACKET_TIMEOUT_MS   (100)
 #define SNIFFER_RX_FCS_ERR                  (0X41)
 #define SNIFFER_DECIMAL_NUM                 (10)
+#define SNIFFER_RATE_HT                     (0xFF) /* rx_ctrl.rate is an MCS index, not a legacy rate */
+
+/* sniffer_packet_info_t::type */
+#define SNIFFER_RECORD_FRAME                (0) /* payload is the 802.11 frame */
+#define SNIFFER_RECORD_CSI                  (1) /* payload is the transmitter MAC followed by the CSI data */
+
+#define SNIFFER_CAPTURE_CSI                 (CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_RADIOTAP_CSI)
+#define SNIFFER_TRIM                        (CONFIG_SNIFFER_SNAPLEN || CONFIG_SNIFFER_IE_FILTER_ENABLED)
+#define SNIFFER_IE_HEADER_LEN               (2)
+#define SNIFFER_LOG_INTERVAL_MS             (5000) /* repeated warnings at most this often */
+
+#if CONFIG_SNIFFER_SNAPLEN && CONFIG_SNIFFER_SNAPLEN < 24
+#error "CONFIG_SNIFFER_SNAPLEN must cover the 24-byte MAC header"
+#endif
+
+/* the ring wait is timed with the cycle counter of the core taking the frame; the cores' counters differ */
+#if CONFIG_LATENCY_ENABLED && ((CONFIG_ESP32_WIFI_TASK_PINNED_TO_CORE_0 && CONFIG_SNIFFER_TASK_CORE != 0) || \
+                               (CONFIG_ESP32_WIFI_TASK_PINNED_TO_CORE_1 && CONFIG_SNIFFER_TASK_CORE != 1))
+#error "CONFIG_LATENCY_ENABLED needs the sniffer task on the core of the Wi-Fi task (CONFIG_SNIFFER_TASK_CORE)"
+#endif
 
 static const char *SNIFFER_TAG = "sniffer";
 
@@ -39,95 +71,447 @@ typedef struct {
     uint32_t interf_num;
     uint32_t channel;
     TaskHandle_t task;
-    QueueHandle_t work_queue;
+    capture_ring_t ring;
+    uint32_t ring_peak;
+    uint32_t reported_drops;
+    uint32_t rotations;             /* file switches seen by the sniffer task */
+    uint32_t rotation_failures;     /* failed file switches seen by the sniffer task */
+    volatile bool rotation_pending;
+    uint32_t rotation_drops_base;   /* ring drop counter when the pending rotation was started */
+    uint32_t rotation_drops;        /* frames dropped while a rotation was in progress */
+    dedup_table_t dedup;            /* repeated frames, only used by the promiscuous callback */
+    frame_filter_t filter;          /* compiled CONFIG_FILTER_* rules */
+    overload_t overload;            /* load shedding, updated by the callback only */
+    uint32_t overload_reported;     /* mode changes already logged by the sniffer task */
+    timebase_t timebase;            /* receive timestamps to epoch time, Wi-Fi task only */
+    uint32_t first_frame_ms;        /* uptime when the first frame was queued, 0 before */
+    uint32_t ie_malformed;          /* frames whose information elements overran the frame */
+    uint64_t session_base[TELEMETRY_COUNTER_COUNT]; /* telemetry counters when the session started */
+    telemetry_ratelimit_t drop_log;
+    telemetry_ratelimit_t write_log;
+    time_t started;                 /* start of the capture session */
+    time_t next_stats;              /* when the counters go into the output next */
+    volatile bool clock_stepped;    /* wall-clock deadlines to recompute by the sniffer task */
+    uint32_t trimmed;               /* frames shortened before the copy, callback only */
+    uint32_t trimmed_bytes;
+    uint32_t ie_allowed[256 / 32];  /* bitmap of CONFIG_SNIFFER_IE_ALLOW_LIST */
     SemaphoreHandle_t sem_task_over;
+    SemaphoreHandle_t radio_lock;   /* serializes start, stop and station use of the radio by time sync */
 } sniffer_runtime_t;
 
+/* Record stored in the capture ring: packet metadata followed by the frame itself */
 typedef struct {
-    void *payload;
     uint32_t length;
+    uint32_t orig_length;
     uint32_t seconds;
     uint32_t microseconds;
+    uint8_t channel;
+    int8_t rssi;
+    uint8_t rate;       /* rx_ctrl.rate, or SNIFFER_RATE_HT */
+    uint8_t type;       /* SNIFFER_RECORD_* */
+    uint8_t overload;   /* overload_mode_t the frame was captured in */
+#if CONFIG_LATENCY_ENABLED
+    uint32_t queued;    /* latency_ticks() at the commit, same core as the sniffer task */
+#endif
+    uint8_t payload[];
 } sniffer_packet_info_t;
 
+/* Legacy PHY rate codes of rx_ctrl.rate in 500 kbps units, as radiotap wants them */
+static const uint8_t snf_rate_500kbps[16] = {
+    2, 4, 11, 22, 0, 4, 11, 22,     /* 1, 2, 5.5, 11 Mbps long preamble, -, 2, 5.5, 11 Mbps short preamble */
+    96, 48, 24, 12, 108, 72, 36, 18 /* 48, 24, 12, 6, 54, 36, 18, 9 Mbps */
+};
+
 static sniffer_runtime_t snf_rt = {0};
+static uint8_t snf_ring_buf[CONFIG_SNIFFER_RING_SIZE] __attribute__((aligned(4)));
+#if CONFIG_DEDUP_ENABLED
+static dedup_entry_t snf_dedup_entries[CONFIG_DEDUP_TABLE_SIZE];
+#endif
 
-typedef struct {
-	int16_t frame_ctrl;
-	int16_t duration;
-	uint8_t addr1[6];
-	uint8_t addr2[6];
-	uint8_t addr3[6];
-	int16_t sequence_number;
-	unsigned char payload[];
-} packet_control_header_t;
-
-static void queue_packet(void *recv_packet, sniffer_packet_info_t *packet_info)
-{
-    /* Copy a packet from Link Layer driver and queue the copy to be processed by sniffer task */
-    void *packet_to_queue = malloc(packet_info->length);
-    if (packet_to_queue)
-    {
-        memcpy(packet_to_queue, recv_packet, packet_info->length);
-        packet_info->payload = packet_to_queue;
-        if (snf_rt.work_queue)
-        {
-            /* send packet_info */
-            if (xQueueSend(snf_rt.work_queue, packet_info, pdMS_TO_TICKS(SNIFFER_PROCESS_PACKET_TIMEOUT_MS)) != pdTRUE)
+#if SNIFFER_TRIM
+static inline bool ie_allowed(uint8_t id)
+{
+#if CONFIG_SNIFFER_IE_FILTER_ENABLED
+    return snf_rt.ie_allowed[id / 32] & (1u << (id % 32));
+#else
+    return true;
+#endif
+}
+
+/* Copy the MAC header and the allowed elements, whole elements only and at most limit bytes in total */
+static uint32_t copy_trimmed(uint8_t *dst, const uint8_t *frame, uint32_t length, uint32_t limit)
+{
+    const uint8_t *pos = frame + sizeof(packet_control_header_t);
+    const uint8_t *end = frame + length;
+    uint32_t copied = sizeof(packet_control_header_t);
+
+    memcpy(dst, frame, copied);
+    while (end - pos >= SNIFFER_IE_HEADER_LEN)
+    {
+        uint32_t element = SNIFFER_IE_HEADER_LEN + pos[1];
+        if (element > (uint32_t)(end - pos))
+        {
+            break;
+        }
+        if (ie_allowed(pos[0]))
+        {
+            if (copied + element > limit)
             {
-                ESP_LOGE(SNIFFER_TAG, "sniffer work queue full");
-                free(packet_info->payload);
+                return copied;
             }
+            memcpy(dst + copied, pos, element);
+            copied += element;
+        }
+        pos += element;
+    }
+    /* keep a malformed tail as it is, so the parse stage still sees the frame is broken */
+    uint32_t rest = end - pos;
+    if (rest > limit - copied)
+    {
+        rest = limit - copied;
+    }
+    memcpy(dst + copied, pos, rest);
+    return copied + rest;
+}
+#endif
+
+static void queue_packet(void *recv_packet, uint32_t length, const wifi_pkt_rx_ctrl_t *rx_ctrl, int64_t time_us,
+                         overload_mode_t mode)
+{
+    /* Copy a packet from Link Layer driver into the capture ring, to be processed in place by sniffer task.
+     * Never allocates or blocks: if the ring is full the packet is dropped and counted by the ring. */
+    uint32_t copy_length = length;
+#if CONFIG_SNIFFER_SNAPLEN
+    if (copy_length > CONFIG_SNIFFER_SNAPLEN)
+    {
+        copy_length = CONFIG_SNIFFER_SNAPLEN;
+    }
+#endif
+    if (mode != OVERLOAD_FULL)
+    {
+        /* summary: transmitter and sequence number from the MAC header, time and signal from the metadata */
+        copy_length = sizeof(packet_control_header_t);
+    }
+    sniffer_packet_info_t *packet_info = capture_ring_reserve(&snf_rt.ring, sizeof(sniffer_packet_info_t) + copy_length);
+    if (packet_info)
+    {
+        if (mode != OVERLOAD_FULL)
+        {
+            memcpy(packet_info->payload, recv_packet, copy_length);
+            telemetry_add(TELEMETRY_FRAMES_SUMMARIZED, 1);
+        }
+        else
+        {
+#if SNIFFER_TRIM
+            /* the reservation covers the worst case, the record shrinks to what was copied */
+            copy_length = copy_trimmed(packet_info->payload, recv_packet, length, copy_length);
+            if (copy_length < length)
+            {
+                snf_rt.trimmed++;
+                snf_rt.trimmed_bytes += length - copy_length;
+            }
+#else
+            memcpy(packet_info->payload, recv_packet, length);
+#endif
+        }
+        packet_info->length = copy_length;
+        packet_info->orig_length = length;
+        packet_info->seconds = time_us / 1000000;
+        packet_info->microseconds = time_us % 1000000;
+        packet_info->channel = rx_ctrl->channel;
+        packet_info->rssi = rx_ctrl->rssi;
+        packet_info->rate = rx_ctrl->sig_mode ? SNIFFER_RATE_HT : rx_ctrl->rate;
+        packet_info->type = SNIFFER_RECORD_FRAME;
+        packet_info->overload = mode;
+#if CONFIG_LATENCY_ENABLED
+        packet_info->queued = latency_ticks();
+#endif
+        capture_ring_commit(&snf_rt.ring, sizeof(sniffer_packet_info_t) + copy_length);
+        telemetry_add(TELEMETRY_FRAMES_QUEUED, 1);
+        if (!snf_rt.first_frame_ms)
+        {
+            snf_rt.first_frame_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
         }
+        xTaskNotifyGive(snf_rt.task);
     }
     else
     {
-        ESP_LOGE(SNIFFER_TAG, "No enough memory for promiscuous packet");
+        telemetry_add(TELEMETRY_DROP_RING_FULL, 1);
     }
 }
 
 static void wifi_sniffer_cb(void *recv_buf, wifi_promiscuous_pkt_type_t type)
 {
-    struct timeval tv;
-    sniffer_packet_info_t packet_info;
+    LATENCY_START(cb_start);
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)recv_buf;
-    packet_control_header_t *hdr = (packet_control_header_t *)pkt->payload;
+    uint32_t length = pkt->rx_ctrl.sig_len - SNIFFER_PAYLOAD_FCS_LEN;
+
+    telemetry_add(TELEMETRY_FRAMES_SEEN, 1);
+    // Rules on the header and signal before anything is copied
+    if (snf_rt.is_running && pkt->rx_ctrl.sig_len >= sizeof(packet_control_header_t) + SNIFFER_PAYLOAD_FCS_LEN &&
+        frame_filter_match(&snf_rt.filter,
+                           frame_filter_key(pkt->payload, length, pkt->rx_ctrl.rx_state == SNIFFER_RX_FCS_ERR),
+                           pkt->rx_ctrl.rssi))
+    {
+        // Receive time from the radio's counter, the system clock is only read now and then
+        int64_t time_us = timebase_stamp(&snf_rt.timebase, pkt->rx_ctrl.timestamp, esp_timer_get_time());
+        packet_control_header_t *hdr = (packet_control_header_t *)pkt->payload;
+        uint32_t now_ms = time_us / 1000;
+        channel_hop_count(pkt->rx_ctrl.channel);
+#if CONFIG_DEDUP_ENABLED
+        // Drop exact repeats (same transmitter, sequence number and elements) before they take ring space
+        uint32_t elements_hash = ie_hash(hdr->payload, length - sizeof(packet_control_header_t));
+        if (dedup_check(&snf_rt.dedup, hdr->addr2, hdr->sequence_number, elements_hash, now_ms))
+        {
+            telemetry_add(TELEMETRY_FRAMES_DUPLICATE, 1);
+            LATENCY_END(LATENCY_CALLBACK, cb_start);
+            return;
+        }
+#endif
+#if CONFIG_OVERLOAD_ENABLED
+        // Shed load before the ring is full: summaries first, then only a fixed share of the transmitters
+        overload_mode_t mode = overload_update(&snf_rt.overload, capture_ring_used(&snf_rt.ring), now_ms);
+        if (mode == OVERLOAD_SAMPLED && !overload_keep(&snf_rt.overload, hdr->addr2))
+        {
+            telemetry_add(TELEMETRY_FRAMES_SAMPLED_OUT, 1);
+            LATENCY_END(LATENCY_CALLBACK, cb_start);
+            return;
+        }
+#else
+        overload_mode_t mode = OVERLOAD_FULL;
+        (void)hdr;
+        (void)now_ms;
+#endif
+        queue_packet(pkt->payload, length, &pkt->rx_ctrl, time_us, mode);
+    }
+    else
+    {
+        telemetry_add(TELEMETRY_FRAMES_FILTERED, 1);
+    }
+    LATENCY_END(LATENCY_CALLBACK, cb_start);
+}
+
+#if SNIFFER_CAPTURE_CSI
+static void wifi_csi_cb(void *ctx, wifi_csi_info_t *info)
+{
+    uint32_t length = sizeof(info->mac) + info->len;
+
+    if (!snf_rt.is_running || !info->buf)
+    {
+        return;
+    }
+    /* the CSI callback runs in the Wi-Fi task as well */
+    int64_t time_us = timebase_stamp(&snf_rt.timebase, info->rx_ctrl.timestamp, esp_timer_get_time());
+    /* same ring as the frames, the sniffer task tells the records apart by type */
+    sniffer_packet_info_t *packet_info = capture_ring_reserve(&snf_rt.ring, sizeof(sniffer_packet_info_t) + length);
+    if (packet_info)
+    {
+        packet_info->length = length;
+        packet_info->orig_length = length;
+        packet_info->seconds = time_us / 1000000;
+        packet_info->microseconds = time_us % 1000000;
+        packet_info->channel = info->rx_ctrl.channel;
+        packet_info->rssi = info->rx_ctrl.rssi;
+        packet_info->rate = 0;
+        packet_info->type = SNIFFER_RECORD_CSI;
+        memcpy(packet_info->payload, info->mac, sizeof(info->mac));
+        memcpy(packet_info->payload + sizeof(info->mac), info->buf, info->len);
+        capture_ring_commit(&snf_rt.ring, sizeof(sniffer_packet_info_t) + length);
+        xTaskNotifyGive(snf_rt.task);
+    }
+}
+
+static void log_csi(const sniffer_packet_info_t *packet_info)
+{
+    csi_log_entry_t entry = {
+        .seconds = packet_info->seconds,
+        .microseconds = packet_info->microseconds,
+        .rssi = packet_info->rssi,
+        .channel = packet_info->channel,
+        .data = (const int8_t *)packet_info->payload + sizeof(entry.mac),
+        .length = packet_info->length - sizeof(entry.mac),
+    };
+
+    memcpy(entry.mac, packet_info->payload, sizeof(entry.mac));
+    csi_log_write(&entry);
+}
+#endif
+
+/* Record boundary: let the pcap layer rotate files if its policy says so */
+static void service_pcap(sniffer_runtime_t *sniffer)
+{
+    if (pcap_service() != PCAP_ROTATE_NONE)
+    {
+        sniffer->rotation_drops_base = capture_ring_dropped(&sniffer->ring);
+        sniffer->rotation_pending = true;
+#if SNIFFER_CAPTURE_CSI
+        /* CSI side files follow the capture files */
+        csi_log_open(pcap_get_capture_index());
+#endif
+    }
+}
+
+static void process_ring(sniffer_runtime_t *sniffer)
+{
+    uint32_t record_len;
+    sniffer_packet_info_t *packet_info;
+    uint32_t used = capture_ring_used(&sniffer->ring);
+
+    if (used > sniffer->ring_peak)
+    {
+        sniffer->ring_peak = used;
+    }
+    while ((packet_info = capture_ring_peek(&sniffer->ring, &record_len)) != NULL)
+    {
+#if SNIFFER_CAPTURE_CSI
+        if (packet_info->type == SNIFFER_RECORD_CSI)
+        {
+            log_csi(packet_info);
+            capture_ring_release(&sniffer->ring);
+            continue;
+        }
+#endif
+#if CONFIG_LATENCY_ENABLED
+        latency_record(LATENCY_QUEUE, latency_ticks() - packet_info->queued);
+#endif
+        ie_probe_info_t ies;
+        packet_control_header_t *hdr = (packet_control_header_t *)packet_info->payload;
+        if (!ie_parse_probe(hdr->payload, packet_info->length - sizeof(packet_control_header_t), &ies))
+        {
+            sniffer->ie_malformed++;
+        }
+        capture_frame_t frame = {
+            .payload = packet_info->payload,
+            .length = packet_info->length,
+            .orig_length = packet_info->orig_length,
+            .seconds = packet_info->seconds,
+            .microseconds = packet_info->microseconds,
+            .rssi = packet_info->rssi,
+            .channel = packet_info->channel,
+            .rate = packet_info->rate == SNIFFER_RATE_HT ? 0 : snf_rate_500kbps[packet_info->rate & 0x0F],
+            .ies = &ies,
+            .overload = packet_info->overload,
+        };
+        LATENCY_START(capture_start);
+        esp_err_t captured = packet_capture(&frame);
+        LATENCY_END(LATENCY_CAPTURE, capture_start);
+        if (captured == ESP_OK)
+        {
+            telemetry_add(TELEMETRY_FRAMES_WRITTEN, 1);
+        }
+        else
+        {
+            uint32_t suppressed;
+            telemetry_add(TELEMETRY_DROP_WRITE_FAILED, 1);
+            if (telemetry_ratelimit(&sniffer->write_log, SNIFFER_LOG_INTERVAL_MS, &suppressed))
+            {
+                ESP_LOGW(SNIFFER_TAG, "save captured packet failed (%u more since the last warning)", suppressed);
+            }
+        }
+        capture_ring_release(&sniffer->ring);
+        service_pcap(sniffer);
+    }
+}
 
-    int32_t fc = ntohs(hdr->frame_ctrl);
+/* Session counters into the output, for formats with statistics records (pcapng) */
+static void record_stats(sniffer_runtime_t *sniffer)
+{
+    struct timeval tv;
+    uint64_t counters[TELEMETRY_COUNTER_COUNT];
 
-    // Check only for Probe requests
-    if ((fc & 0xFF00) == 0x4000)
+    gettimeofday(&tv, NULL);
+    telemetry_snapshot(counters);
+    for (int i = 0; i < TELEMETRY_COUNTER_COUNT; i++)
     {
-        gettimeofday(&tv, NULL);
+        counters[i] -= sniffer->session_base[i];
+    }
+    capture_stats_t stats = {
+        .seconds = tv.tv_sec,
+        .microseconds = tv.tv_usec,
+        .start_seconds = sniffer->started,
+        .received = counters[TELEMETRY_FRAMES_SEEN] - counters[TELEMETRY_FRAMES_FILTERED],
+        .accepted = counters[TELEMETRY_FRAMES_SEEN] - counters[TELEMETRY_FRAMES_FILTERED] -
+                    counters[TELEMETRY_FRAMES_DUPLICATE] - counters[TELEMETRY_FRAMES_SAMPLED_OUT],
+        .dropped = counters[TELEMETRY_DROP_RING_FULL],
+        .delivered = counters[TELEMETRY_FRAMES_WRITTEN],
+    };
+    packet_capture_stats(&stats);
+    sniffer->next_stats = tv.tv_sec + CONFIG_CAPTURE_STATS_INTERVAL_S;
+}
 
-        packet_info.seconds = tv.tv_sec;
-        packet_info.microseconds = tv.tv_usec;
-        packet_info.length = pkt->rx_ctrl.sig_len;
+static void check_rotation(sniffer_runtime_t *sniffer)
+{
+    pcap_writer_stats_t writer;
 
-        packet_info.length -= SNIFFER_PAYLOAD_FCS_LEN;
-        queue_packet(pkt->payload, &packet_info);
+    pcap_get_writer_stats(&writer);
+    if (writer.rotations != sniffer->rotations)
+    {
+        sniffer->rotations = writer.rotations;
+        if (sniffer->rotation_pending)
+        {
+            uint32_t drops = capture_ring_dropped(&sniffer->ring) - sniffer->rotation_drops_base;
+            sniffer->rotation_drops += drops;
+            sniffer->rotation_pending = false;
+            ESP_LOGI(SNIFFER_TAG, "file rotation done, %u frames dropped during the switch", drops);
+            latency_log();
+        }
+    }
+    if (writer.rotation_failures != sniffer->rotation_failures)
+    {
+        /* the capture stayed in the current file, the pcap layer rotates again once it can */
+        sniffer->rotation_failures = writer.rotation_failures;
+        sniffer->rotation_pending = false;
+        ESP_LOGW(SNIFFER_TAG, "file rotation failed, %u failures so far", writer.rotation_failures);
     }
 }
 
 static void sniffer_task(void *parameters)
 {
-    sniffer_packet_info_t packet_info;
     sniffer_runtime_t *sniffer = (sniffer_runtime_t *)parameters;
 
     while (sniffer->is_running)
     {
-        /* receive packet info from queue */
-        if (xQueueReceive(sniffer->work_queue, &packet_info, pdMS_TO_TICKS(SNIFFER_PROCESS_PACKET_TIMEOUT_MS)) != pdTRUE)
+        /* wait for the callback to signal new records in the ring */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SNIFFER_PROCESS_PACKET_TIMEOUT_MS));
+        process_ring(sniffer);
+        /* time-based rotation must also happen when no packets arrive */
+        service_pcap(sniffer);
+        check_rotation(sniffer);
+        if (sniffer->clock_stepped)
         {
-            continue;
+            sniffer->clock_stepped = false;
+            sniffer->next_stats = time(NULL) + CONFIG_CAPTURE_STATS_INTERVAL_S;
+            pcap_clock_stepped();
+        }
+        if (time(NULL) >= sniffer->next_stats)
+        {
+            record_stats(sniffer);
         }
-        if (packet_capture(packet_info.payload, packet_info.length, packet_info.seconds,
-                           packet_info.microseconds) != ESP_OK)
+
+        uint32_t drops = capture_ring_dropped(&sniffer->ring);
+        uint32_t suppressed;
+        if (drops != sniffer->reported_drops &&
+            telemetry_ratelimit(&sniffer->drop_log, SNIFFER_LOG_INTERVAL_MS, &suppressed))
+        {
+            ESP_LOGW(SNIFFER_TAG, "capture ring full, %u packets dropped so far", drops);
+            sniffer->reported_drops = drops;
+        }
+#if CONFIG_OVERLOAD_ENABLED
+        if (sniffer->overload.changes != sniffer->overload_reported)
         {
-            ESP_LOGW(SNIFFER_TAG, "save captured packet failed");
+            /* at most a few per second, the mode is held before stepping down */
+            sniffer->overload_reported = sniffer->overload.changes;
+            ESP_LOGW(SNIFFER_TAG, "overload: capturing in %s mode, %u mode changes so far",
+                     overload_mode_name(sniffer->overload.mode), sniffer->overload_reported);
         }
-        free(packet_info.payload);
+#endif
     }
+    /* promiscuous mode is already off, save what is left in the ring */
+    process_ring(sniffer);
+    record_stats(sniffer);
+#if SNIFFER_CAPTURE_CSI
+    csi_log_close();
+#endif
     /* notify that sniffer task is over */
     xSemaphoreGive(sniffer->sem_task_over);
     vTaskDelete(NULL);
@@ -137,12 +521,19 @@ esp_err_t sniffer_stop(void)
 {
     esp_err_t ret = ESP_OK;
 
+    xSemaphoreTake(snf_rt.radio_lock, portMAX_DELAY);
     ESP_GOTO_ON_FALSE(snf_rt.is_running, ESP_ERR_INVALID_STATE, err, SNIFFER_TAG, "sniffer is already stopped");
 
     /* Disable wifi promiscuous mode */
+#if SNIFFER_CAPTURE_CSI
+    esp_wifi_set_csi(false);
+#endif
     ESP_GOTO_ON_ERROR(esp_wifi_set_promiscuous(false), err, SNIFFER_TAG, "stop wifi promiscuous failed");
 
     ESP_LOGI(SNIFFER_TAG, "stop promiscuous ok");
+#if CONFIG_CHANNEL_HOP_ENABLED
+    channel_hop_stop();
+#endif
 
     /* stop sniffer local task */
     snf_rt.is_running = false;
@@ -151,43 +542,61 @@ esp_err_t sniffer_stop(void)
 
     vSemaphoreDelete(snf_rt.sem_task_over);
     snf_rt.sem_task_over = NULL;
-    /* make sure to free all resources in the left items */
-    UBaseType_t left_items = uxQueueMessagesWaiting(snf_rt.work_queue);
-
-    sniffer_packet_info_t packet_info;
-    while (left_items--)
-    {
-        xQueueReceive(snf_rt.work_queue, &packet_info, pdMS_TO_TICKS(SNIFFER_PROCESS_PACKET_TIMEOUT_MS));
-        free(packet_info.payload);
-    }
-    vQueueDelete(snf_rt.work_queue);
-    snf_rt.work_queue = NULL;
+    snf_rt.task = NULL;
 
     /* stop pcap session */
     sniff_packet_stop();
 err:
+    xSemaphoreGive(snf_rt.radio_lock);
     return ret;
 }
 
 esp_err_t sniffer_start(void)
 {
     esp_err_t ret = ESP_OK;
-    pcap_link_type_t link_type = PCAP_LINK_TYPE_802_11;
+    pcap_link_type_t link_type = CAPTURE_SINK_LINK_TYPE;
     wifi_promiscuous_filter_t wifi_filter = {
-        .filter_mask = WIFI_EVENT_MASK_AP_PROBEREQRECVED
-	};
+        .filter_mask = snf_rt.filter.promiscuous_mask
+    };
+#if SNIFFER_CAPTURE_CSI
+    wifi_csi_config_t csi_config = {
+        .lltf_en = true,
+        .htltf_en = true,
+        .stbc_htltf2_en = true,
+        .ltf_merge_en = true,
+        .channel_filter_en = true,
+        .manu_scale = false,
+        .shift = 0,
+    };
+#endif
+    xSemaphoreTake(snf_rt.radio_lock, portMAX_DELAY);
     ESP_GOTO_ON_FALSE(!(snf_rt.is_running), ESP_ERR_INVALID_STATE, err, SNIFFER_TAG, "sniffer is already running");
 
     /* init a pcap session */
     ESP_GOTO_ON_ERROR(sniff_packet_start(link_type), err, SNIFFER_TAG, "init pcap session failed");
 
-    snf_rt.is_running = true;
-    snf_rt.work_queue = xQueueCreate(CONFIG_SNIFFER_WORK_QUEUE_LEN, sizeof(sniffer_packet_info_t));
-    ESP_GOTO_ON_FALSE(snf_rt.work_queue, ESP_FAIL, err_queue, SNIFFER_TAG, "create work queue failed");
+    capture_ring_reset(&snf_rt.ring);
+    snf_rt.reported_drops = 0;
+    snf_rt.ring_peak = 0;
+    snf_rt.rotation_pending = false;
+    overload_init(&snf_rt.overload, snf_rt.ring.size, CONFIG_OVERLOAD_SUMMARY_PERCENT, CONFIG_OVERLOAD_SAMPLE_PERCENT,
+                  CONFIG_OVERLOAD_HYSTERESIS_PERCENT, CONFIG_OVERLOAD_HOLD_MS, CONFIG_OVERLOAD_KEEP_PERCENT,
+                  CONFIG_OVERLOAD_SEED);
+    snf_rt.overload_reported = 0;
+    telemetry_snapshot(snf_rt.session_base);
+    snf_rt.started = time(NULL);
+    snf_rt.next_stats = snf_rt.started + CONFIG_CAPTURE_STATS_INTERVAL_S;
+    snf_rt.clock_stepped = false;
+    pcap_writer_stats_t writer;
+    pcap_get_writer_stats(&writer);
+    snf_rt.rotations = writer.rotations;
+    snf_rt.rotation_failures = writer.rotation_failures;
     snf_rt.sem_task_over = xSemaphoreCreateBinary();
-    ESP_GOTO_ON_FALSE(snf_rt.sem_task_over, ESP_FAIL, err_sem, SNIFFER_TAG, "create work queue failed");
-    ESP_GOTO_ON_FALSE(xTaskCreate(sniffer_task, "snifferT", CONFIG_SNIFFER_TASK_STACK_SIZE,
-                                  &snf_rt, CONFIG_SNIFFER_TASK_PRIORITY, &snf_rt.task), ESP_FAIL,
+    ESP_GOTO_ON_FALSE(snf_rt.sem_task_over, ESP_FAIL, err, SNIFFER_TAG, "create semaphore failed");
+    snf_rt.is_running = true;
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(sniffer_task, "snifferT", CONFIG_SNIFFER_TASK_STACK_SIZE,
+                                              &snf_rt, CONFIG_SNIFFER_TASK_PRIORITY, &snf_rt.task,
+                                              CONFIG_SNIFFER_TASK_CORE), ESP_FAIL,
                       err_task, SNIFFER_TAG, "create task failed");
 
     /* Start WiFi Promiscuous Mode */
@@ -195,26 +604,113 @@ esp_err_t sniffer_start(void)
     esp_wifi_set_promiscuous_rx_cb(wifi_sniffer_cb);
     ESP_GOTO_ON_ERROR(esp_wifi_set_promiscuous(true), err_start, SNIFFER_TAG, "create work queue failed");
     esp_wifi_set_channel(snf_rt.channel, WIFI_SECOND_CHAN_NONE);
+#if SNIFFER_CAPTURE_CSI
+    if (csi_log_open(pcap_get_capture_index()) != ESP_OK ||
+        esp_wifi_set_csi_config(&csi_config) != ESP_OK ||
+        esp_wifi_set_csi_rx_cb(wifi_csi_cb, NULL) != ESP_OK ||
+        esp_wifi_set_csi(true) != ESP_OK)
+    {
+        ESP_LOGW(SNIFFER_TAG, "CSI capture not started");
+    }
+#endif
+#if CONFIG_CHANNEL_HOP_ENABLED
+    if (channel_hop_start() != ESP_OK)
+    {
+        ESP_LOGW(SNIFFER_TAG, "channel hopping not started, staying on channel %u", snf_rt.channel);
+    }
+#endif
     ESP_LOGI(SNIFFER_TAG, "start WiFi promiscuous ok");
 
+    xSemaphoreGive(snf_rt.radio_lock);
     return ret;
 err_start:
     vTaskDelete(snf_rt.task);
     snf_rt.task = NULL;
 err_task:
+    snf_rt.is_running = false;
     vSemaphoreDelete(snf_rt.sem_task_over);
     snf_rt.sem_task_over = NULL;
-err_sem:
-    vQueueDelete(snf_rt.work_queue);
-    snf_rt.work_queue = NULL;
-err_queue:
-    snf_rt.is_running = false;
 err:
+    xSemaphoreGive(snf_rt.radio_lock);
     return ret;
 }
 
+bool sniffer_lock_radio(void)
+{
+    xSemaphoreTake(snf_rt.radio_lock, portMAX_DELAY);
+    return snf_rt.is_running;
+}
+
+void sniffer_unlock_radio(void)
+{
+    xSemaphoreGive(snf_rt.radio_lock);
+}
+
+esp_err_t sniffer_rotate(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_GOTO_ON_FALSE(snf_rt.is_running, ESP_ERR_INVALID_STATE, err, SNIFFER_TAG, "sniffer is not running");
+    ESP_GOTO_ON_ERROR(pcap_rotate(), err, SNIFFER_TAG, "request pcap rotation failed");
+err:
+    return ret;
+}
+
+void sniffer_clock_stepped(void)
+{
+    /* set from another task, applied by the sniffer task which owns the deadlines */
+    snf_rt.clock_stepped = true;
+}
+
 void initialize_sniffer(void)
 {
     snf_rt.interf = SNIFFER_INTF_WLAN;
     snf_rt.channel = SNIFFER_DEFAULT_CHANNEL;
+    snf_rt.radio_lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(snf_rt.radio_lock ? ESP_OK : ESP_ERR_NO_MEM);
+    capture_ring_init(&snf_rt.ring, snf_ring_buf, sizeof(snf_ring_buf));
+    frame_filter_compile(&snf_rt.filter);
+    timebase_init(&snf_rt.timebase);
+#if CONFIG_SNIFFER_IE_FILTER_ENABLED
+    static const uint8_t ie_allow_list[] = CONFIG_SNIFFER_IE_ALLOW_LIST;
+    for (uint32_t i = 0; i < sizeof(ie_allow_list); i++)
+    {
+        snf_rt.ie_allowed[ie_allow_list[i] / 32] |= 1u << (ie_allow_list[i] % 32);
+    }
+#endif
+#if CONFIG_DEDUP_ENABLED
+    dedup_init(&snf_rt.dedup, snf_dedup_entries, CONFIG_DEDUP_TABLE_SIZE, CONFIG_DEDUP_WINDOW_MS);
+#endif
+}
+
+void sniffer_get_pipeline_stats(sniffer_pipeline_stats_t *stats)
+{
+    pcap_writer_stats_t writer;
+
+    pcap_get_writer_stats(&writer);
+    stats->ring_size = snf_rt.ring.size;
+    stats->ring_used = capture_ring_used(&snf_rt.ring);
+    stats->ring_peak = snf_rt.ring_peak;
+    stats->ring_dropped = capture_ring_dropped(&snf_rt.ring);
+    stats->block_count = writer.block_count;
+    stats->blocks_queued = writer.blocks_queued;
+    stats->blocks_peak = writer.blocks_peak;
+    stats->parse_stalls = writer.stalls;
+    stats->rotations = writer.rotations;
+    stats->rotation_drops = snf_rt.rotation_drops;
+    stats->dedup_checked = snf_rt.dedup.checked;
+    stats->dedup_suppressed = snf_rt.dedup.suppressed;
+    stats->ie_malformed = snf_rt.ie_malformed;
+    stats->trimmed = snf_rt.trimmed;
+    stats->trimmed_bytes = snf_rt.trimmed_bytes;
+    stats->overload_mode = snf_rt.overload.mode;
+    stats->overload_changes = snf_rt.overload.changes;
+    stats->compressed_in = writer.bytes_in;
+    stats->compressed_out = writer.bytes_out;
+    stats->commits = writer.commits;
+    stats->clock_skew_ppb = snf_rt.timebase.skew_ppb;
+    stats->clock_refits = snf_rt.timebase.refits;
+    stats->clock_steps = snf_rt.timebase.steps;
+    stats->clock_correction_us = snf_rt.timebase.last_correction_us;
+    stats->first_frame_ms = snf_rt.first_frame_ms;
 }
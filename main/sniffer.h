@@ -8,6 +8,9 @@
 */
 #pragma once
 
+#include <stdbool.h>
+#include "esp_err.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -37,10 +40,73 @@ typedef enum {
     SNIFFER_WLAN_FILTER_MAX
 } sniffer_wlan_filter_t;
 
+/**
+ * @brief Occupancy of each capture pipeline stage
+ *
+ * Ingest (Wi-Fi callback) hands frames to the parse stage (sniffer task) through the capture ring,
+ * the parse stage hands pcap blocks to the storage stage (pcap writer task). A stage whose input
+ * keeps filling up is the one limiting throughput.
+ */
+typedef struct {
+    uint32_t ring_size;     /*!< Capacity of the ingest -> parse ring in bytes */
+    uint32_t ring_used;     /*!< Bytes currently waiting for the parse stage */
+    uint32_t ring_peak;     /*!< Highest number of bytes waiting for the parse stage */
+    uint32_t ring_dropped;  /*!< Frames dropped by ingest because the ring was full */
+    uint32_t block_count;   /*!< Number of parse -> storage blocks */
+    uint32_t blocks_queued; /*!< Blocks currently waiting for the storage stage */
+    uint32_t blocks_peak;   /*!< Highest number of blocks waiting for the storage stage */
+    uint32_t parse_stalls;  /*!< Times the parse stage waited for the storage stage */
+    uint32_t rotations;     /*!< Completed file switches */
+    uint32_t rotation_drops;/*!< Frames dropped while a file switch was in progress */
+    uint32_t dedup_checked; /*!< Frames looked up in the duplicate table */
+    uint32_t dedup_suppressed; /*!< Frames dropped as repeats before being queued */
+    uint32_t ie_malformed;  /*!< Frames with a malformed information element list */
+    uint32_t trimmed;       /*!< Frames shortened by the snap length or the element allow-list */
+    uint32_t trimmed_bytes; /*!< Bytes left out of those frames */
+    uint32_t overload_mode; /*!< overload_mode_t frames are captured in right now */
+    uint32_t overload_changes; /*!< Load shedding mode changes in this session */
+    uint32_t compressed_in; /*!< Bytes compressed by the storage stage */
+    uint32_t compressed_out;/*!< Compressed size of those bytes */
+    uint32_t commits;       /*!< File syncs by the storage stage between rotations */
+    int32_t clock_skew_ppb; /*!< Rate of the system clock against the radio's receive counter, minus one */
+    uint32_t clock_refits;  /*!< Updates of the receive time model */
+    uint32_t clock_steps;   /*!< Updates that found the system clock set rather than drifting */
+    int32_t clock_correction_us; /*!< Jump of the receive time at the last update, negative ones are slewed */
+    uint32_t first_frame_ms;/*!< Time from boot to the first captured frame, 0 until there is one */
+} sniffer_pipeline_stats_t;
+
 void initialize_sniffer(void);
+void sniffer_get_pipeline_stats(sniffer_pipeline_stats_t *stats);
 esp_err_t sniffer_stop(void);
 esp_err_t sniffer_start(void);
 
+/**
+ * @brief Hold off sniffer_start() and sniffer_stop() while another module changes the radio's mode or hopping
+ *
+ * Release with sniffer_unlock_radio(); keep the lock for the mode switches only, not while waiting on the network.
+ *
+ * @return true if the sniffer is running, e.g. still worth restarting channel hopping for
+ */
+bool sniffer_lock_radio(void);
+void sniffer_unlock_radio(void);
+
+/**
+ * @brief Continue the capture in the next pcap file without stopping the sniffer
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the sniffer is not running or a rotation is already pending
+ */
+esp_err_t sniffer_rotate(void);
+
+/**
+ * @brief Tell the sniffer task the system clock was stepped
+ *
+ * The sniffer task then recomputes its wall-clock deadlines: the next capture statistics and the next
+ * time-based file rotation.
+ */
+void sniffer_clock_stepped(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,74 @@
+/* Telemetry — always-on pipeline counters and rate-limited logging.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+
+telemetry_block_t telemetry_blocks[portNUM_PROCESSORS];
+
+static const char *telemetry_names[TELEMETRY_COUNTER_COUNT] = {
+    [TELEMETRY_FRAMES_SEEN] = "seen",
+    [TELEMETRY_FRAMES_FILTERED] = "filtered",
+    [TELEMETRY_FRAMES_DUPLICATE] = "duplicates",
+    [TELEMETRY_FRAMES_SAMPLED_OUT] = "sampled_out",
+    [TELEMETRY_FRAMES_QUEUED] = "queued",
+    [TELEMETRY_FRAMES_SUMMARIZED] = "summarized",
+    [TELEMETRY_DROP_RING_FULL] = "drop_ring_full",
+    [TELEMETRY_DROP_WRITE_FAILED] = "drop_write_failed",
+    [TELEMETRY_FRAMES_WRITTEN] = "written",
+    [TELEMETRY_BYTES_WRITTEN] = "bytes_written",
+};
+
+/* A counter of another core: a 64-bit value is loaded as two words, so a carry into the upper one being
+   stored meanwhile could be read half done; read until two loads in a row agree */
+static uint64_t telemetry_load(const volatile uint64_t *counter)
+{
+    uint64_t value = *counter;
+    uint64_t again;
+
+    while ((again = *counter) != value)
+    {
+        value = again;
+    }
+    return value;
+}
+
+void telemetry_snapshot(uint64_t *counters)
+{
+    memset(counters, 0, TELEMETRY_COUNTER_COUNT * sizeof(uint64_t));
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        for (int i = 0; i < TELEMETRY_COUNTER_COUNT; i++)
+        {
+            counters[i] += telemetry_load(&telemetry_blocks[core].counters[i]);
+        }
+    }
+}
+
+const char *telemetry_counter_name(telemetry_counter_t counter)
+{
+    return telemetry_names[counter];
+}
+
+bool telemetry_ratelimit(telemetry_ratelimit_t *limit, uint32_t interval_ms, uint32_t *suppressed)
+{
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    if (limit->logged && now_ms - limit->last_ms < interval_ms)
+    {
+        limit->suppressed++;
+        return false;
+    }
+    *suppressed = limit->suppressed;
+    limit->suppressed = 0;
+    limit->last_ms = now_ms;
+    limit->logged = true;
+    return true;
+}
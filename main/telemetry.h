@@ -0,0 +1,100 @@
+/* Telemetry — always-on pipeline counters and rate-limited logging.
+
+   Every core has its own counter block, so counting needs neither locks nor atomic instructions. Each
+   counter is only updated from one context per core (e.g. the Wi-Fi callback, the sniffer task or the
+   pcap writer task), readers add up the blocks of all cores. Counters are 64-bit, so that the byte count
+   and the frame counts of a long session do not wrap; pcapng statistics carry them as such.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pipeline counters, in the order frames pass the pipeline
+ *
+ */
+typedef enum {
+    TELEMETRY_FRAMES_SEEN = 0,      /*!< Frames handed to the Wi-Fi callback */
+    TELEMETRY_FRAMES_FILTERED,      /*!< Not a probe request, too short or capture stopped */
+    TELEMETRY_FRAMES_DUPLICATE,     /*!< Suppressed as repeats */
+    TELEMETRY_FRAMES_SAMPLED_OUT,   /*!< Shed by overload sampling, transmitter outside the kept share */
+    TELEMETRY_FRAMES_QUEUED,        /*!< Copied into the capture ring */
+    TELEMETRY_FRAMES_SUMMARIZED,    /*!< Of those, copied as summaries (MAC header only) under overload */
+    TELEMETRY_DROP_RING_FULL,       /*!< Dropped, no space in the capture ring */
+    TELEMETRY_DROP_WRITE_FAILED,    /*!< Dropped, the pcap layer did not take the frame */
+    TELEMETRY_FRAMES_WRITTEN,       /*!< Handed to the output */
+    TELEMETRY_BYTES_WRITTEN,        /*!< Bytes written to the card, after compression */
+    TELEMETRY_COUNTER_COUNT,
+} telemetry_counter_t;
+
+/**
+ * @brief Counters of one core, padded to a cache line
+ *
+ */
+typedef struct {
+    uint64_t counters[TELEMETRY_COUNTER_COUNT];
+} __attribute__((aligned(32))) telemetry_block_t;
+
+/**
+ * @brief State of one rate-limited log message
+ *
+ */
+typedef struct {
+    uint32_t last_ms;       /*!< When the message was last logged */
+    uint32_t suppressed;    /*!< Messages held back since then */
+    bool logged;            /*!< The message was logged at least once */
+} telemetry_ratelimit_t;
+
+extern telemetry_block_t telemetry_blocks[portNUM_PROCESSORS];
+
+/**
+ * @brief Add to a counter of the calling core
+ *
+ * @param counter counter to increase
+ * @param value amount to add
+ */
+static inline void telemetry_add(telemetry_counter_t counter, uint32_t value)
+{
+    telemetry_blocks[xPortGetCoreID()].counters[counter] += value;
+}
+
+/**
+ * @brief Sum of the counters of all cores
+ *
+ * @param[out] counters TELEMETRY_COUNTER_COUNT values, indexed by telemetry_counter_t
+ */
+void telemetry_snapshot(uint64_t *counters);
+
+/**
+ * @brief Short name of a counter, e.g. for column headers
+ *
+ * @param counter counter
+ * @return name
+ */
+const char *telemetry_counter_name(telemetry_counter_t counter);
+
+/**
+ * @brief Decide whether a repeated message may be logged now
+ *
+ * @param limit state of the message
+ * @param interval_ms minimum time between two logged messages
+ * @param[out] suppressed messages held back since the last logged one, valid if true is returned
+ * @return true if the message should be logged
+ */
+bool telemetry_ratelimit(telemetry_ratelimit_t *limit, uint32_t interval_ms, uint32_t *suppressed);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,254 @@
+/* Time sync — fast boot clock: restored time, background SNTP and measured corrections.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_check.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_sntp.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "channel_hop.h"
+#include "config.h"
+#include "sniffer.h"
+#include "time_sync.h"
+
+#define TIME_SYNC_NVS_NAMESPACE     "sniffer"
+#define TIME_SYNC_NVS_KEY           "saved_time"
+#define TIME_SYNC_VALID_AFTER       (1640995200) /* 2022-01-01, earlier times were never set */
+#define TIME_SYNC_CORRECTIONS       (4)          /* clock steps waiting to be logged */
+#define TIME_SYNC_POLL_MS           (500)
+#define TIME_SYNC_TASK_STACK_SIZE   (3072)
+#define TIME_SYNC_TASK_PRIORITY     (1)
+#define TIME_SYNC_CONNECTED_BIT     BIT0
+
+static const char *TIME_SYNC_TAG = "time_sync";
+
+static struct {
+    volatile time_source_t source;
+    QueueHandle_t corrections;
+    EventGroupHandle_t events;
+    esp_netif_t *netif;
+    TaskHandle_t task;
+} ts_rt;
+
+static const char *ts_source_names[] = { "none", "nvs", "rtc", "sntp" };
+
+const char *time_sync_source_name(time_source_t source)
+{
+    return source <= TIME_SOURCE_SNTP ? ts_source_names[source] : "?";
+}
+
+time_source_t time_sync_source(void)
+{
+    return ts_rt.source;
+}
+
+time_source_t time_sync_restore(void)
+{
+    nvs_handle_t handle;
+    uint64_t saved = 0;
+
+    if (time(NULL) >= TIME_SYNC_VALID_AFTER)
+    {
+        ts_rt.source = TIME_SOURCE_RTC;
+    }
+    else
+    {
+        if (nvs_open(TIME_SYNC_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+        {
+            nvs_get_u64(handle, TIME_SYNC_NVS_KEY, &saved);
+            nvs_close(handle);
+        }
+        if (saved >= TIME_SYNC_VALID_AFTER)
+        {
+            struct timeval tv = { .tv_sec = saved, .tv_usec = 0 };
+            settimeofday(&tv, NULL);
+            ts_rt.source = TIME_SOURCE_NVS;
+        }
+    }
+    ESP_LOGI(TIME_SYNC_TAG, "boot time from %s: %lld", time_sync_source_name(ts_rt.source), (long long)time(NULL));
+    return ts_rt.source;
+}
+
+esp_err_t time_sync_save(void)
+{
+    esp_err_t ret = ESP_OK;
+    nvs_handle_t handle;
+    time_t now = time(NULL);
+
+    /* a clock that was never set would only overwrite a better guess */
+    ESP_GOTO_ON_FALSE(now >= TIME_SYNC_VALID_AFTER, ESP_ERR_INVALID_STATE, err, TIME_SYNC_TAG, "time not set");
+    ESP_GOTO_ON_ERROR(nvs_open(TIME_SYNC_NVS_NAMESPACE, NVS_READWRITE, &handle), err, TIME_SYNC_TAG,
+                      "open NVS failed");
+    ret = nvs_set_u64(handle, TIME_SYNC_NVS_KEY, now);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+err:
+    return ret;
+}
+
+bool time_sync_get_correction(time_sync_correction_t *correction)
+{
+    return ts_rt.corrections && xQueueReceive(ts_rt.corrections, correction, 0) == pdTRUE;
+}
+
+/* Replaces the SNTP client's default, which sets the clock without telling by how much */
+void sntp_sync_time(struct timeval *tv)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    settimeofday(tv, NULL);
+    time_sync_correction_t correction = {
+        .before_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec,
+        .correction_us = ((int64_t)tv->tv_sec - now.tv_sec) * 1000000 + tv->tv_usec - now.tv_usec,
+        .source = ts_rt.source,
+        .uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS,
+    };
+    ts_rt.source = TIME_SOURCE_SNTP;
+    if (!ts_rt.corrections)
+    {
+        ts_rt.corrections = xQueueCreate(TIME_SYNC_CORRECTIONS, sizeof(time_sync_correction_t));
+    }
+    if (ts_rt.corrections)
+    {
+        xQueueSend(ts_rt.corrections, &correction, 0);
+    }
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+}
+
+static void on_wifi_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
+    {
+        xEventGroupSetBits(ts_rt.events, TIME_SYNC_CONNECTED_BIT);
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        xEventGroupClearBits(ts_rt.events, TIME_SYNC_CONNECTED_BIT);
+    }
+}
+
+/* One attempt: join the access point, wait for SNTP, leave; promiscuous capture stays on throughout.
+   Hopping and mode switches happen under the sniffer's radio lock, so a sniffer_stop() meanwhile either
+   comes before the switch or finds hopping stopped, and hopping is only restarted if capture still runs */
+static bool sync_once(void)
+{
+    bool hopping = sniffer_lock_radio() && channel_hop_stop() == ESP_OK;
+    bool connecting = false;
+    bool synced = false;
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = CONFIG_WIFI_SSID,
+            .password = CONFIG_WIFI_PASSWORD,
+            .scan_method = WIFI_FAST_SCAN,
+            .sort_method = WIFI_CONNECT_AP_BY_SIGNAL,
+            .threshold.rssi = -127,
+        },
+    };
+
+    xEventGroupClearBits(ts_rt.events, TIME_SYNC_CONNECTED_BIT);
+    connecting = esp_wifi_set_mode(WIFI_MODE_STA) == ESP_OK &&
+                 esp_wifi_set_config(WIFI_IF_STA, &wifi_config) == ESP_OK && esp_wifi_start() == ESP_OK;
+    sniffer_unlock_radio();
+    if (connecting && esp_wifi_connect() == ESP_OK &&
+        (xEventGroupWaitBits(ts_rt.events, TIME_SYNC_CONNECTED_BIT, pdFALSE, pdTRUE,
+                             pdMS_TO_TICKS(CONFIG_TIME_SYNC_TIMEOUT_S * 1000)) & TIME_SYNC_CONNECTED_BIT))
+    {
+        sntp_set_sync_status(SNTP_SYNC_STATUS_RESET);
+        sntp_init();
+        for (uint32_t waited = 0; waited < CONFIG_TIME_SYNC_TIMEOUT_S * 1000; waited += TIME_SYNC_POLL_MS)
+        {
+            if (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED)
+            {
+                synced = true;
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(TIME_SYNC_POLL_MS));
+        }
+        sntp_stop();
+    }
+    bool running = sniffer_lock_radio();
+    esp_wifi_disconnect();
+    esp_wifi_set_mode(WIFI_MODE_NULL);
+    if (hopping && running)
+    {
+        channel_hop_start();
+    }
+    sniffer_unlock_radio();
+    return synced;
+}
+
+static void time_sync_task(void *arg)
+{
+    TickType_t next_sync = xTaskGetTickCount();
+    TickType_t next_save = next_sync + pdMS_TO_TICKS(CONFIG_TIME_SYNC_SAVE_S * 1000);
+
+    while (true)
+    {
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(now - next_sync) >= 0)
+        {
+            bool synced = sync_once();
+            if (synced)
+            {
+                ESP_LOGI(TIME_SYNC_TAG, "time synchronized");
+                time_sync_save();
+            }
+            else
+            {
+                ESP_LOGW(TIME_SYNC_TAG, "no time from %s, next try in %u s", CONFIG_WIFI_SSID, CONFIG_TIME_SYNC_RETRY_S);
+            }
+            next_sync = xTaskGetTickCount() +
+                        pdMS_TO_TICKS((synced ? CONFIG_TIME_SYNC_INTERVAL_S : CONFIG_TIME_SYNC_RETRY_S) * 1000);
+        }
+        if ((int32_t)(now - next_save) >= 0)
+        {
+            time_sync_save();
+            next_save += pdMS_TO_TICKS(CONFIG_TIME_SYNC_SAVE_S * 1000);
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+esp_err_t time_sync_start(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_GOTO_ON_FALSE(!ts_rt.task, ESP_ERR_INVALID_STATE, err, TIME_SYNC_TAG, "time sync is already running");
+    ts_rt.events = xEventGroupCreate();
+    ESP_GOTO_ON_FALSE(ts_rt.events, ESP_ERR_NO_MEM, err, TIME_SYNC_TAG, "create event group failed");
+    ESP_GOTO_ON_ERROR(esp_netif_init(), err, TIME_SYNC_TAG, "netif init failed");
+    ret = esp_event_loop_create_default();
+    ESP_GOTO_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, err, TIME_SYNC_TAG, "event loop failed");
+    ret = ESP_OK;
+    ts_rt.netif = esp_netif_create_default_wifi_sta();
+    ESP_GOTO_ON_FALSE(ts_rt.netif, ESP_FAIL, err, TIME_SYNC_TAG, "create station interface failed");
+    ESP_GOTO_ON_ERROR(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_wifi_event, NULL), err,
+                      TIME_SYNC_TAG, "register handler failed");
+    ESP_GOTO_ON_ERROR(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_event, NULL),
+                      err, TIME_SYNC_TAG, "register handler failed");
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, "pool.ntp.org");
+    ESP_GOTO_ON_FALSE(xTaskCreate(time_sync_task, "timesyncT", TIME_SYNC_TASK_STACK_SIZE, NULL,
+                                  TIME_SYNC_TASK_PRIORITY, &ts_rt.task), ESP_FAIL, err, TIME_SYNC_TAG,
+                      "create task failed");
+err:
+    return ret;
+}
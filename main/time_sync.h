@@ -0,0 +1,88 @@
+/* Time sync — declarations of the fast boot clock: restored time, background SNTP and measured corrections.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Where the system clock got its time from
+ *
+ */
+typedef enum {
+    TIME_SOURCE_NONE,   /*!< Nothing, the clock counts from 1970 */
+    TIME_SOURCE_NVS,    /*!< Last time saved in NVS, behind by the time the unit was off */
+    TIME_SOURCE_RTC,    /*!< Kept by the RTC across the reset */
+    TIME_SOURCE_SNTP,   /*!< Synchronized */
+} time_source_t;
+
+/**
+ * @brief One step of the system clock made by SNTP
+ *
+ */
+typedef struct {
+    int64_t before_us;      /*!< System time just before the step */
+    int64_t correction_us;  /*!< Added to the system time, timestamps taken before are off by this much */
+    time_source_t source;   /*!< Source of the time that was corrected */
+    uint32_t uptime_ms;     /*!< When the step happened */
+} time_sync_correction_t;
+
+/**
+ * @brief Set an approximate time at boot, without network
+ *
+ * Keeps the system time if the RTC carried it across the reset, else sets the last time saved in NVS.
+ *
+ * @return source of the time now in the system clock
+ */
+time_source_t time_sync_restore(void);
+
+/**
+ * @brief Start synchronizing in the background
+ *
+ * Every CONFIG_TIME_SYNC_RETRY_S until it succeeds, then every CONFIG_TIME_SYNC_INTERVAL_S, the task pauses
+ * channel hopping, joins CONFIG_WIFI_SSID and waits for an SNTP reply, each for at most
+ * CONFIG_TIME_SYNC_TIMEOUT_S; promiscuous capture goes on on the access point's channel meanwhile, and
+ * hopping resumes only if the sniffer was not stopped in between. The time is saved to NVS every
+ * CONFIG_TIME_SYNC_SAVE_S. Needs Wi-Fi initialized.
+ *
+ * @return esp_err_t
+ */
+esp_err_t time_sync_start(void);
+
+/**
+ * @brief Save the current time to NVS, e.g. before the unit is switched off
+ *
+ * @return esp_err_t
+ */
+esp_err_t time_sync_save(void);
+
+/**
+ * @brief Current source of the system time
+ *
+ */
+time_source_t time_sync_source(void);
+
+const char *time_sync_source_name(time_source_t source);
+
+/**
+ * @brief Take the oldest clock step not fetched yet
+ *
+ * @param[out] correction the step
+ * @return true if there was one
+ */
+bool time_sync_get_correction(time_sync_correction_t *correction);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+/* Timebase — mapping from the radio's receive timestamps to epoch time.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "timebase.h"
+#include "config.h"
+
+/* Crystal tolerances stay well below this; larger drifts between anchors are clock steps */
+#define TIMEBASE_MAX_SKEW_PPM   (200)
+#define TIMEBASE_COUNTER_SPAN   (1LL << 32)
+#define TIMEBASE_COUNTER_HALF   (1LL << 31)
+
+void timebase_init(timebase_t *timebase)
+{
+    memset(timebase, 0, sizeof(*timebase));
+    timebase->best_offset = INT64_MAX;
+}
+
+static int64_t model(const timebase_t *timebase, int64_t counter)
+{
+    int64_t elapsed = counter - timebase->anchor_counter;
+
+    return timebase->anchor_us + elapsed + elapsed * timebase->skew_ppb / 1000000000;
+}
+
+/* Model plus what is left of a backward correction */
+static int64_t slewed(const timebase_t *timebase, int64_t counter)
+{
+    int64_t left = timebase->slew_us - (counter - timebase->slew_counter) * CONFIG_TIMEBASE_SLEW_PPM / 1000000;
+
+    return model(timebase, counter) + (left > 0 ? left : 0);
+}
+
+static void refit(timebase_t *timebase)
+{
+    int64_t before = slewed(timebase, timebase->counter);
+
+    if (timebase->refits > 0)
+    {
+        int64_t span = timebase->best_counter - timebase->prev_counter;
+        int64_t drift = timebase->best_offset - timebase->prev_offset;
+        if (span > 0 && llabs(drift) <= span / (1000000 / TIMEBASE_MAX_SKEW_PPM))
+        {
+            /* smoothed, a single window is only a few samples */
+            timebase->skew_ppb = (3 * (int64_t)timebase->skew_ppb + drift * 1000000000 / span) / 4;
+        }
+        else
+        {
+            timebase->steps++;
+        }
+    }
+    timebase->anchor_counter = timebase->best_counter;
+    timebase->anchor_us = timebase->best_counter + timebase->best_offset;
+
+    int64_t after = model(timebase, timebase->counter);
+    timebase->last_correction_us = after - before;
+    timebase->slew_us = before > after ? before - after : 0;
+    timebase->slew_counter = timebase->counter;
+
+    timebase->prev_offset = timebase->best_offset;
+    timebase->prev_counter = timebase->best_counter;
+    timebase->best_offset = INT64_MAX;
+    timebase->samples = 0;
+    timebase->refits++;
+}
+
+static void sample(timebase_t *timebase)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    int64_t offset = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - timebase->counter;
+    if (offset < timebase->best_offset)
+    {
+        timebase->best_offset = offset;
+        timebase->best_counter = timebase->counter;
+    }
+    timebase->next_sample = timebase->counter + CONFIG_TIMEBASE_SAMPLE_MS * 1000LL;
+    if (!timebase->valid)
+    {
+        timebase->valid = true;
+        timebase->anchor_counter = timebase->counter;
+        timebase->anchor_us = timebase->counter + offset;
+        timebase->last_us = timebase->anchor_us;
+    }
+    if (++timebase->samples >= CONFIG_TIMEBASE_WINDOW)
+    {
+        refit(timebase);
+    }
+}
+
+int64_t timebase_stamp(timebase_t *timebase, uint32_t counter, int64_t now_us)
+{
+    /* frames come in counter order; a small step back is a late frame, not a wrap. The counter wraps every
+       71.6 minutes and frames may be that far apart, so the whole wraps come from the monotonic clock */
+    int64_t advance = (int32_t)(counter - timebase->last_counter);
+    if (timebase->valid)
+    {
+        /* the nearest multiple of the span, never negative as the monotonic clock does not go back */
+        int64_t elapsed = now_us - timebase->last_now_us;
+        advance += (elapsed - advance + TIMEBASE_COUNTER_HALF) / TIMEBASE_COUNTER_SPAN * TIMEBASE_COUNTER_SPAN;
+    }
+    if (advance > 0 || !timebase->valid)
+    {
+        timebase->counter += timebase->valid ? advance : counter;
+        timebase->last_counter = counter;
+        timebase->last_now_us = now_us;
+    }
+    if (!timebase->valid || timebase->counter >= timebase->next_sample)
+    {
+        sample(timebase);
+    }
+
+    int64_t us = slewed(timebase, timebase->counter + (advance < 0 ? advance : 0));
+    if (us < timebase->last_us)
+    {
+        us = timebase->last_us;
+    }
+    timebase->last_us = us;
+    return us;
+}
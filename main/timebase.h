@@ -0,0 +1,69 @@
+/* Timebase — declarations of the mapping from the radio's receive timestamps to epoch time.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Offset/skew model of the radio's microsecond counter against the system clock
+ *
+ * rx_ctrl.timestamp is a 32-bit microsecond counter latched when a frame arrives. Every sample interval
+ * the system clock is read next to a frame's counter value; the pair with the least callback delay in a
+ * window of samples becomes the new anchor, the drift between successive anchors the new skew. Forward
+ * corrections are applied at once, backward ones are slewed out, and the mapping never goes backwards,
+ * across file rotations and sniffer restarts alike. Only one task may stamp frames.
+ */
+typedef struct {
+    bool valid;                 /*!< A first sample was taken */
+    uint32_t last_counter;      /*!< Last rx_ctrl.timestamp seen */
+    int64_t last_now_us;        /*!< Monotonic clock when it was seen, resolves counter wraps */
+    int64_t counter;            /*!< The same, extended to 64 bits */
+    int64_t anchor_counter;     /*!< Model: epoch = anchor_us + elapsed * (1 + skew) */
+    int64_t anchor_us;
+    int32_t skew_ppb;
+    int64_t slew_us;            /*!< Backward correction not slewed out yet at slew_counter */
+    int64_t slew_counter;
+    int64_t last_us;            /*!< Last timestamp handed out */
+    int64_t next_sample;        /*!< Counter value of the next clock sample */
+    uint32_t samples;           /*!< Samples in the current window */
+    int64_t best_offset;        /*!< Least system - counter offset of the window, and where it was seen */
+    int64_t best_counter;
+    int64_t prev_offset;        /*!< The same for the previous window */
+    int64_t prev_counter;
+    uint32_t refits;            /*!< Windows completed */
+    uint32_t steps;             /*!< Refits whose drift was too large for a skew, i.e. the system clock was set */
+    int64_t last_correction_us; /*!< Jump of the model at the last refit, negative if slewed */
+} timebase_t;
+
+/**
+ * @brief Start without a model, the first stamped frame takes the first sample
+ *
+ * @param timebase model to initialize
+ */
+void timebase_init(timebase_t *timebase);
+
+/**
+ * @brief Epoch time of a frame, reading the system clock only when a sample is due
+ *
+ * @param timebase model
+ * @param counter rx_ctrl.timestamp of the frame
+ * @param now_us monotonic clock in microseconds (esp_timer_get_time()), tells how often the counter wrapped
+ *               since the last frame
+ * @return microseconds since the epoch, never less than the previous result
+ */
+int64_t timebase_stamp(timebase_t *timebase, uint32_t counter, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
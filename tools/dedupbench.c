@@ -0,0 +1,200 @@
+/* dedupbench — lookup cost of the duplicate table at several loads, and checks of its eviction path.
+
+   Usage: dedupbench [lookups]
+
+   Fills a table of CONFIG_DEDUP_TABLE_SIZE slots to 25, 50 and 75% with distinct frames seen within the
+   window, then times lookups (1000000 by default) of frames in the table (hits, suppressed as repeats)
+   and of frames not in it (misses, which insert). Misses run in small batches with the table restored
+   in between, so the load stays where it was set. Up to half load, every repeat must be found.
+
+   Before that, the eviction path is checked on a table of DEDUP_MAX_PROBE slots, where every probe run
+   covers the whole table: once it is full, a new frame takes the slot of the least recently seen one
+   or of one past the window, is never reported as a repeat, and the frames that stayed are still
+   suppressed. A random stream through a small table must never suppress a frame that is not a repeat
+   within the window. Exit status 0 if every check passed.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "dedup.h"
+
+#define BENCH_LOOKUPS       (1000000)
+#define MISS_BATCH          (CONFIG_DEDUP_TABLE_SIZE / 64)
+#define PROBE_TABLE_SIZE    (16)    /* DEDUP_MAX_PROBE in dedup.c */
+#define RANDOM_TABLE_SIZE   (64)
+#define RANDOM_FRAMES       (200000)
+#define RANDOM_SENDERS      (300)
+
+static dedup_entry_t entries[CONFIG_DEDUP_TABLE_SIZE];
+static dedup_entry_t snapshot[CONFIG_DEDUP_TABLE_SIZE];
+static int failures;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void check(bool ok, const char *what, long long detail)
+{
+    printf("%-44s %s (%lld)\n", what, ok ? "ok" : "FAILED", detail);
+    failures += !ok;
+}
+
+/* Frame number i: a locally administered transmitter address and sequence number derived from it */
+static void frame_mac(uint32_t i, uint8_t *mac)
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(i >> 24);
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+static bool check_frame(dedup_table_t *table, uint32_t i, uint32_t now_ms)
+{
+    uint8_t mac[6];
+
+    frame_mac(i, mac);
+    return dedup_check(table, mac, (uint16_t)(i << 4), i * 2654435761u, now_ms);
+}
+
+/* A full table evicts the least recently seen frame, or one past the window, for a new one */
+static void test_eviction(void)
+{
+    static dedup_entry_t probe_entries[PROBE_TABLE_SIZE];
+    dedup_table_t table;
+    bool repeats = true;
+
+    dedup_init(&table, probe_entries, PROBE_TABLE_SIZE, 1000);
+    for (uint32_t i = 0; i < PROBE_TABLE_SIZE; i++)
+    {
+        check_frame(&table, i, 100 + i);
+    }
+    for (uint32_t i = 0; i < PROBE_TABLE_SIZE; i++)
+    {
+        repeats &= check_frame(&table, i, 200 + i);
+    }
+    check(repeats, "full table suppresses every repeat", table.suppressed);
+
+    check(!check_frame(&table, 1000, 300), "new frame in a full table is kept", table.suppressed);
+    check(!check_frame(&table, 0, 301), "  it took the least recently seen slot", table.suppressed);
+    repeats = true;
+    for (uint32_t i = 2; i < PROBE_TABLE_SIZE; i++)
+    {
+        repeats &= check_frame(&table, i, 302);
+    }
+    check(repeats && check_frame(&table, 1000, 303), "  the other frames are still suppressed", table.suppressed);
+
+    /* in the table now: 0, 2 to 15 and 1000; all but frame 5 are seen again, frame 5 ages past the window */
+    for (uint32_t i = 0; i < PROBE_TABLE_SIZE; i++)
+    {
+        if (i != 5)
+        {
+            check_frame(&table, i == 1 ? 1000 : i, 1100);
+        }
+    }
+    check(!check_frame(&table, 1001, 1350), "new frame after one slot expired is kept", table.suppressed);
+    repeats = check_frame(&table, 1001, 1351);
+    for (uint32_t i = 0; i < PROBE_TABLE_SIZE; i++)
+    {
+        repeats &= i == 5 || check_frame(&table, i == 1 ? 1000 : i, 1351);
+    }
+    check(repeats && !check_frame(&table, 5, 1352), "  it took the expired slot, not a fresh one",
+          table.suppressed);
+}
+
+/* Random senders repeating frames: a suppressed frame must repeat one seen within the window */
+static void test_random(void)
+{
+    static dedup_entry_t random_entries[RANDOM_TABLE_SIZE];
+    static uint32_t last_seen[RANDOM_SENDERS][4];
+    static bool sent[RANDOM_SENDERS][4];
+    dedup_table_t table;
+    uint32_t wrong = 0;
+    uint32_t seed = 1;
+    uint32_t now_ms = 0xFFFF0000u; /* runs through the wrap of the millisecond counter */
+
+    dedup_init(&table, random_entries, RANDOM_TABLE_SIZE, 500);
+    for (uint32_t n = 0; n < RANDOM_FRAMES; n++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t sender = (seed >> 8) % RANDOM_SENDERS;
+        uint32_t copy = (seed >> 4) % 4;
+        uint32_t i = sender * 4 + copy;
+        now_ms += (seed >> 24) % 4;
+
+        bool seen = sent[sender][copy] && now_ms - last_seen[sender][copy] < table.window_ms;
+        wrong += check_frame(&table, i, now_ms) && !seen;
+        last_seen[sender][copy] = now_ms;
+        sent[sender][copy] = true;
+    }
+    check(wrong == 0, "random stream: no new frame suppressed", wrong);
+    check(table.suppressed > 0, "  some repeats suppressed", table.suppressed);
+}
+
+/* Share of the repeats found, in percent */
+static double bench(uint32_t load_percent, uint32_t lookups)
+{
+    dedup_table_t table;
+    uint32_t filled = CONFIG_DEDUP_TABLE_SIZE * load_percent / 100;
+    uint32_t hits = 0;
+
+    dedup_init(&table, entries, CONFIG_DEDUP_TABLE_SIZE, CONFIG_DEDUP_WINDOW_MS);
+    for (uint32_t i = 0; i < filled; i++)
+    {
+        check_frame(&table, i, 0);
+    }
+    memcpy(snapshot, entries, sizeof(entries));
+
+    double start = now_ns();
+    for (uint32_t n = 0; n < lookups; n++)
+    {
+        hits += check_frame(&table, n % filled, 1);
+    }
+    double hit_ns = (now_ns() - start) / lookups;
+
+    double miss_ns = 0;
+    uint32_t misses = 0;
+    for (uint32_t n = 0; n < lookups; n += MISS_BATCH)
+    {
+        memcpy(entries, snapshot, sizeof(entries));
+        start = now_ns();
+        for (uint32_t i = 0; i < MISS_BATCH; i++)
+        {
+            misses += !check_frame(&table, CONFIG_DEDUP_TABLE_SIZE + n + i, 1);
+        }
+        miss_ns += now_ns() - start;
+    }
+    printf("load %3u%% %5u of %u slots: hit %6.1f ns/lookup (%u suppressed), miss %6.1f ns/lookup (%u kept)\n",
+           load_percent, filled, CONFIG_DEDUP_TABLE_SIZE, hit_ns, hits, miss_ns / misses, misses);
+    return 100.0 * hits / lookups;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_LOOKUPS;
+
+    test_eviction();
+    test_random();
+    double quarter = bench(25, lookups);
+    double half = bench(50, lookups);
+    bench(75, lookups);
+    check(quarter == 100 && half == 100, "every repeat found up to half load", (long long)half);
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+/* esp_app_desc.h — host stand-in for the ESP-IDF application description, the version field only.
+
+   Part of the host build of the capture pipeline, see tools/replay.c.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+typedef struct {
+    char version[32];
+} esp_app_desc_t;
+
+/* Host builds stand for no particular firmware build */
+static inline const esp_app_desc_t *esp_app_get_description(void)
+{
+    static const esp_app_desc_t desc = {
+        .version = "host",
+    };
+
+    return &desc;
+}
@@ -0,0 +1,11 @@
+/* esp_console.h — empty host stand-in, the capture pipeline registers no commands.
+
+   Part of the host build of the capture pipeline, see tools/replay.c.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
@@ -0,0 +1,38 @@
+/* esp_err.h — host stand-in for the ESP-IDF error codes.
+
+   Part of the host build of the capture pipeline, see tools/replay.c.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                      (0)
+#define ESP_FAIL                    (-1)
+#define ESP_ERR_NO_MEM              (0x101)
+#define ESP_ERR_INVALID_ARG         (0x102)
+#define ESP_ERR_INVALID_STATE       (0x103)
+#define ESP_ERR_INVALID_SIZE        (0x104)
+#define ESP_ERR_NOT_FOUND           (0x105)
+#define ESP_ERR_NOT_SUPPORTED       (0x106)
+#define ESP_ERR_TIMEOUT             (0x107)
+#define ESP_ERR_INVALID_CRC         (0x109)
+#define ESP_ERR_NVS_NOT_FOUND       (0x1102)
+
+#define ESP_ERROR_CHECK(x) do {                                                         \
+        esp_err_t err_rc_ = (x);                                                        \
+        if (err_rc_ != ESP_OK) {                                                        \
+            fprintf(stderr, "%s:%d: %s failed (0x%x)\n", __FILE__, __LINE__, #x, err_rc_); \
+            abort();                                                                    \
+        }                                                                               \
+    } while (0)
@@ -0,0 +1,42 @@
+/* FreeRTOS.h — host stand-in for the FreeRTOS types used by the capture pipeline, on top of pthreads.
+
+   Part of the host build of the capture pipeline, see tools/replay.c. Ticks are milliseconds.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef struct host_queue *SemaphoreHandle_t;
+typedef QueueHandle_t xQueueHandle;
+
+#define pdFALSE                 (0)
+#define pdTRUE                  (1)
+#define pdPASS                  (pdTRUE)
+#define pdFAIL                  (pdFALSE)
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS      (1)
+#define portNUM_PROCESSORS      (2)
+#define tskNO_AFFINITY          (0x7FFFFFFF)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+/**
+ * @brief Core the calling thread stands for, see xTaskCreatePinnedToCore() and host_set_core()
+ *
+ */
+BaseType_t xPortGetCoreID(void);
@@ -0,0 +1,30 @@
+/* semphr.h — host stand-in for FreeRTOS binary semaphores and mutexes, queues of one empty item as in FreeRTOS.
+
+   Part of the host build of the capture pipeline, see tools/replay.c.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include "freertos/queue.h"
+
+#define xSemaphoreCreateBinary()                xQueueCreate(1, 0)
+#define xSemaphoreTake(semaphore, ticks)        xQueueReceive(semaphore, NULL, ticks)
+#define xSemaphoreGive(semaphore)               xQueueSend(semaphore, NULL, 0)
+#define vSemaphoreDelete(semaphore)             vQueueDelete(semaphore)
+#define xSemaphoreCreateMutex()                 host_semaphore_create_mutex()
+
+/* A mutex starts given; no priority inheritance on the host */
+static inline QueueHandle_t host_semaphore_create_mutex(void)
+{
+    QueueHandle_t semaphore = xSemaphoreCreateBinary();
+    if (semaphore)
+    {
+        xSemaphoreGive(semaphore);
+    }
+    return semaphore;
+}
@@ -0,0 +1,69 @@
+/* Host shims — controls of the host build of the capture pipeline that have no ESP-IDF counterpart.
+
+   The shims in this directory stand in for FreeRTOS (pthreads), the Wi-Fi driver (frames injected by the
+   caller), NVS (memory) and the SD card (a directory, CONFIG_SD_MOUNT_POINT is set to "." by the build, or
+   an image file for the raw storage backend).
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "block_dev.h"
+
+/**
+ * @brief Most verbose level printed by the ESP_LOGx macros, ESP_LOG_WARN by default
+ *
+ */
+extern esp_log_level_t host_log_level;
+
+/**
+ * @brief Let the calling thread stand for a core, e.g. the Wi-Fi task's core 0 in the thread injecting frames
+ *
+ * @param core core reported by xPortGetCoreID()
+ */
+void host_set_core(int core);
+
+/**
+ * @brief Hand one received frame to the promiscuous callback, like the Wi-Fi task does
+ *
+ * Frames are dropped like in the driver while promiscuous mode is off or the frame type is filtered out.
+ *
+ * @param frame 802.11 frame without FCS
+ * @param length frame length
+ * @param channel channel to report, 0 for the one the sniffer is tuned to
+ * @param rssi signal strength to report
+ * @return true if the callback was called
+ */
+bool host_wifi_inject(const uint8_t *frame, uint32_t length, uint8_t channel, int8_t rssi);
+
+/**
+ * @brief Channel last set with esp_wifi_set_channel(), reported with injected frames
+ *
+ */
+uint8_t host_wifi_channel(void);
+
+/**
+ * @brief Block device of 512-byte sectors on an image file, e.g. a copy of the SD card taken with dd
+ *
+ * @param[out] dev block device
+ * @param path image file, created if missing
+ * @param sector_count size of a new or shorter image in sectors, 0 to take the size of the file
+ * @param writable open for writing
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the file cannot be opened or sized
+ */
+esp_err_t host_block_dev_open(block_dev_t *dev, const char *path, uint32_t sector_count, bool writable);
+
+/**
+ * @brief Close a block device opened with host_block_dev_open()
+ *
+ */
+void host_block_dev_close(block_dev_t *dev);
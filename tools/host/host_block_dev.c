@@ -0,0 +1,87 @@
+/* Block device shim — the SD card of the raw storage backend as an image file on the host.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#define _XOPEN_SOURCE 700 /* pread, pwrite, ftruncate */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "host.h"
+
+#define HOST_SECTOR_SIZE        (512)
+
+static esp_err_t host_block_dev_read(block_dev_t *dev, uint32_t sector, void *buf, uint32_t count)
+{
+    size_t length = (size_t)count * HOST_SECTOR_SIZE;
+
+    if (sector + count > dev->sector_count)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ssize_t done = pread((int)(intptr_t)dev->ctx, buf, length, (off_t)sector * HOST_SECTOR_SIZE);
+    if (done < 0)
+    {
+        return ESP_FAIL;
+    }
+    /* a sparse or short image reads as erased */
+    memset((uint8_t *)buf + done, 0, length - done);
+    return ESP_OK;
+}
+
+static esp_err_t host_block_dev_write(block_dev_t *dev, uint32_t sector, const void *buf, uint32_t count)
+{
+    size_t length = (size_t)count * HOST_SECTOR_SIZE;
+
+    if (sector + count > dev->sector_count)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return pwrite((int)(intptr_t)dev->ctx, buf, length, (off_t)sector * HOST_SECTOR_SIZE) == (ssize_t)length ?
+           ESP_OK : ESP_FAIL;
+}
+
+esp_err_t host_block_dev_open(block_dev_t *dev, const char *path, uint32_t sector_count, bool writable)
+{
+    struct stat st;
+    int fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return ESP_FAIL;
+    }
+    if (sector_count == 0)
+    {
+        sector_count = st.st_size / HOST_SECTOR_SIZE;
+    }
+    else if (writable && st.st_size < (off_t)sector_count * HOST_SECTOR_SIZE &&
+             ftruncate(fd, (off_t)sector_count * HOST_SECTOR_SIZE) != 0)
+    {
+        perror(path);
+        close(fd);
+        return ESP_FAIL;
+    }
+    memset(dev, 0, sizeof(*dev));
+    dev->sector_size = HOST_SECTOR_SIZE;
+    dev->sector_count = sector_count;
+    dev->read = host_block_dev_read;
+    dev->write = host_block_dev_write;
+    dev->ctx = (void *)(intptr_t)fd;
+    return ESP_OK;
+}
+
+void host_block_dev_close(block_dev_t *dev)
+{
+    close((int)(intptr_t)dev->ctx);
+    dev->ctx = NULL;
+}
@@ -0,0 +1,159 @@
+/* ESP-IDF shim — logging, NVS and the promiscuous Wi-Fi driver of the capture pipeline on the host.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "host.h"
+
+#define HOST_NVS_ENTRIES        (16)
+#define HOST_NVS_KEY_MAX        (16)
+#define HOST_WIFI_MAX_FRAME     (4095 - 4) /* sig_len is 12 bits and counts the FCS */
+#define HOST_WIFI_RATE_6M       (11)       /* rx_ctrl.rate code of 6 Mbps OFDM, what probe requests mostly use */
+
+typedef struct {
+    char key[HOST_NVS_KEY_MAX];
+    uint32_t value;
+} host_nvs_entry_t;
+
+static struct {
+    volatile bool promiscuous;
+    uint32_t filter_mask;
+    wifi_promiscuous_cb_t callback;
+    volatile uint8_t channel;
+} host_wifi = {
+    .filter_mask = WIFI_PROMIS_FILTER_MASK_ALL,
+    .channel = 1,
+};
+
+static host_nvs_entry_t host_nvs[HOST_NVS_ENTRIES];
+static const char host_log_letters[] = "NEWID";
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+
+void host_log(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+
+    if (level > host_log_level)
+    {
+        return;
+    }
+    fprintf(stderr, "%c (%u) %s: ", host_log_letters[level], xTaskGetTickCount(), tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+/* One namespace is enough for the pipeline, keys are looked up regardless of it */
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    for (int i = 0; i < HOST_NVS_ENTRIES; i++)
+    {
+        if (strncmp(host_nvs[i].key, key, HOST_NVS_KEY_MAX) == 0)
+        {
+            *out_value = host_nvs[i].value;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    for (int i = 0; i < HOST_NVS_ENTRIES; i++)
+    {
+        if (host_nvs[i].key[0] == '\0' || strncmp(host_nvs[i].key, key, HOST_NVS_KEY_MAX) == 0)
+        {
+            strncpy(host_nvs[i].key, key, HOST_NVS_KEY_MAX - 1);
+            host_nvs[i].value = value;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t esp_wifi_set_promiscuous(bool en)
+{
+    host_wifi.promiscuous = en;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_promiscuous_filter(const wifi_promiscuous_filter_t *filter)
+{
+    host_wifi.filter_mask = filter->filter_mask;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb)
+{
+    host_wifi.callback = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second)
+{
+    host_wifi.channel = primary;
+    return ESP_OK;
+}
+
+uint8_t host_wifi_channel(void)
+{
+    return host_wifi.channel;
+}
+
+bool host_wifi_inject(const uint8_t *frame, uint32_t length, uint8_t channel, int8_t rssi)
+{
+    /* the driver hands out its own buffer, valid for the duration of the callback */
+    static __thread union {
+        wifi_promiscuous_pkt_t pkt;
+        uint8_t raw[sizeof(wifi_promiscuous_pkt_t) + HOST_WIFI_MAX_FRAME + 4];
+    } buf;
+    wifi_promiscuous_pkt_type_t type = length > 0 ? (frame[0] >> 2) & 0x03 : WIFI_PKT_MISC;
+
+    if (!host_wifi.promiscuous || !host_wifi.callback || length > HOST_WIFI_MAX_FRAME ||
+        !(host_wifi.filter_mask & (1u << type)))
+    {
+        return false;
+    }
+    memset(&buf.pkt.rx_ctrl, 0, sizeof(buf.pkt.rx_ctrl));
+    buf.pkt.rx_ctrl.rssi = rssi;
+    buf.pkt.rx_ctrl.rate = HOST_WIFI_RATE_6M;
+    buf.pkt.rx_ctrl.channel = channel ? channel : host_wifi.channel;
+    buf.pkt.rx_ctrl.sig_len = length + 4;
+    /* the radio's free-running microsecond counter, 32 bits wide */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    buf.pkt.rx_ctrl.timestamp = (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+    memcpy(buf.pkt.payload, frame, length);
+    memset(buf.pkt.payload + length, 0, 4);
+    host_wifi.callback(&buf.pkt, type);
+    return true;
+}
@@ -0,0 +1,268 @@
+/* FreeRTOS shim — tasks, notifications, queues and ticks of the capture pipeline on top of pthreads.
+
+   Tasks are detached threads. Priorities and stack sizes are ignored, core affinity is only reported back
+   through xPortGetCoreID() so the per-core telemetry blocks are used as on the ESP32. A task deleting
+   itself leaves its control block behind, handles may still be used by other tasks afterwards.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "host.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t function;
+    void *parameters;
+    int core;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notifications;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint32_t length;
+    uint32_t item_size;
+    uint32_t head;
+    uint32_t count;
+    uint8_t items[];
+};
+
+static __thread struct host_task *host_current;
+static __thread int host_core;
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void host_deadline(TickType_t ticks, struct timespec *deadline)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += ticks * portTICK_PERIOD_MS / 1000;
+    deadline->tv_nsec += (long)(ticks * portTICK_PERIOD_MS % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/* Wait on cond until signalled or until the deadline, false once the deadline has passed */
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return ticks > 0 && pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static void *host_task_main(void *arg)
+{
+    struct host_task *task = arg;
+
+    host_current = task;
+    host_core = task->core;
+    task->function(task->parameters);
+    return NULL;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return host_core;
+}
+
+void host_set_core(int core)
+{
+    host_core = core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *created_task,
+                                   BaseType_t core_id)
+{
+    pthread_attr_t attr;
+    struct host_task *task = calloc(1, sizeof(*task));
+
+    if (!task)
+    {
+        return pdFAIL;
+    }
+    task->function = function;
+    task->parameters = parameters;
+    task->core = core_id == tskNO_AFFINITY ? 0 : core_id;
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->notified);
+    /* the handle must be valid before the task runs, the pipeline notifies tasks through it */
+    if (created_task)
+    {
+        *created_task = task;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int failed = pthread_create(&task->thread, &attr, host_task_main, task);
+    pthread_attr_destroy(&attr);
+    if (failed)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == host_current)
+    {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec delay = {
+        .tv_sec = ticks * portTICK_PERIOD_MS / 1000,
+        .tv_nsec = (long)(ticks * portTICK_PERIOD_MS % 1000) * 1000000,
+    };
+
+    nanosleep(&delay, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000) / portTICK_PERIOD_MS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notifications++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = host_current;
+    struct timespec deadline;
+    uint32_t value;
+
+    host_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&task->lock);
+    while (task->notifications == 0 && host_wait(&task->notified, &task->lock, ticks_to_wait, &deadline))
+    {
+    }
+    value = task->notifications;
+    if (value > 0)
+    {
+        task->notifications = clear_count_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue) + length * item_size);
+
+    if (queue)
+    {
+        pthread_mutex_init(&queue->lock, NULL);
+        host_cond_init(&queue->not_empty);
+        host_cond_init(&queue->not_full);
+        queue->length = length;
+        queue->item_size = item_size;
+    }
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    BaseType_t sent = pdFALSE;
+
+    host_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && host_wait(&queue->not_full, &queue->lock, ticks_to_wait, &deadline))
+    {
+    }
+    if (queue->count < queue->length)
+    {
+        uint32_t slot = (queue->head + queue->count) % queue->length;
+        if (queue->item_size > 0)
+        {
+            memcpy(queue->items + slot * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        pthread_cond_signal(&queue->not_empty);
+        sent = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    BaseType_t received = pdFALSE;
+
+    host_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && host_wait(&queue->not_empty, &queue->lock, ticks_to_wait, &deadline))
+    {
+    }
+    if (queue->count > 0)
+    {
+        if (queue->item_size > 0)
+        {
+            memcpy(buffer, queue->items + queue->head * queue->item_size, queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+        received = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue);
+}
@@ -0,0 +1,18 @@
+/* pcap.h — host stand-in for the pcap component of the ESP-IDF examples, link types only.
+
+   Part of the host build of the capture pipeline, see tools/replay.c.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+typedef enum {
+    PCAP_LINK_TYPE_LOOPBACK = 0,
+    PCAP_LINK_TYPE_ETHERNET = 1,
+    PCAP_LINK_TYPE_802_11 = 105,
+    PCAP_LINK_TYPE_802_11_RADIOTAP = 127,
+} pcap_link_type_t;
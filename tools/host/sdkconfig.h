@@ -0,0 +1,16 @@
+/* sdkconfig.h — host stand-in for the generated ESP-IDF configuration.
+
+   Part of the host build of the capture pipeline, see tools/replay.c.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+/* No Wi-Fi task on the host, frames are injected from the replay thread which counts as core 0 */
+#define CONFIG_ESP32_WIFI_TASK_PINNED_TO_CORE_0 0
+#define CONFIG_ESP32_WIFI_CSI_ENABLED 0
+#define CONFIG_FATFS_MAX_LFN 64
@@ -0,0 +1,149 @@
+/* iefuzz — fuzz entry point for the probe request element walker (main/ie_parser.c).
+
+   Usage: iefuzz [input...]
+
+   LLVMFuzzerTestOneInput() parses one input as the element list of a probe request, from a heap copy of
+   exactly its size so that AddressSanitizer catches any read past the end, and aborts if the result
+   breaks the parser's contract: fields pointing outside the input, a return value disagreeing with the
+   malformed flag, more vendors than there is room for, or a fingerprint that depends on anything but
+   the input.
+
+   With libFuzzer (clang, -DIEFUZZ_LIBFUZZER=ON) the fuzzer supplies main(). Otherwise main() runs each
+   file given, which suits AFL (afl-fuzz -i seeds -o findings -- build-tools/iefuzz @@) and replaying
+   crashes; without files it runs a quick built-in mutation of a typical probe request, as ctest does.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ie_parser.h"
+
+#define SMOKE_RUNS          (200000)
+#define SMOKE_MAX_LEN       (512)
+
+static bool field_inside(const ie_field_t *field, const uint8_t *data, size_t size)
+{
+    return !field->data || (field->data >= data && field->data + field->length <= data + size);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    uint8_t *copy = malloc(size ? size : 1);
+    ie_probe_info_t info;
+    ie_probe_info_t again;
+
+    if (!copy)
+    {
+        return 0;
+    }
+    memcpy(copy, data, size);
+    bool well_formed = ie_parse_probe(copy, size, &info);
+    if (well_formed == info.malformed || info.vendor_count > IE_MAX_VENDORS ||
+        info.element_count > size / 2 || !field_inside(&info.ssid, copy, size) ||
+        !field_inside(&info.rates, copy, size) || !field_inside(&info.ext_rates, copy, size) ||
+        !field_inside(&info.ht_caps, copy, size) || !field_inside(&info.vht_caps, copy, size) ||
+        !field_inside(&info.ext_caps, copy, size))
+    {
+        abort();
+    }
+    ie_parse_probe(copy, size, &again);
+    if (again.fingerprint != info.fingerprint || again.element_count != info.element_count)
+    {
+        abort();
+    }
+    free(copy);
+    return 0;
+}
+
+#ifndef IEFUZZ_LIBFUZZER
+/* Typical phone probe request elements: wildcard SSID, rates, extended rates, HT and extended capabilities, a vendor element */
+static const uint8_t probe_ies[] = {
+    0x00, 0x00,
+    0x01, 0x04, 0x02, 0x04, 0x0b, 0x16,
+    0x32, 0x08, 0x0c, 0x12, 0x18, 0x24, 0x30, 0x48, 0x60, 0x6c,
+    0x2d, 0x1a, 0x2d, 0x40, 0x17, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7f, 0x08, 0x04, 0x00, 0x0a, 0x02, 0x01, 0x00, 0x00, 0x40,
+    0xdd, 0x07, 0x00, 0x50, 0xf2, 0x08, 0x00, 0x10, 0x00,
+};
+
+static uint32_t smoke_seed = 1;
+
+static uint32_t smoke_random(void)
+{
+    smoke_seed ^= smoke_seed << 13;
+    smoke_seed ^= smoke_seed >> 17;
+    smoke_seed ^= smoke_seed << 5;
+    return smoke_seed;
+}
+
+/* The probe request with a few bytes flipped, cut or extended by random bytes, or pure noise */
+static size_t smoke_input(uint8_t *input)
+{
+    size_t size = sizeof(probe_ies);
+
+    memcpy(input, probe_ies, size);
+    switch (smoke_random() % 4)
+    {
+    case 0:
+        for (uint32_t i = smoke_random() % 4; i < 4; i++)
+        {
+            input[smoke_random() % size] = (uint8_t)smoke_random();
+        }
+        break;
+    case 1:
+        size = smoke_random() % size;
+        break;
+    case 2:
+        while (size < SMOKE_MAX_LEN && smoke_random() % 8)
+        {
+            input[size++] = (uint8_t)smoke_random();
+        }
+        break;
+    default:
+        size = smoke_random() % SMOKE_MAX_LEN;
+        for (size_t i = 0; i < size; i++)
+        {
+            input[i] = (uint8_t)smoke_random();
+        }
+        break;
+    }
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t input[1 << 16];
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *in = fopen(argv[i], "rb");
+        if (!in)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        size_t size = fread(input, 1, sizeof(input), in);
+        fclose(in);
+        LLVMFuzzerTestOneInput(input, size);
+    }
+    if (argc > 1)
+    {
+        return 0;
+    }
+    for (uint32_t run = 0; run < SMOKE_RUNS; run++)
+    {
+        LLVMFuzzerTestOneInput(input, smoke_input(input));
+    }
+    printf("%u mutated probe requests parsed\n", SMOKE_RUNS);
+    return 0;
+}
+#endif
@@ -0,0 +1,298 @@
+/* lzbtool — decompress capture files written with CONFIG_PCAP_COMPRESSION_ENABLED and benchmark the codec.
+
+   Usage: lzbtool d input.lzb output          decompress, skipping damaged frames
+          lzbtool c input output [block]      compress like the firmware does
+          lzbtool bench input [block]         compression ratio and speed on a capture file
+
+   The block size defaults to 16384 bytes (CONFIG_PCAP_BLOCK_SIZE).
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzb.h"
+
+#define DEFAULT_BLOCK_SIZE  (16 * 1024)
+#define HEADER_SIZE         (sizeof(lzb_frame_header_t))
+
+static uint16_t table[LZB_TABLE_SIZE];
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint8_t *read_file(const char *path, size_t *length)
+{
+    FILE *in = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (!in)
+    {
+        perror(path);
+        return NULL;
+    }
+    if (fseek(in, 0, SEEK_END) == 0 && (size = ftell(in)) >= 0 && fseek(in, 0, SEEK_SET) == 0)
+    {
+        data = malloc(size ? size : 1);
+        if (data && fread(data, 1, size, in) != (size_t)size)
+        {
+            free(data);
+            data = NULL;
+        }
+        *length = size;
+    }
+    if (!data)
+    {
+        fprintf(stderr, "%s: read failed\n", path);
+    }
+    fclose(in);
+    return data;
+}
+
+/* Frame at data, or 0 if the bytes there are not an intact frame */
+static uint32_t decode_frame(const uint8_t *data, size_t available, uint8_t *out, uint32_t capacity,
+                             uint32_t *raw_length)
+{
+    if (available < HEADER_SIZE || le32(data + offsetof(lzb_frame_header_t, magic)) != LZB_FRAME_MAGIC)
+    {
+        return 0;
+    }
+    uint32_t raw = le32(data + offsetof(lzb_frame_header_t, raw_length));
+    uint32_t stored = le32(data + offsetof(lzb_frame_header_t, stored_length));
+    uint32_t checksum = le32(data + offsetof(lzb_frame_header_t, checksum));
+    if (raw > capacity || stored > raw || stored > available - HEADER_SIZE)
+    {
+        return 0;
+    }
+    if (stored == raw)
+    {
+        memcpy(out, data + HEADER_SIZE, raw);
+    }
+    else if (lzb_decompress(data + HEADER_SIZE, stored, out, capacity) != (int32_t)raw)
+    {
+        return 0;
+    }
+    if (lzb_checksum(out, raw) != checksum)
+    {
+        return 0;
+    }
+    *raw_length = raw;
+    return HEADER_SIZE + stored;
+}
+
+static int decompress(const char *input, const char *output)
+{
+    size_t length;
+    size_t pos = 0;
+    uint8_t *data = read_file(input, &length);
+    uint8_t *out = malloc(LZB_MAX_BLOCK_SIZE);
+    unsigned long frames = 0, damaged = 0, skipped = 0;
+    FILE *fp;
+
+    if (!data || !out)
+    {
+        return 1;
+    }
+    fp = fopen(output, "wb");
+    if (!fp)
+    {
+        perror(output);
+        return 1;
+    }
+    while (pos < length)
+    {
+        uint32_t raw;
+        uint32_t used = decode_frame(data + pos, length - pos, out, LZB_MAX_BLOCK_SIZE, &raw);
+        if (used)
+        {
+            fwrite(out, 1, raw, fp);
+            frames++;
+            pos += used;
+            continue;
+        }
+        /* damaged or cut off: look for the next frame that decodes */
+        size_t next = pos + 1;
+        while (next < length && !decode_frame(data + next, length - next, out, LZB_MAX_BLOCK_SIZE, &raw))
+        {
+            next++;
+        }
+        damaged++;
+        skipped += next - pos;
+        pos = next;
+    }
+    free(out);
+    free(data);
+    if (fclose(fp) != 0)
+    {
+        perror(output);
+        return 1;
+    }
+    fprintf(stderr, "%lu frames decompressed, %lu damaged regions (%lu bytes) skipped\n", frames, damaged, skipped);
+    return damaged ? 3 : 0;
+}
+
+/* Same framing as pcap_write_compressed() in the firmware; returns the output length */
+static size_t compress_frame(const uint8_t *data, uint32_t length, uint8_t *out)
+{
+    uint32_t stored = lzb_compress(data, length, out + HEADER_SIZE, length - 1, table);
+
+    if (stored == 0)
+    {
+        memcpy(out + HEADER_SIZE, data, length);
+        stored = length;
+    }
+    put32(out + offsetof(lzb_frame_header_t, magic), LZB_FRAME_MAGIC);
+    put32(out + offsetof(lzb_frame_header_t, raw_length), length);
+    put32(out + offsetof(lzb_frame_header_t, stored_length), stored);
+    put32(out + offsetof(lzb_frame_header_t, checksum), lzb_checksum(data, length));
+    return HEADER_SIZE + stored;
+}
+
+static int compress(const char *input, const char *output, uint32_t block_size)
+{
+    size_t length;
+    uint8_t *data = read_file(input, &length);
+    uint8_t *out = malloc(HEADER_SIZE + block_size);
+    FILE *fp;
+
+    if (!data || !out)
+    {
+        return 1;
+    }
+    fp = fopen(output, "wb");
+    if (!fp)
+    {
+        perror(output);
+        return 1;
+    }
+    for (size_t pos = 0; pos < length; pos += block_size)
+    {
+        uint32_t chunk = length - pos < block_size ? length - pos : block_size;
+        fwrite(out, 1, compress_frame(data + pos, chunk, out), fp);
+    }
+    free(out);
+    free(data);
+    return fclose(fp) == 0 ? 0 : 1;
+}
+
+static int bench(const char *input, uint32_t block_size)
+{
+    size_t length;
+    size_t compressed = 0;
+    uint8_t *data = read_file(input, &length);
+    uint8_t *out = malloc(length / block_size * (HEADER_SIZE + block_size) + HEADER_SIZE + block_size);
+    uint8_t *check = malloc(block_size);
+    double start, compress_s, decompress_s;
+    int rounds = 0;
+
+    if (!data || !out || !check || length == 0)
+    {
+        return 1;
+    }
+    /* repeat small inputs so the timing is not all clock resolution */
+    start = now_s();
+    do
+    {
+        compressed = 0;
+        for (size_t pos = 0; pos < length; pos += block_size)
+        {
+            uint32_t chunk = length - pos < block_size ? length - pos : block_size;
+            compressed += compress_frame(data + pos, chunk, out + compressed);
+        }
+        rounds++;
+    } while (now_s() - start < 0.5);
+    compress_s = (now_s() - start) / rounds;
+
+    start = now_s();
+    for (int r = 0; r < rounds; r++)
+    {
+        size_t pos = 0;
+        size_t raw_pos = 0;
+        while (pos < compressed)
+        {
+            uint32_t raw;
+            uint32_t used = decode_frame(out + pos, compressed - pos, check, block_size, &raw);
+            if (!used || memcmp(check, data + raw_pos, raw) != 0)
+            {
+                fprintf(stderr, "round trip failed at input offset %zu\n", raw_pos);
+                return 1;
+            }
+            pos += used;
+            raw_pos += raw;
+        }
+    }
+    decompress_s = (now_s() - start) / rounds;
+
+    printf("%s: %zu -> %zu bytes (%.1f%%, %.2fx) in %u byte blocks\n", input, length, compressed,
+           100.0 * compressed / length, (double)length / compressed, block_size);
+    printf("compress %.1f MB/s, decompress + verify %.1f MB/s\n", length / compress_s / 1e6,
+           length / decompress_s / 1e6);
+    free(check);
+    free(out);
+    free(data);
+    return 0;
+}
+
+static int usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s d input.lzb output\n"
+                    "       %s c input output [block]\n"
+                    "       %s bench input [block]\n", argv0, argv0, argv0);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t block_size = DEFAULT_BLOCK_SIZE;
+
+    if (argc == 4 && strcmp(argv[1], "d") == 0)
+    {
+        return decompress(argv[2], argv[3]);
+    }
+    if ((argc == 4 || argc == 5) && strcmp(argv[1], "c") == 0)
+    {
+        block_size = argc == 5 ? strtoul(argv[4], NULL, 0) : block_size;
+        if (block_size < 1 || block_size > LZB_MAX_BLOCK_SIZE)
+        {
+            return usage(argv[0]);
+        }
+        return compress(argv[2], argv[3], block_size);
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "bench") == 0)
+    {
+        block_size = argc == 4 ? strtoul(argv[3], NULL, 0) : block_size;
+        if (block_size < 1 || block_size > LZB_MAX_BLOCK_SIZE)
+        {
+            return usage(argv[0]);
+        }
+        return bench(argv[2], block_size);
+    }
+    return usage(argv[0]);
+}
@@ -0,0 +1,317 @@
+/* pcaprecover — salvage the intact records of a damaged or cut-off capture file (file_%06d.pcap).
+
+   Usage: pcaprecover input.pcap [output.pcap]
+
+   Records are checked one by one: complete, lengths within the snap length, microseconds
+   below one second, timestamps not going back (the firmware never writes decreasing ones)
+   and, for radiotap files, a plausible radiotap header. The first record failing a check
+   is where the damage begins; the scan then looks for the next run of intact records and
+   carries on from there. The end of a file whose space was reserved up front holds zeros or
+   stale card data rather than records; such a tail is not counted as damage, unless the
+   last record runs into it: a record header followed by zeros, or by fewer bytes than it
+   announces, is a record cut off. Intact records are copied to the output, if given.
+
+   Exit status: 0 if the file is intact, 2 if damage was found, 1 on error.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCAP_MAGIC                  (0xA1B2C3D4)
+#define PCAP_MAGIC_NS               (0xA1B23C4D)
+#define PCAP_LINK_TYPE_802_11       (105)
+#define PCAP_LINK_TYPE_RADIOTAP     (127)
+#define FILE_HEADER_LEN             (24)
+#define RECORD_HEADER_LEN           (16)
+#define MAX_SNAPLEN                 (262144)
+#define MIN_FRAME_LEN               (10)    /* shortest 802.11 frame, an ACK without FCS */
+#define BACKWARD_SLACK_S            (1)     /* tolerated step back between records */
+#define RESYNC_RECORDS              (4)     /* intact records in a row needed to trust a resync point */
+#define CUT_ZERO_RUN                (8)     /* trailing zero bytes of a record before a zero tail: cut off; fewer can be the frame's own */
+#define MAX_FORWARD_S               (86400) /* step forward a cut-off record header may still take */
+
+typedef struct {
+    bool swapped;           /* file written on a host of the other byte order */
+    uint32_t sub_second;    /* units per second of the sub-second field */
+    uint32_t snaplen;
+    uint32_t link_type;
+} pcap_info_t;
+
+static uint32_t get32(const pcap_info_t *info, const uint8_t *p)
+{
+    if (info->swapped)
+    {
+        return (uint32_t)p[3] | (uint32_t)p[2] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 24;
+    }
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint8_t *read_file(const char *path, size_t *length)
+{
+    FILE *in = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (!in)
+    {
+        perror(path);
+        return NULL;
+    }
+    if (fseek(in, 0, SEEK_END) == 0 && (size = ftell(in)) >= 0 && fseek(in, 0, SEEK_SET) == 0)
+    {
+        data = malloc(size ? size : 1);
+        if (data && fread(data, 1, size, in) != (size_t)size)
+        {
+            free(data);
+            data = NULL;
+        }
+        *length = size;
+    }
+    if (!data)
+    {
+        fprintf(stderr, "%s: read failed\n", path);
+    }
+    fclose(in);
+    return data;
+}
+
+static bool parse_file_header(const uint8_t *data, size_t length, pcap_info_t *info)
+{
+    if (length < FILE_HEADER_LEN)
+    {
+        return false;
+    }
+    for (int swapped = 0; swapped < 2; swapped++)
+    {
+        info->swapped = swapped;
+        uint32_t magic = get32(info, data);
+        if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NS)
+        {
+            info->sub_second = magic == PCAP_MAGIC ? 1000000 : 1000000000;
+            info->snaplen = get32(info, data + 16);
+            info->link_type = get32(info, data + 20);
+            if (info->snaplen == 0 || info->snaplen > MAX_SNAPLEN)
+            {
+                info->snaplen = MAX_SNAPLEN;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Length of the intact record at offset, or 0; prev_seconds is the time of the record before, 0 if none */
+static size_t check_record(const pcap_info_t *info, const uint8_t *data, size_t length, size_t offset,
+                           uint32_t prev_seconds)
+{
+    if (length - offset < RECORD_HEADER_LEN)
+    {
+        return 0;
+    }
+    const uint8_t *header = data + offset;
+    uint32_t seconds = get32(info, header);
+    uint32_t sub_second = get32(info, header + 4);
+    uint32_t captured = get32(info, header + 8);
+    uint32_t original = get32(info, header + 12);
+
+    if (sub_second >= info->sub_second || captured > info->snaplen || captured > original ||
+        original > MAX_SNAPLEN || captured < MIN_FRAME_LEN || captured > length - offset - RECORD_HEADER_LEN)
+    {
+        return 0;
+    }
+    if (seconds == 0 || seconds + BACKWARD_SLACK_S < prev_seconds)
+    {
+        return 0;
+    }
+    if (info->link_type == PCAP_LINK_TYPE_RADIOTAP)
+    {
+        const uint8_t *radiotap = header + RECORD_HEADER_LEN;
+        /* version 0, little-endian length regardless of the file's byte order */
+        uint32_t radiotap_length = radiotap[2] | radiotap[3] << 8;
+        if (radiotap[0] != 0 || radiotap_length < 8 || radiotap_length > captured)
+        {
+            return 0;
+        }
+    }
+    return RECORD_HEADER_LEN + captured;
+}
+
+static bool zero_tail(const uint8_t *data, size_t length, size_t offset)
+{
+    for (size_t i = offset; i < length; i++)
+    {
+        if (data[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Whether the record at offset ends in zeros that carry on past it to the end of the file: its payload was
+   not written, the header only made it because it was in an earlier write. A last record ending in zeros
+   right at the end of the file is taken as it is. */
+static bool runs_into_zeros(const uint8_t *data, size_t length, size_t offset, size_t record)
+{
+    return record >= RECORD_HEADER_LEN + CUT_ZERO_RUN && offset + record < length &&
+           zero_tail(data, length, offset + record - CUT_ZERO_RUN);
+}
+
+/* Whether the bytes at offset look like the header of a record following the one before, however long */
+static bool plausible_header(const pcap_info_t *info, const uint8_t *data, size_t length, size_t offset,
+                             uint32_t prev_seconds)
+{
+    if (length - offset <= RECORD_HEADER_LEN || zero_tail(data, length, offset + RECORD_HEADER_LEN))
+    {
+        /* written up to somewhere in the header (a tail of zeros only was handled before): a record cut off */
+        return true;
+    }
+    const uint8_t *header = data + offset;
+    uint32_t seconds = get32(info, header);
+    uint32_t captured = get32(info, header + 8);
+    uint32_t original = get32(info, header + 12);
+
+    return get32(info, header + 4) < info->sub_second && captured >= MIN_FRAME_LEN &&
+           captured <= info->snaplen && captured <= original && original <= MAX_SNAPLEN && seconds != 0 &&
+           seconds + BACKWARD_SLACK_S >= prev_seconds && (prev_seconds == 0 || seconds - prev_seconds < MAX_FORWARD_S);
+}
+
+/* First offset after a damaged one where RESYNC_RECORDS intact records follow (or fewer up to the end) */
+static size_t resync(const pcap_info_t *info, const uint8_t *data, size_t length, size_t offset,
+                     uint32_t prev_seconds)
+{
+    for (size_t start = offset + 1; start + RECORD_HEADER_LEN <= length; start++)
+    {
+        size_t at = start;
+        uint32_t seconds = prev_seconds;
+        int run = 0;
+        size_t record;
+        while (run < RESYNC_RECORDS && at < length && (record = check_record(info, data, length, at, seconds)) > 0)
+        {
+            seconds = get32(info, data + at);
+            at += record;
+            run++;
+        }
+        if (run == RESYNC_RECORDS || (run > 0 && at == length))
+        {
+            return start;
+        }
+    }
+    return length;
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s input.pcap [output.pcap]\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    pcap_info_t info;
+    size_t length;
+    size_t offset = FILE_HEADER_LEN;
+    size_t lost = 0;
+    uint32_t prev_seconds = 0;
+    unsigned long kept = 0;
+    unsigned long damaged = 0;
+    FILE *out = NULL;
+
+    if (argc != 2 && argc != 3)
+    {
+        return usage(argv[0]);
+    }
+    uint8_t *data = read_file(argv[1], &length);
+    if (!data)
+    {
+        return 1;
+    }
+    if (!parse_file_header(data, length, &info))
+    {
+        fprintf(stderr, "%s: no pcap file header, nothing to recover\n", argv[1]);
+        free(data);
+        return 1;
+    }
+    if (argc == 3)
+    {
+        out = fopen(argv[2], "wb");
+        if (!out || fwrite(data, 1, FILE_HEADER_LEN, out) != FILE_HEADER_LEN)
+        {
+            perror(argv[2]);
+            free(data);
+            return 1;
+        }
+    }
+
+    while (offset < length)
+    {
+        size_t record = check_record(&info, data, length, offset, prev_seconds);
+        if (record > 0 && runs_into_zeros(data, length, offset, record))
+        {
+            printf("cut off      record %lu at offset %zu, its payload runs into %zu zero bytes at the end\n", kept,
+                   offset, length - offset - RECORD_HEADER_LEN);
+            lost += length - offset;
+            damaged++;
+            offset = length;
+            break;
+        }
+        if (record > 0)
+        {
+            if (out && fwrite(data + offset, 1, record, out) != record)
+            {
+                perror(argv[2]);
+                fclose(out);
+                free(data);
+                return 1;
+            }
+            prev_seconds = get32(&info, data + offset);
+            offset += record;
+            kept++;
+            continue;
+        }
+        if (zero_tail(data, length, offset))
+        {
+            printf("unwritten    %zu zero bytes at the end, from offset %zu\n", length - offset, offset);
+            break;
+        }
+        size_t next = resync(&info, data, length, offset, prev_seconds);
+        if (next == length && !plausible_header(&info, data, length, offset, prev_seconds))
+        {
+            /* no record starts here and none follows: reserved space never written, holding old data */
+            printf("unwritten    %zu bytes of stale data at the end, from offset %zu\n", length - offset, offset);
+            break;
+        }
+        if (damaged == 0)
+        {
+            printf("damage       begins at offset %zu, after record %lu\n", offset, kept);
+        }
+        printf("skipped      %zu bytes at offset %zu..%zu%s\n", next - offset, offset, next,
+               next == length ? " (end of file)" : "");
+        lost += next - offset;
+        damaged++;
+        offset = next;
+    }
+
+    printf("kept         %lu intact records, %zu of %zu bytes\n", kept, offset - lost, length);
+    if (damaged == 0)
+    {
+        printf("file is intact\n");
+    }
+    if (out && fclose(out) != 0)
+    {
+        perror(argv[2]);
+        free(data);
+        return 1;
+    }
+    free(data);
+    return damaged > 0 ? 2 : 0;
+}
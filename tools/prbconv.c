@@ -0,0 +1,217 @@
+/* prbconv — convert compact capture files (file_%06d.prb) to pcap or CSV.
+
+   Usage: prbconv [-f pcap|csv] input.prb output
+
+   The pcap output uses radiotap headers carrying channel and RSSI, followed by a
+   rebuilt probe request MAC header (broadcast receiver/BSSID, no elements).
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "capture_record.h"
+
+#define PCAP_MAGIC                  (0xA1B2C3D4)
+#define PCAP_LINK_TYPE_RADIOTAP     (127)
+#define RADIOTAP_PRESENT_CHANNEL    (1 << 3)
+#define RADIOTAP_PRESENT_ANTSIGNAL  (1 << 5)
+#define RADIOTAP_CHAN_2GHZ          (0x0080)
+#define RADIOTAP_LEN                (13)
+#define MAC_HEADER_LEN              (24)
+
+typedef enum {
+    OUTPUT_PCAP,
+    OUTPUT_CSV,
+} output_format_t;
+
+/* Records are little-endian on the card, decode byte by byte so any host works */
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+static void decode_record(const uint8_t *raw, capture_record_t *rec)
+{
+    rec->seconds = le32(raw + offsetof(capture_record_t, seconds));
+    rec->microseconds = le32(raw + offsetof(capture_record_t, microseconds));
+    memcpy(rec->mac, raw + offsetof(capture_record_t, mac), sizeof(rec->mac));
+    rec->rssi = (int8_t)raw[offsetof(capture_record_t, rssi)];
+    rec->channel = raw[offsetof(capture_record_t, channel)];
+    rec->seq_ctrl = le16(raw + offsetof(capture_record_t, seq_ctrl));
+    rec->flags = le16(raw + offsetof(capture_record_t, flags));
+    rec->ssid_hash = le32(raw + offsetof(capture_record_t, ssid_hash));
+    rec->fingerprint = le32(raw + offsetof(capture_record_t, fingerprint));
+}
+
+static void write_pcap_header(FILE *out)
+{
+    uint8_t header[24];
+
+    put32(header, PCAP_MAGIC);
+    put16(header + 4, 2);
+    put16(header + 6, 4);
+    put32(header + 8, 0);
+    put32(header + 12, 0);
+    put32(header + 16, 0xFFFF);
+    put32(header + 20, PCAP_LINK_TYPE_RADIOTAP);
+    fwrite(header, 1, sizeof(header), out);
+}
+
+static void write_pcap_record(FILE *out, const capture_record_t *rec)
+{
+    uint8_t packet[16 + RADIOTAP_LEN + MAC_HEADER_LEN] = {0};
+    uint8_t *radiotap = packet + 16;
+    uint8_t *mac = radiotap + RADIOTAP_LEN;
+    uint16_t freq = rec->channel == 14 ? 2484 : 2407 + 5 * rec->channel;
+
+    put32(packet, rec->seconds);
+    put32(packet + 4, rec->microseconds);
+    put32(packet + 8, RADIOTAP_LEN + MAC_HEADER_LEN);
+    put32(packet + 12, RADIOTAP_LEN + MAC_HEADER_LEN);
+
+    put16(radiotap + 2, RADIOTAP_LEN);
+    put32(radiotap + 4, RADIOTAP_PRESENT_CHANNEL | RADIOTAP_PRESENT_ANTSIGNAL);
+    put16(radiotap + 8, freq);
+    put16(radiotap + 10, RADIOTAP_CHAN_2GHZ);
+    radiotap[12] = (uint8_t)rec->rssi;
+
+    mac[0] = 0x40; /* management, probe request */
+    memset(mac + 4, 0xFF, 6);
+    memcpy(mac + 10, rec->mac, 6);
+    memset(mac + 16, 0xFF, 6);
+    put16(mac + 22, rec->seq_ctrl);
+    fwrite(packet, 1, sizeof(packet), out);
+}
+
+static void write_csv_record(FILE *out, const capture_record_t *rec)
+{
+    fprintf(out, "%u.%06u,%02x:%02x:%02x:%02x:%02x:%02x,%d,%u,%u,%08x,%08x,%u\n",
+            rec->seconds, rec->microseconds,
+            rec->mac[0], rec->mac[1], rec->mac[2], rec->mac[3], rec->mac[4], rec->mac[5],
+            rec->rssi, rec->channel, rec->seq_ctrl >> 4, rec->ssid_hash, rec->fingerprint, rec->flags);
+}
+
+static int usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-f pcap|csv] input.prb output\n", argv0);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    output_format_t format = OUTPUT_PCAP;
+    int arg = 1;
+    uint8_t raw_header[sizeof(capture_file_header_t)];
+    uint8_t *raw;
+    unsigned long count = 0;
+
+    if (argc > arg + 1 && strcmp(argv[arg], "-f") == 0)
+    {
+        if (strcmp(argv[arg + 1], "pcap") == 0)
+        {
+            format = OUTPUT_PCAP;
+        }
+        else if (strcmp(argv[arg + 1], "csv") == 0)
+        {
+            format = OUTPUT_CSV;
+        }
+        else
+        {
+            return usage(argv[0]);
+        }
+        arg += 2;
+    }
+    if (argc != arg + 2)
+    {
+        return usage(argv[0]);
+    }
+
+    FILE *in = fopen(argv[arg], "rb");
+    if (!in)
+    {
+        perror(argv[arg]);
+        return 1;
+    }
+    if (fread(raw_header, 1, sizeof(raw_header), in) != sizeof(raw_header) ||
+        le32(raw_header + offsetof(capture_file_header_t, magic)) != CAPTURE_RECORD_MAGIC)
+    {
+        fprintf(stderr, "%s: not a compact capture file\n", argv[arg]);
+        fclose(in);
+        return 1;
+    }
+    uint16_t version = le16(raw_header + offsetof(capture_file_header_t, version));
+    uint16_t record_size = le16(raw_header + offsetof(capture_file_header_t, record_size));
+    if (version > CAPTURE_RECORD_VERSION || record_size < sizeof(capture_record_t))
+    {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n", argv[arg], version, record_size);
+        fclose(in);
+        return 1;
+    }
+
+    FILE *out = fopen(argv[arg + 1], format == OUTPUT_PCAP ? "wb" : "w");
+    if (!out)
+    {
+        perror(argv[arg + 1]);
+        fclose(in);
+        return 1;
+    }
+    if (format == OUTPUT_PCAP)
+    {
+        write_pcap_header(out);
+    }
+    else
+    {
+        fprintf(out, "time,mac,rssi,channel,seq,ssid_hash,fingerprint,flags\n");
+    }
+
+    /* newer writers may append fields, only the known prefix of each record is decoded */
+    raw = malloc(record_size);
+    while (raw && fread(raw, 1, record_size, in) == record_size)
+    {
+        capture_record_t rec;
+        decode_record(raw, &rec);
+        if (format == OUTPUT_PCAP)
+        {
+            write_pcap_record(out, &rec);
+        }
+        else
+        {
+            write_csv_record(out, &rec);
+        }
+        count++;
+    }
+    free(raw);
+    fclose(in);
+    if (fclose(out) != 0)
+    {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+    fprintf(stderr, "%lu records converted\n", count);
+    return 0;
+}
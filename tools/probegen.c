@@ -0,0 +1,163 @@
+/* probegen — write a synthetic probe-request capture, see workload.h.
+
+   Usage: probegen [-n devices] [-d seconds] [-s seed] [-c channels] [-g percent] [-b burst] [-p] output.pcap
+
+   The crowd of -n devices (default 1000) is simulated for -d seconds (default 60) from seed -s; the same
+   arguments always give the same file. -c sets the swept channels (e.g. 1,6,11), -g scales the gaps
+   between scans in percent and -b sets the mean burst per channel. Records carry a radiotap header with
+   the channel and signal strength, or none with -p (link type 802.11), and can be fed to replay.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "workload.h"
+
+#define PCAP_MAGIC_US               (0xA1B2C3D4)
+#define PCAP_LINK_TYPE_802_11       (105)
+#define PCAP_LINK_TYPE_RADIOTAP     (127)
+#define RADIOTAP_LEN                (13)
+#define RADIOTAP_PRESENT            ((1u << 3) | (1u << 5)) /* channel, dBm antenna signal */
+#define RADIOTAP_CHANNEL_2GHZ_CCK   (0x00A0)
+
+static void put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+static bool parse_channels(const char *list, workload_config_t *config)
+{
+    char *end;
+
+    config->channel_count = 0;
+    while (*list && config->channel_count < WORKLOAD_MAX_CHANNELS)
+    {
+        unsigned long channel = strtoul(list, &end, 10);
+        if (end == list || channel < 1 || channel > 14 || (*end && *end != ','))
+        {
+            return false;
+        }
+        config->channels[config->channel_count++] = channel;
+        list = *end ? end + 1 : end;
+    }
+    return config->channel_count > 0 && !*list;
+}
+
+static int usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n devices] [-d seconds] [-s seed] [-c channels] [-g percent] [-b burst] [-p] "
+                    "output.pcap\n", argv0);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    workload_config_t config;
+    workload_frame_t frame;
+    bool radiotap = true;
+    const char *channels = NULL;
+    uint8_t header[24] = { 0 };
+    uint8_t record[16 + RADIOTAP_LEN] = { 0 };
+    uint64_t frames = 0;
+    int opt;
+
+    workload_default_config(&config, 1000, 1, 60);
+    while ((opt = getopt(argc, argv, "n:d:s:c:g:b:p")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.devices = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            config.duration_s = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            channels = optarg;
+            break;
+        case 'g':
+            config.scan_gap_scale = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            config.burst_mean = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            radiotap = false;
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || (channels && !parse_channels(channels, &config)))
+    {
+        return usage(argv[0]);
+    }
+
+    workload_t *workload = workload_create(&config);
+    if (!workload)
+    {
+        fprintf(stderr, "cannot set up a crowd of %u devices\n", config.devices);
+        return 1;
+    }
+    FILE *out = fopen(argv[optind], "wb");
+    if (!out)
+    {
+        perror(argv[optind]);
+        workload_destroy(workload);
+        return 1;
+    }
+
+    put32(header, PCAP_MAGIC_US);
+    put16(header + 4, 2);
+    put16(header + 6, 4);
+    put32(header + 16, WORKLOAD_MAX_FRAME + RADIOTAP_LEN);
+    put32(header + 20, radiotap ? PCAP_LINK_TYPE_RADIOTAP : PCAP_LINK_TYPE_802_11);
+    fwrite(header, 1, sizeof(header), out);
+
+    /* radiotap: version, pad, length, present, channel frequency and flags, signal */
+    put16(record + 18, RADIOTAP_LEN);
+    put32(record + 20, RADIOTAP_PRESENT);
+    put16(record + 26, RADIOTAP_CHANNEL_2GHZ_CCK);
+    uint32_t prefix = radiotap ? RADIOTAP_LEN : 0;
+    while (workload_next(workload, &frame))
+    {
+        put32(record, frame.timestamp_us / 1000000);
+        put32(record + 4, frame.timestamp_us % 1000000);
+        put32(record + 8, frame.length + prefix);
+        put32(record + 12, frame.length + prefix);
+        put16(record + 24, frame.channel == 14 ? 2484 : 2407 + 5 * frame.channel);
+        record[28] = (uint8_t)frame.rssi;
+        fwrite(record, 1, 16 + prefix, out);
+        fwrite(frame.data, 1, frame.length, out);
+        frames++;
+    }
+    if (fclose(out) != 0)
+    {
+        perror(argv[optind]);
+        workload_destroy(workload);
+        return 1;
+    }
+    printf("%llu probe requests from %u devices and %llu addresses over %u s, %.0f frames/s\n",
+           (unsigned long long)frames, config.devices, (unsigned long long)workload_addresses(workload),
+           config.duration_s, config.duration_s ? (double)frames / config.duration_s : 0);
+    workload_destroy(workload);
+    return 0;
+}
@@ -0,0 +1,189 @@
+/* recovertest — checks of pcaprecover on capture files cut off in the ways a power cut leaves them.
+
+   Usage: recovertest path/to/pcaprecover
+
+   Writes a capture of synthetic probe requests, then variants of it to recovertest.pcap in the current
+   directory: intact, cut at a record boundary and inside a record, with the rest of the reserved space
+   zero-filled, left with stale card data or missing, and damaged in the middle. Each variant is run
+   through pcaprecover and its exit status compared with the expected one: 0 for a file whose records
+   are all intact (an unwritten tail is not damage), 2 where a record was lost or cut off.
+   Exit status 0 if every check passed.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#define RECORDS                 (200)
+#define FILE_HEADER_LEN         (24)
+#define RECORD_HEADER_LEN       (16)
+#define LINK_TYPE_80211         (105)
+#define SNAPLEN                 (256)
+#define FIRST_SECONDS           (1760000000)
+#define TEST_FILE               "recovertest.pcap"
+
+static uint8_t capture[FILE_HEADER_LEN + RECORDS * (RECORD_HEADER_LEN + SNAPLEN)];
+static size_t capture_length;
+static size_t record_offset[RECORDS];
+static const char *pcaprecover;
+static int failures;
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    memcpy(p, &value, sizeof(value));
+}
+
+/* A probe request: header, SSID of a length varying with i and the supported rates, never ending in zero;
+   every 50th ends in a vendor element with zeros at its end */
+static size_t probe_request(uint8_t *frame, uint32_t i)
+{
+    static const uint8_t rates[] = { 0x01, 0x04, 0x82, 0x84, 0x8b, 0x96 };
+    size_t ssid_length = i % 17;
+    size_t length = 24;
+
+    memset(frame, 0xff, length);
+    frame[0] = 0x40;
+    frame[1] = 0x00;
+    frame[2] = frame[3] = 0x00;
+    memcpy(frame + 10, (const uint8_t[]) { 0x02, 0x00, 0x5e, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i }, 6);
+    frame[22] = (uint8_t)(i << 4);
+    frame[23] = (uint8_t)(i >> 4);
+    frame[length++] = 0x00;
+    frame[length++] = (uint8_t)ssid_length;
+    for (size_t c = 0; c < ssid_length; c++)
+    {
+        frame[length++] = (uint8_t)('a' + c);
+    }
+    memcpy(frame + length, rates, sizeof(rates));
+    length += sizeof(rates);
+    if (i % 50 == 49)
+    {
+        memcpy(frame + length, (const uint8_t[]) { 0xdd, 0x06, 0x00, 0x50, 0xf2, 0x08, 0x00, 0x00 }, 8);
+        length += 8;
+    }
+    return length;
+}
+
+/* A capture of RECORDS frames, 20 ms apart from seconds on */
+static size_t build_capture(uint8_t *data, uint32_t seconds, size_t *offsets)
+{
+    size_t length = FILE_HEADER_LEN;
+
+    put32(data, 0xA1B2C3D4);
+    data[4] = 2;
+    data[5] = 0;
+    data[6] = 4;
+    data[7] = 0;
+    put32(data + 8, 0);
+    put32(data + 12, 0);
+    put32(data + 16, SNAPLEN);
+    put32(data + 20, LINK_TYPE_80211);
+    for (uint32_t i = 0; i < RECORDS; i++)
+    {
+        uint8_t *record = data + length;
+        size_t frame_length = probe_request(record + RECORD_HEADER_LEN, i);
+        put32(record, seconds + i / 50);
+        put32(record + 4, i % 50 * 20000);
+        put32(record + 8, frame_length);
+        put32(record + 12, frame_length);
+        if (offsets)
+        {
+            offsets[i] = length;
+        }
+        length += RECORD_HEADER_LEN + frame_length;
+    }
+    return length;
+}
+
+static int run_pcaprecover(const uint8_t *data, size_t length)
+{
+    char command[512];
+    FILE *out = fopen(TEST_FILE, "wb");
+
+    if (!out || fwrite(data, 1, length, out) != length || fclose(out) != 0)
+    {
+        perror(TEST_FILE);
+        exit(1);
+    }
+    snprintf(command, sizeof(command), "\"%s\" " TEST_FILE " > /dev/null", pcaprecover);
+    int status = system(command);
+    return status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void check(const uint8_t *data, size_t length, int expected, const char *what)
+{
+    int status = run_pcaprecover(data, length);
+    printf("%-44s %s (exit %d)\n", what, status == expected ? "ok" : "FAILED", status);
+    failures += status != expected;
+}
+
+/* The capture written up to cut, the rest of its length as the card left it: zeros, old data or nothing */
+static void check_cut(size_t cut, const uint8_t *fill, int expected, const char *what)
+{
+    uint8_t *data = malloc(capture_length);
+
+    memcpy(data, capture, cut);
+    if (fill)
+    {
+        memcpy(data + cut, fill + cut, capture_length - cut);
+    }
+    check(data, fill ? capture_length : cut, expected, what);
+    free(data);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s path/to/pcaprecover\n", argv[0]);
+        return 1;
+    }
+    pcaprecover = argv[1];
+    capture_length = build_capture(capture, FIRST_SECONDS, record_offset);
+
+    /* what a card holds past the written end: zeros, an earlier capture of the same length or any other data */
+    uint8_t *zeros = calloc(1, capture_length);
+    uint8_t *stale = malloc(sizeof(capture));
+    build_capture(stale, FIRST_SECONDS - 3600, NULL);
+    uint8_t *junk = malloc(capture_length);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < capture_length; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        junk[i] = (uint8_t)(seed >> 16);
+    }
+
+    size_t boundary = record_offset[RECORDS / 2];
+    check(capture, capture_length, 0, "intact file");
+    check_cut(boundary, zeros, 0, "cut at a record, zero fill");
+    check_cut(boundary + 30, zeros, 2, "payload cut, then zero fill");
+    check_cut(boundary + RECORD_HEADER_LEN + 2, zeros, 2, "payload cut after 2 bytes, then zero fill");
+    check_cut(boundary + 6, zeros, 2, "header cut, then zero fill");
+    check_cut(boundary, stale, 0, "cut at a record, stale data after it");
+    check_cut(boundary, junk, 0, "cut at a record, other files' data after it");
+    check_cut(boundary + 30, NULL, 2, "payload cut, file ends");
+    check_cut(boundary, NULL, 0, "cut at a record, file ends");
+    check_cut(record_offset[150], NULL, 0, "cut after a record ending in zeros");
+    check_cut(record_offset[150], zeros, 0, "  then zero fill");
+
+    uint8_t *damaged = malloc(capture_length);
+    memcpy(damaged, capture, capture_length);
+    memset(damaged + boundary + 4, 0xff, 8);
+    check(damaged, capture_length, 2, "record damaged in the middle");
+
+    free(damaged);
+    free(junk);
+    free(stale);
+    free(zeros);
+    remove(TEST_FILE);
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,670 @@
+/* replay — run the capture pipeline on the host, fed with the frames of a pcap file.
+
+   Usage: replay [-r fps] [-l loops] [-o dir] [-v] input.pcap
+          replay [-r fps] [-l loops] [-o dir] [-v] -g devices [-s seed] [-d seconds]
+          replay -b [-o dir] input.pcap | -g devices [-s seed] [-d seconds]
+          replay [-r fps] [-o dir] [-v] -x length [-s seed]
+
+   sniffer.c, pcap_lib.c and the modules they use are built against the shims in host/: FreeRTOS tasks
+   are threads, the SD card is the output directory (default replay-out) and the frames of the input
+   (802.11 or radiotap link type) are handed to the promiscuous callback from this thread, which stands
+   for the Wi-Fi task on core 0. With -g the frames come from a synthetic crowd of that many devices
+   instead (see workload.h), -d seconds of it from seed -s. With -x they are probe requests of that many
+   random bytes, which do not compress. Frames are offered at -r frames per second, or as fast as possible.
+
+   Every run reports what the pipeline counted, the drop rate, the ring and block high-water marks, the
+   peak memory of the process and, for the pcap format, whether the written files hold exactly the
+   accepted frames in order, also when the files are compressed. Under overload it also reports what the load shedding did and how many
+   probes the kept share of transmitters stands for, against the number offered. -b searches for the highest rate the pipeline sustains without drops.
+
+   replay_raw is the build for the raw storage backend: the card is the image file card.img in the output
+   directory, and the files are extracted from it into the directory after every run for the check.
+   replay_lzb is the build with CONFIG_PCAP_COMPRESSION_ENABLED.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "host.h"
+#include "config.h"
+#include "latency.h"
+#include "lzb.h"
+#include "manifest.h"
+#include "overload.h"
+#include "pcap_lib.h"
+#include "segfiles.h"
+#include "sniffer.h"
+#include "telemetry.h"
+#include "workload.h"
+
+#define PCAP_MAGIC_US               (0xA1B2C3D4)
+#define PCAP_MAGIC_NS               (0xA1B23C4D)
+#define PCAP_LINK_TYPE_RADIOTAP     (127)
+#define MAC_HEADER_LEN              (24)
+#define RADIOTAP_CHANNEL            (1u << 3)
+#define RADIOTAP_DBM_ANTSIGNAL      (1u << 5)
+
+#define REPLAY_BENCH_FRAMES         (200000) /* frames offered by every benchmark run, at least */
+#define REPLAY_BENCH_STEPS          (10)     /* bisection steps of the rate search */
+#define REPLAY_MAX_DROP_RATE        (0.001)  /* drop rate still counted as sustained */
+#define REPLAY_CARD_IMAGE           "card.img"
+#define REPLAY_CARD_SECTORS         (4u * 1024 * 1024) /* 2 GB, sparse */
+#define REPLAY_NOISE_FRAMES         (10000)  /* frames of random bytes generated by -x */
+#define REPLAY_NOISE_MAX_LEN        (2304)   /* longest 802.11 frame body */
+
+typedef struct {
+    uint8_t *data;
+    uint32_t length;
+    bool probe;             /* a probe request the sniffer will take */
+    bool kept;              /* a probe request from a transmitter overload sampling keeps */
+    uint8_t channel;        /* 0 for the channel the sniffer is tuned to */
+    int8_t rssi;
+} replay_frame_t;
+
+typedef struct {
+    uint64_t offered;
+    double offer_s;         /* time spent offering frames */
+    double total_s;         /* until the last frame was written and the files closed */
+    uint64_t counters[TELEMETRY_COUNTER_COUNT];
+    sniffer_pipeline_stats_t pipeline;
+    uint32_t first_idx;
+    uint32_t last_idx;
+    int integrity;          /* 1 ok, 0 failed, -1 not checked */
+    uint32_t verified;
+    uint64_t probes;        /* probe requests offered */
+    uint64_t kept_probes;   /* of those, from transmitters in the kept share */
+    uint32_t verified_kept; /* verified records from transmitters in the kept share */
+} replay_result_t;
+
+static replay_frame_t *frames;
+static uint32_t frame_count;
+static overload_t sampler;  /* the transmitter hash of the firmware's configuration */
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+static block_dev_t card;
+#endif
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t get32(const uint8_t *p, bool swap)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return swap ? __builtin_bswap32(value) : value;
+}
+
+static void add_frame(uint8_t *data, uint32_t length, uint8_t channel, int8_t rssi)
+{
+    static uint32_t capacity;
+
+    if (frame_count == capacity)
+    {
+        capacity = capacity ? capacity * 2 : 1024;
+        frames = realloc(frames, capacity * sizeof(*frames));
+        if (!frames)
+        {
+            fprintf(stderr, "out of memory after %u frames\n", frame_count);
+            exit(1);
+        }
+    }
+    frames[frame_count].data = data;
+    frames[frame_count].length = length;
+    frames[frame_count].probe = length >= MAC_HEADER_LEN && data[0] == 0x40;
+    frames[frame_count].kept = frames[frame_count].probe && overload_keep(&sampler, data + 10);
+    frames[frame_count].channel = channel;
+    frames[frame_count].rssi = rssi;
+    frame_count++;
+}
+
+/* Channel and signal of a radiotap header as probegen writes it, headers with other fields are left alone */
+static void parse_radiotap(const uint8_t *data, uint32_t length, uint8_t *channel, int8_t *rssi)
+{
+    uint32_t present = length >= 8 ? get32(data + 4, false) : 0;
+    uint32_t offset = 8;
+
+    if (present & ~(RADIOTAP_CHANNEL | RADIOTAP_DBM_ANTSIGNAL))
+    {
+        return;
+    }
+    if ((present & RADIOTAP_CHANNEL) && offset + 4 <= length)
+    {
+        uint32_t freq = data[offset] | data[offset + 1] << 8;
+        *channel = freq == 2484 ? 14 : freq >= 2412 && freq < 2484 ? (freq - 2407) / 5 : 0;
+        offset += 4;
+    }
+    if ((present & RADIOTAP_DBM_ANTSIGNAL) && offset < length)
+    {
+        *rssi = (int8_t)data[offset];
+    }
+}
+
+static bool load_pcap(const char *path)
+{
+    uint8_t header[24];
+    uint8_t record[16];
+    FILE *in = fopen(path, "rb");
+
+    if (!in)
+    {
+        perror(path);
+        return false;
+    }
+    if (fread(header, 1, sizeof(header), in) != sizeof(header))
+    {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        fclose(in);
+        return false;
+    }
+    uint32_t magic = get32(header, false);
+    bool swap = magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS);
+    uint32_t link_type = get32(header + 20, swap);
+    if ((magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS && !swap) ||
+        (link_type != PCAP_LINK_TYPE_802_11 && link_type != PCAP_LINK_TYPE_RADIOTAP))
+    {
+        fprintf(stderr, "%s: not an 802.11 pcap file\n", path);
+        fclose(in);
+        return false;
+    }
+    while (fread(record, 1, sizeof(record), in) == sizeof(record))
+    {
+        uint32_t length = get32(record + 8, swap);
+        uint8_t *data = malloc(length);
+        if (!data || fread(data, 1, length, in) != length)
+        {
+            free(data);
+            break;
+        }
+        uint32_t skip = 0;
+        uint8_t channel = 0;
+        int8_t rssi = -40 - (int8_t)(frame_count % 50);
+        if (link_type == PCAP_LINK_TYPE_RADIOTAP)
+        {
+            skip = length >= 4 ? (uint32_t)(data[2] | data[3] << 8) : length;
+            skip = skip > length ? length : skip;
+            parse_radiotap(data, skip, &channel, &rssi);
+        }
+        memmove(data, data + skip, length - skip);
+        add_frame(data, length - skip, channel, rssi);
+    }
+    fclose(in);
+    return frame_count > 0;
+}
+
+static bool generate(const workload_config_t *config)
+{
+    workload_t *workload = workload_create(config);
+    workload_frame_t frame;
+
+    if (!workload)
+    {
+        fprintf(stderr, "cannot set up a crowd of %u devices\n", config->devices);
+        return false;
+    }
+    while (workload_next(workload, &frame))
+    {
+        uint8_t *data = malloc(frame.length);
+        if (!data)
+        {
+            fprintf(stderr, "out of memory after %u frames\n", frame_count);
+            exit(1);
+        }
+        memcpy(data, frame.data, frame.length);
+        add_frame(data, frame.length, frame.channel, frame.rssi);
+    }
+    printf("generated    %u frames from %u devices and %llu addresses over %u s\n", frame_count, config->devices,
+           (unsigned long long)workload_addresses(workload), config->duration_s);
+    workload_destroy(workload);
+    return frame_count > 0;
+}
+
+/* Probe requests of random bytes after the frame control field, too many for the duplicate table to hold */
+static bool generate_noise(uint32_t length, uint64_t seed)
+{
+    uint64_t state = seed;
+
+    if (length < MAC_HEADER_LEN || length > REPLAY_NOISE_MAX_LEN)
+    {
+        fprintf(stderr, "random frames must be %u to %u bytes\n", MAC_HEADER_LEN, REPLAY_NOISE_MAX_LEN);
+        return false;
+    }
+    for (uint32_t i = 0; i < REPLAY_NOISE_FRAMES; i++)
+    {
+        uint8_t *data = malloc(length);
+        if (!data)
+        {
+            fprintf(stderr, "out of memory after %u frames\n", frame_count);
+            exit(1);
+        }
+        for (uint32_t j = 0; j < length; j++)
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            data[j] = (uint8_t)(state >> 56);
+        }
+        data[0] = 0x40;
+        data[1] = 0x00;
+        add_frame(data, length, 0, -40 - (int8_t)(i % 50));
+    }
+    printf("generated    %u random probe requests of %u bytes\n", frame_count, length);
+    return true;
+}
+
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+/* Turn the log on the card image back into files in the output directory */
+static bool extract_card(void)
+{
+    seglog_t log;
+    segfiles_report_t report;
+
+    if (seglog_mount(&log, &card, CONFIG_SEGLOG_FIRST_SECTOR) != ESP_OK)
+    {
+        fprintf(stderr, REPLAY_CARD_IMAGE": no segment log\n");
+        return false;
+    }
+    log.buffer = malloc(seglog_slot_size(&log));
+    bool ok = log.buffer && segfiles_extract(&log, CONFIG_SD_MOUNT_POINT, false, &report);
+    free(log.buffer);
+    if (ok && report.damaged > 0)
+    {
+        fprintf(stderr, REPLAY_CARD_IMAGE": %u damaged segments\n", report.damaged);
+    }
+    return ok && report.damaged == 0;
+}
+#endif
+
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_PCAP
+#if CONFIG_PCAP_COMPRESSION_ENABLED
+/* The capture in a compressed file, decompressed into a temporary file; NULL if a frame does not decode */
+static FILE *open_capture(const char *path)
+{
+    static uint8_t stored[LZB_MAX_BLOCK_SIZE];
+    static uint8_t raw[LZB_MAX_BLOCK_SIZE];
+    lzb_frame_header_t header;
+    FILE *in = fopen(path, "rb");
+    FILE *out = tmpfile();
+    bool ok = in && out;
+
+    while (ok && fread(&header, 1, sizeof(header), in) == sizeof(header))
+    {
+        ok = header.magic == LZB_FRAME_MAGIC && header.stored_length <= header.raw_length &&
+             header.raw_length <= LZB_MAX_BLOCK_SIZE &&
+             fread(stored, 1, header.stored_length, in) == header.stored_length;
+        if (ok && header.stored_length == header.raw_length)
+        {
+            memcpy(raw, stored, header.raw_length);
+        }
+        else if (ok)
+        {
+            ok = lzb_decompress(stored, header.stored_length, raw, sizeof(raw)) == (int32_t)header.raw_length;
+        }
+        ok = ok && lzb_checksum(raw, header.raw_length) == header.checksum &&
+             fwrite(raw, 1, header.raw_length, out) == header.raw_length;
+    }
+    if (in)
+    {
+        fclose(in);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "%s: missing or damaged compressed frame\n", path);
+        if (out)
+        {
+            fclose(out);
+        }
+        return NULL;
+    }
+    rewind(out);
+    return out;
+}
+#else
+static FILE *open_capture(const char *path)
+{
+    return fopen(path, "rb");
+}
+#endif
+
+/* Every record must be the next probe request offered, up to the ones dropped or suppressed on the way */
+static bool verify_output(replay_result_t *result)
+{
+    char path[64];
+    uint8_t header[24];
+    uint8_t record[16];
+    static uint8_t data[4096];
+    uint64_t next = 0;
+
+    for (uint32_t idx = result->first_idx; idx <= result->last_idx; idx++)
+    {
+        snprintf(path, sizeof(path), CONFIG_SD_MOUNT_POINT"/"CONFIG_PCAP_FILENAME_MASK, idx);
+        FILE *in = open_capture(path);
+        if (!in || fread(header, 1, sizeof(header), in) != sizeof(header) || get32(header, false) != PCAP_MAGIC_US)
+        {
+            fprintf(stderr, "%s: missing or not a pcap file\n", path);
+            if (in)
+            {
+                fclose(in);
+            }
+            return false;
+        }
+        while (fread(record, 1, sizeof(record), in) == sizeof(record))
+        {
+            uint32_t length = get32(record + 8, false);
+            uint32_t orig_length = get32(record + 12, false);
+            if (length > sizeof(data) || fread(data, 1, length, in) != length)
+            {
+                fprintf(stderr, "%s: truncated record after %u good ones\n", path, result->verified);
+                fclose(in);
+                return false;
+            }
+            /* trimmed records keep the MAC header as it was */
+            uint32_t compared = length == orig_length ? length : MAC_HEADER_LEN;
+            bool matched = false;
+            while (!matched && next < result->offered)
+            {
+                const replay_frame_t *frame = &frames[next++ % frame_count];
+                matched = frame->probe && frame->length == orig_length && memcmp(frame->data, data, compared) == 0;
+            }
+            if (!matched)
+            {
+                fprintf(stderr, "%s: record %u matches no offered frame\n", path, result->verified);
+                fclose(in);
+                return false;
+            }
+            result->verified++;
+            result->verified_kept += frames[(next - 1) % frame_count].kept;
+        }
+        fclose(in);
+    }
+    return result->verified == result->counters[TELEMETRY_FRAMES_WRITTEN];
+}
+#endif
+
+static bool run(double rate, uint64_t offer, replay_result_t *result)
+{
+    uint64_t before[TELEMETRY_COUNTER_COUNT];
+
+    memset(result, 0, sizeof(*result));
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+    if (pcap_attach_log(&card, (uint32_t)time(NULL), &result->first_idx) != ESP_OK ||
+#else
+    if (manifest_get_next_index(&result->first_idx) != ESP_OK ||
+#endif
+        pcap_open(result->first_idx) != ESP_OK || sniffer_start() != ESP_OK)
+    {
+        return false;
+    }
+    telemetry_snapshot(before);
+
+    double start = now_s();
+    for (uint64_t i = 0; i < offer; i++)
+    {
+        const replay_frame_t *frame = &frames[i % frame_count];
+        if (rate > 0)
+        {
+            double ahead = start + i / rate - now_s();
+            if (ahead > 100e-6)
+            {
+                struct timespec delay = { .tv_sec = (time_t)ahead, .tv_nsec = (long)((ahead - (time_t)ahead) * 1e9) };
+                nanosleep(&delay, NULL);
+            }
+        }
+        host_wifi_inject(frame->data, frame->length, frame->channel, frame->rssi);
+        result->probes += frame->probe;
+        result->kept_probes += frame->kept;
+    }
+    result->offered = offer;
+    result->offer_s = now_s() - start;
+    sniffer_get_pipeline_stats(&result->pipeline);
+    sniffer_stop();
+    pcap_close();
+    result->total_s = now_s() - start;
+    result->last_idx = pcap_get_capture_index();
+
+    telemetry_snapshot(result->counters);
+    for (int i = 0; i < TELEMETRY_COUNTER_COUNT; i++)
+    {
+        result->counters[i] -= before[i];
+    }
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+    if (!extract_card())
+    {
+        return false;
+    }
+#endif
+#if CONFIG_CAPTURE_FORMAT == CAPTURE_FORMAT_PCAP
+    result->integrity = verify_output(result);
+#else
+    result->integrity = -1;
+#endif
+    return true;
+}
+
+static double drop_rate(const replay_result_t *result)
+{
+    uint64_t dropped = result->counters[TELEMETRY_DROP_RING_FULL] + result->counters[TELEMETRY_DROP_WRITE_FAILED];
+    uint64_t accepted = result->counters[TELEMETRY_FRAMES_QUEUED] + result->counters[TELEMETRY_DROP_RING_FULL];
+
+    return accepted ? (double)dropped / accepted : 0;
+}
+
+static void report(const replay_result_t *result)
+{
+    const uint64_t *c = result->counters;
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("offered      %llu frames in %.3f s, %.0f frames/s\n", (unsigned long long)result->offered,
+           result->offer_s, result->offered / result->offer_s);
+    printf("pipeline     %llu seen, %llu filtered, %llu duplicates, %llu queued, %llu written in %.3f s, "
+           "%.0f frames/s\n", (unsigned long long)c[TELEMETRY_FRAMES_SEEN],
+           (unsigned long long)c[TELEMETRY_FRAMES_FILTERED], (unsigned long long)c[TELEMETRY_FRAMES_DUPLICATE],
+           (unsigned long long)c[TELEMETRY_FRAMES_QUEUED], (unsigned long long)c[TELEMETRY_FRAMES_WRITTEN],
+           result->total_s, c[TELEMETRY_FRAMES_WRITTEN] / result->total_s);
+    printf("drops        %llu ring full, %llu write failed, drop rate %.4f%%\n",
+           (unsigned long long)c[TELEMETRY_DROP_RING_FULL], (unsigned long long)c[TELEMETRY_DROP_WRITE_FAILED],
+           drop_rate(result) * 100);
+    printf("output       %llu bytes in files %u..%u, %u rotations, %u syncs\n",
+           (unsigned long long)c[TELEMETRY_BYTES_WRITTEN], result->first_idx, result->last_idx,
+           result->pipeline.rotations, result->pipeline.commits);
+    printf("high water   ring %u/%u bytes, blocks %u/%u, %u parse stalls, process peak %ld KB\n",
+           result->pipeline.ring_peak, result->pipeline.ring_size, result->pipeline.blocks_peak,
+           result->pipeline.block_count, result->pipeline.parse_stalls, usage.ru_maxrss);
+    if (CONFIG_OVERLOAD_ENABLED)
+    {
+        printf("overload     %llu summarized, %llu sampled out, %u mode changes, %s mode at the end\n",
+               (unsigned long long)c[TELEMETRY_FRAMES_SUMMARIZED], (unsigned long long)c[TELEMETRY_FRAMES_SAMPLED_OUT],
+               result->pipeline.overload_changes,
+               overload_mode_name(result->pipeline.overload_mode));
+    }
+    if (result->integrity < 0)
+    {
+        printf("integrity    not checked for this output format\n");
+        latency_log();
+        return;
+    }
+    printf("integrity    %s, %u records matched\n", result->integrity ? "ok" : "FAILED", result->verified);
+    if (CONFIG_OVERLOAD_ENABLED && result->probes > 0)
+    {
+        /* sampling keeps whole transmitters, chosen by hash: scaled up, the kept ones estimate the crowd */
+        uint64_t other_probes = result->probes - result->kept_probes;
+        double estimate = result->verified_kept * 100.0 / CONFIG_OVERLOAD_KEEP_PERCENT;
+        printf("sampling     kept share written %.2f%%, others %.2f%%; %.0f probes estimated from the kept share "
+               "of %u%%, %llu offered (%+.2f%%)\n",
+               result->kept_probes ? 100.0 * result->verified_kept / result->kept_probes : 0,
+               other_probes ? 100.0 * (result->verified - result->verified_kept) / other_probes : 0, estimate,
+               CONFIG_OVERLOAD_KEEP_PERCENT, (unsigned long long)result->probes,
+               100.0 * (estimate - result->probes) / result->probes);
+    }
+    latency_log();
+}
+
+/* Highest offered rate with no more than REPLAY_MAX_DROP_RATE drops, bisecting below the flat-out rate */
+static int bench(void)
+{
+    replay_result_t result;
+    uint64_t offer = frame_count;
+
+    while (offer < REPLAY_BENCH_FRAMES)
+    {
+        offer += frame_count;
+    }
+    if (!run(0, offer, &result))
+    {
+        return 1;
+    }
+    printf("== flat out\n");
+    report(&result);
+
+    double flat_out = result.offered / result.offer_s;
+    double sustained = drop_rate(&result) <= REPLAY_MAX_DROP_RATE && result.integrity != 0 ? flat_out : 0;
+    double low = 0;
+    double high = flat_out;
+    for (int step = 0; step < REPLAY_BENCH_STEPS && sustained < flat_out; step++)
+    {
+        double rate = (low + high) / 2;
+        if (!run(rate, offer, &result))
+        {
+            return 1;
+        }
+        printf("== %.0f frames/s\n", rate);
+        report(&result);
+        if (drop_rate(&result) <= REPLAY_MAX_DROP_RATE && result.integrity != 0)
+        {
+            sustained = low = rate;
+        }
+        else
+        {
+            high = rate;
+        }
+    }
+    printf("== maximum sustainable rate: %.0f frames/s offered (%s)\n", sustained,
+           sustained == flat_out ? "limited by the replay thread" : "drop rate below 0.1%");
+    return sustained > 0 ? 0 : 2;
+}
+
+static int usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-r fps] [-l loops] [-o dir] [-v] input.pcap\n"
+                    "       %s [-r fps] [-l loops] [-o dir] [-v] -g devices [-s seed] [-d seconds]\n"
+                    "       %s -b [-o dir] input.pcap | -g devices [-s seed] [-d seconds]\n"
+                    "       %s [-r fps] [-o dir] [-v] -x length [-s seed]\n", argv0, argv0, argv0, argv0);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    double rate = 0;
+    uint32_t loops = 1;
+    bool benchmark = false;
+    const char *dir = "replay-out";
+    uint32_t devices = 0;
+    uint64_t seed = 1;
+    uint32_t duration_s = 10;
+    uint32_t noise_length = 0;
+    replay_result_t result;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:l:o:g:s:d:x:bv")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = strtod(optarg, NULL);
+            break;
+        case 'l':
+            loops = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            dir = optarg;
+            break;
+        case 'g':
+            devices = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'd':
+            duration_s = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            noise_length = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            benchmark = true;
+            break;
+        case 'v':
+            host_log_level = ESP_LOG_INFO;
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (optind != argc - (devices || noise_length ? 0 : 1) || loops == 0)
+    {
+        return usage(argv[0]);
+    }
+    overload_init(&sampler, CONFIG_SNIFFER_RING_SIZE, CONFIG_OVERLOAD_SUMMARY_PERCENT, CONFIG_OVERLOAD_SAMPLE_PERCENT,
+                  CONFIG_OVERLOAD_HYSTERESIS_PERCENT, CONFIG_OVERLOAD_HOLD_MS, CONFIG_OVERLOAD_KEEP_PERCENT,
+                  CONFIG_OVERLOAD_SEED);
+    if (devices)
+    {
+        workload_config_t config;
+        workload_default_config(&config, devices, seed, duration_s);
+        if (!generate(&config))
+        {
+            return 1;
+        }
+    }
+    else if (noise_length)
+    {
+        if (!generate_noise(noise_length, seed))
+        {
+            return 1;
+        }
+    }
+    else if (!load_pcap(argv[optind]))
+    {
+        return 1;
+    }
+    /* the output directory is the SD card */
+    if ((mkdir(dir, 0755) != 0 && errno != EEXIST) || chdir(dir) != 0)
+    {
+        perror(dir);
+        return 1;
+    }
+#if CONFIG_STORAGE_BACKEND == STORAGE_BACKEND_RAW
+    if (host_block_dev_open(&card, REPLAY_CARD_IMAGE, REPLAY_CARD_SECTORS, true) != ESP_OK)
+    {
+        return 1;
+    }
+#endif
+    host_set_core(0);
+    initialize_sniffer();
+
+    if (benchmark)
+    {
+        return bench();
+    }
+    if (!run(rate, (uint64_t)frame_count * loops, &result))
+    {
+        return 1;
+    }
+    report(&result);
+    return result.integrity == 0 ? 2 : 0;
+}
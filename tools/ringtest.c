@@ -0,0 +1,301 @@
+/* ringtest — checks of the capture ring: wrap-around, full ring, large records and a two-thread stress run.
+
+   Usage: ringtest [records]
+
+   Drives main/capture_ring.c the way the Wi-Fi callback and the sniffer task do. Single-threaded checks
+   cover records wrapping around the end of a small ring in order and intact, reservations failing on a
+   full ring without the head catching up with the tail, and the guarantee the ring size is chosen by: a
+   record of up to half the ring fits an empty ring wherever its offsets are. Then a producer and a
+   consumer thread pass records (2000000 by default) of varying length through the ring as fast as they
+   can; every record that was not dropped must arrive once, in order and unchanged.
+   Exit status 0 if every check passed.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "capture_ring.h"
+
+#define SMALL_RING_SIZE         (256)
+#define STRESS_RING_SIZE        (4096)
+#define STRESS_RECORDS          (2000000)
+#define MAX_RECORD_LEN          (200)
+#define STRESS_RETRIES          (100)   /* yields before the producer gives a record up */
+
+static uint8_t small_buf[SMALL_RING_SIZE] __attribute__((aligned(4)));
+static uint8_t stress_buf[STRESS_RING_SIZE] __attribute__((aligned(4)));
+static int failures;
+
+static void check(bool ok, const char *what, long long detail)
+{
+    printf("%-44s %s (%lld)\n", what, ok ? "ok" : "FAILED", detail);
+    failures += !ok;
+}
+
+/* Length and contents of record seq: a sequence number, then bytes derived from it */
+static uint32_t record_length(uint32_t seq)
+{
+    return sizeof(uint32_t) + (seq * 2654435761u >> 24) % (MAX_RECORD_LEN - sizeof(uint32_t) + 1);
+}
+
+static void fill_record(uint8_t *record, uint32_t seq, uint32_t length)
+{
+    memcpy(record, &seq, sizeof(seq));
+    for (uint32_t i = sizeof(seq); i < length; i++)
+    {
+        record[i] = (uint8_t)(seq + i);
+    }
+}
+
+/* Sequence number of an intact record, or UINT32_MAX */
+static uint32_t check_record(const uint8_t *record, uint32_t length)
+{
+    uint32_t seq;
+
+    if (length < sizeof(seq))
+    {
+        return UINT32_MAX;
+    }
+    memcpy(&seq, record, sizeof(seq));
+    for (uint32_t i = sizeof(seq); i < length; i++)
+    {
+        if (record[i] != (uint8_t)(seq + i))
+        {
+            return UINT32_MAX;
+        }
+    }
+    return seq;
+}
+
+static bool push(capture_ring_t *ring, uint32_t seq, uint32_t length)
+{
+    uint8_t *record = capture_ring_reserve(ring, length);
+    if (!record)
+    {
+        return false;
+    }
+    fill_record(record, seq, length);
+    capture_ring_commit(ring, length);
+    return true;
+}
+
+/* Takes the oldest record; its sequence number, UINT32_MAX if damaged, or UINT32_MAX - 1 if the ring is empty */
+static uint32_t pop(capture_ring_t *ring)
+{
+    uint32_t length;
+    const uint8_t *record = capture_ring_peek(ring, &length);
+    if (!record)
+    {
+        return UINT32_MAX - 1;
+    }
+    uint32_t seq = check_record(record, length);
+    capture_ring_release(ring);
+    return seq;
+}
+
+/* Records of many lengths through a small ring, a few at a time, so they wrap at every offset */
+static void test_wrap(void)
+{
+    capture_ring_t ring;
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    uint32_t wraps = 0;
+    uint32_t last_head = 0;
+    bool ordered = true;
+
+    capture_ring_init(&ring, small_buf, sizeof(small_buf));
+    for (uint32_t round = 0; round < 10000; round++)
+    {
+        for (uint32_t i = 0; i < round % 3 + 1; i++)
+        {
+            if (!push(&ring, pushed, record_length(pushed) % 60 + sizeof(uint32_t)))
+            {
+                break;
+            }
+            pushed++;
+            uint32_t head = atomic_load(&ring.head);
+            wraps += head < last_head;
+            last_head = head;
+        }
+        while (round % 2 == 0 && capture_ring_used(&ring) > 0)
+        {
+            ordered &= pop(&ring) == popped++;
+        }
+    }
+    while (capture_ring_used(&ring) > 0)
+    {
+        ordered &= pop(&ring) == popped++;
+    }
+    check(ordered && popped == pushed, "records wrap in order and intact", popped);
+    check(wraps > 1000, "  wrapped around the end", wraps);
+}
+
+/* A full ring refuses records and counts them, and takes them again once the consumer made room */
+static void test_full(void)
+{
+    capture_ring_t ring;
+    uint32_t pushed = 0;
+
+    capture_ring_init(&ring, small_buf, sizeof(small_buf));
+    while (push(&ring, pushed, 20))
+    {
+        pushed++;
+    }
+    check(pushed == (SMALL_RING_SIZE - 1) / 24, "full ring refuses a record", pushed);
+    check(capture_ring_dropped(&ring) == 1, "  the drop is counted", capture_ring_dropped(&ring));
+    while (push(&ring, pushed, sizeof(uint32_t)))
+    {
+        pushed++;
+    }
+    uint32_t used = capture_ring_used(&ring);
+    check(used >= SMALL_RING_SIZE - 8 && used < SMALL_RING_SIZE, "  filled up, head short of the tail", used);
+    check(capture_ring_dropped(&ring) == 2, "  the second drop is counted", capture_ring_dropped(&ring));
+    check(pop(&ring) == 0 && pop(&ring) == 1 && push(&ring, pushed, 20), "  room again after releases", pushed);
+
+    uint32_t expected = 2;
+    uint32_t seq;
+    while ((seq = pop(&ring)) != UINT32_MAX - 1)
+    {
+        expected += seq == expected;
+    }
+    check(expected == pushed + 1, "  records after the drops are intact", expected);
+    check(capture_ring_used(&ring) == 0, "  empty after reading all", capture_ring_used(&ring));
+}
+
+/* Whatever offset an empty ring was left at, a record of up to half of it fits, wrapping if needed */
+static void test_large_record(void)
+{
+    capture_ring_t ring;
+    uint32_t largest = SMALL_RING_SIZE / 2 - 2 * sizeof(uint32_t);
+    uint32_t failed_at = UINT32_MAX;
+
+    for (uint32_t offset = 0; offset < SMALL_RING_SIZE; offset += 4)
+    {
+        /* an empty ring whose last record ended at offset */
+        capture_ring_init(&ring, small_buf, sizeof(small_buf));
+        atomic_store(&ring.head, offset);
+        atomic_store(&ring.tail, offset);
+        if (!push(&ring, 1, largest) || pop(&ring) != 1 || capture_ring_used(&ring) != 0)
+        {
+            failed_at = offset;
+            break;
+        }
+    }
+    check(failed_at == UINT32_MAX, "half-ring record fits an empty ring anywhere", failed_at);
+
+    capture_ring_init(&ring, small_buf, sizeof(small_buf));
+    push(&ring, 0, SMALL_RING_SIZE - 64 - 4);
+    pop(&ring);
+    check(push(&ring, 1, 100) && atomic_load(&ring.head) < 128 && pop(&ring) == 1,
+          "record longer than the end wraps to the start", atomic_load(&ring.head));
+    check(!push(&ring, 2, SMALL_RING_SIZE), "record larger than the ring is dropped", capture_ring_dropped(&ring));
+}
+
+typedef struct {
+    capture_ring_t ring;
+    uint32_t records;
+    uint32_t sent;
+    atomic_bool done;
+    uint32_t received;
+    uint32_t damaged;
+    uint32_t out_of_order;
+} stress_t;
+
+static void *stress_producer(void *arg)
+{
+    stress_t *stress = arg;
+
+    for (uint32_t seq = 0; seq < stress->records; seq++)
+    {
+        /* unlike the Wi-Fi callback, give the consumer a chance first: most records should get through */
+        for (uint32_t attempt = 0; attempt < STRESS_RETRIES; attempt++)
+        {
+            if (push(&stress->ring, seq, record_length(seq)))
+            {
+                stress->sent++;
+                break;
+            }
+            sched_yield();
+        }
+    }
+    atomic_store(&stress->done, true);
+    return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{
+    stress_t *stress = arg;
+    uint32_t next = 0;
+
+    while (true)
+    {
+        bool done = atomic_load(&stress->done);
+        uint32_t length;
+        const uint8_t *record = capture_ring_peek(&stress->ring, &length);
+        if (!record)
+        {
+            if (done)
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        uint32_t seq = check_record(record, length);
+        capture_ring_release(&stress->ring);
+        if (seq != UINT32_MAX && length != record_length(seq))
+        {
+            seq = UINT32_MAX;
+        }
+        if (seq == UINT32_MAX)
+        {
+            stress->damaged++;
+            continue;
+        }
+        stress->out_of_order += seq < next;
+        next = seq + 1;
+        stress->received++;
+    }
+    return NULL;
+}
+
+static void test_stress(uint32_t records)
+{
+    static stress_t stress;
+    pthread_t producer;
+    pthread_t consumer;
+
+    capture_ring_init(&stress.ring, stress_buf, sizeof(stress_buf));
+    stress.records = records;
+    pthread_create(&consumer, NULL, stress_consumer, &stress);
+    pthread_create(&producer, NULL, stress_producer, &stress);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    check(stress.damaged == 0, "two threads: no record damaged", stress.damaged);
+    check(stress.out_of_order == 0, "  none out of order", stress.out_of_order);
+    check(stress.received == stress.sent, "  every record sent is received", stress.received);
+    printf("  %u of %u records sent, %u reservations failed on a full ring\n", stress.sent, records,
+           capture_ring_dropped(&stress.ring));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t records = argc > 1 ? strtoul(argv[1], NULL, 0) : STRESS_RECORDS;
+
+    test_wrap();
+    test_full();
+    test_large_record();
+    test_stress(records);
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
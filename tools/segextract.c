@@ -0,0 +1,87 @@
+/* segextract — get the capture files back from a card written by the raw storage backend.
+
+   Usage: segextract [-s first_sector] [-o dir] image
+
+   image is a copy of the card, or the card itself, e.g.:
+
+       dd if=/dev/sdX of=card.img bs=1M && segextract -o capture card.img
+
+   The log header at first_sector (default CONFIG_SEGLOG_FIRST_SECTOR) gives the segment size and the
+   file name mask; the segments are read in order up to the end of the log and every file is written
+   into dir (default the current directory). Damaged segments are left out and reported, so a file
+   holding one has a gap: run pcaprecover on it to keep its intact records.
+
+   Exit status: 0 if the log is intact, 2 if damaged segments were found, 1 on error.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "host.h"
+#include "config.h"
+#include "seglog.h"
+#include "segfiles.h"
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-s first_sector] [-o dir] image\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t first_sector = CONFIG_SEGLOG_FIRST_SECTOR;
+    const char *dir = ".";
+    block_dev_t dev;
+    seglog_t log;
+    segfiles_report_t report;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            first_sector = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            dir = optarg;
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+    {
+        return usage(argv[0]);
+    }
+    if (host_block_dev_open(&dev, argv[optind], 0, false) != ESP_OK)
+    {
+        return 1;
+    }
+    if (seglog_mount(&log, &dev, first_sector) != ESP_OK)
+    {
+        fprintf(stderr, "%s: no segment log at sector %u\n", argv[optind], first_sector);
+        host_block_dev_close(&dev);
+        return 1;
+    }
+    printf("log          %08x, %u byte segments of %s, %u slots\n", log.log_id, log.payload_max, log.name_mask,
+           log.slot_count);
+    log.buffer = malloc(seglog_slot_size(&log));
+    bool ok = log.buffer && segfiles_extract(&log, dir, true, &report);
+    free(log.buffer);
+    host_block_dev_close(&dev);
+    if (!ok)
+    {
+        return 1;
+    }
+    printf("extracted    %u files, %llu bytes in %u segments, %u damaged\n", report.files,
+           (unsigned long long)report.bytes, report.segments, report.damaged);
+    printf("end of log   at slot %u of %u\n", report.end_slot, log.slot_count);
+    return report.damaged > 0 ? 2 : 0;
+}
@@ -0,0 +1,115 @@
+/* Segment files — the capture files held in a segment log, written back into a directory.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "segfiles.h"
+
+typedef struct {
+    FILE *out;
+    char path[512];
+    uint32_t file_index;
+    uint32_t segments;
+    uint64_t bytes;
+} segfiles_file_t;
+
+static bool segfiles_close(segfiles_file_t *file, bool verbose)
+{
+    if (!file->out)
+    {
+        return true;
+    }
+    bool ok = fclose(file->out) == 0;
+    file->out = NULL;
+    if (!ok)
+    {
+        perror(file->path);
+    }
+    else if (verbose)
+    {
+        printf("%-24s %10llu bytes in %u segments\n", file->path, (unsigned long long)file->bytes, file->segments);
+    }
+    return ok;
+}
+
+static bool segfiles_open(segfiles_file_t *file, const seglog_t *log, const char *dir, uint32_t file_index)
+{
+    char name[SEGLOG_NAME_MAX + 16];
+
+    snprintf(name, sizeof(name), log->name_mask, file_index);
+    snprintf(file->path, sizeof(file->path), "%s/%s", dir, name);
+    file->out = fopen(file->path, "wb");
+    if (!file->out)
+    {
+        perror(file->path);
+        return false;
+    }
+    file->file_index = file_index;
+    file->segments = 0;
+    file->bytes = 0;
+    return true;
+}
+
+bool segfiles_extract(seglog_t *log, const char *dir, bool verbose, segfiles_report_t *report)
+{
+    segfiles_file_t file = { 0 };
+    seglog_header_t header;
+    const uint8_t *payload;
+    uint32_t slot;
+
+    memset(report, 0, sizeof(*report));
+    for (slot = 0; slot < log->slot_count; slot++)
+    {
+        esp_err_t ret = seglog_read(log, slot, &header, &payload);
+        if (ret == ESP_ERR_NOT_FOUND)
+        {
+            break;
+        }
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_CRC)
+        {
+            fprintf(stderr, "slot %u: read failed (0x%x)\n", slot, ret);
+            segfiles_close(&file, verbose);
+            return false;
+        }
+        if (!file.out || header.file_index != file.file_index)
+        {
+            if (!segfiles_close(&file, verbose) || !segfiles_open(&file, log, dir, header.file_index))
+            {
+                return false;
+            }
+            if (report->files++ == 0)
+            {
+                report->first_file = header.file_index;
+            }
+            report->last_file = header.file_index;
+        }
+        if (ret == ESP_ERR_INVALID_CRC)
+        {
+            /* the header is intact, so the gap in the file is known */
+            if (verbose)
+            {
+                printf("damaged segment %u, %u bytes missing from %s at offset %llu\n", slot, header.length,
+                       file.path, (unsigned long long)file.bytes);
+            }
+            report->damaged++;
+            continue;
+        }
+        if (fwrite(payload, 1, header.length, file.out) != header.length)
+        {
+            perror(file.path);
+            segfiles_close(&file, false);
+            return false;
+        }
+        file.segments++;
+        file.bytes += header.length;
+        report->segments++;
+        report->bytes += header.length;
+    }
+    report->end_slot = slot;
+    return segfiles_close(&file, verbose);
+}
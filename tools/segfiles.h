@@ -0,0 +1,52 @@
+/* Segment files — the capture files held in a segment log, written back into a directory.
+
+   Shared by segextract, which works on an image of the card, and the raw backend build of replay, which
+   checks what the pipeline wrote.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "seglog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What an extraction found
+ *
+ */
+typedef struct {
+    uint32_t segments;          /*!< Intact segments written out */
+    uint32_t damaged;           /*!< Segments whose payload failed the CRC, left out */
+    uint32_t files;             /*!< Files written */
+    uint32_t first_file;        /*!< Index of the first file, if any */
+    uint32_t last_file;         /*!< Index of the last file, if any */
+    uint64_t bytes;             /*!< Payload bytes written */
+    uint32_t end_slot;          /*!< First slot holding no segment of the log, where the next one would go */
+} segfiles_report_t;
+
+/**
+ * @brief Write every file of a log into a directory, named after the log's file name mask
+ *
+ * Reads the slots in order up to the first one that holds no segment of the log. A damaged segment is
+ * left out of its file and counted.
+ *
+ * @param log log opened with seglog_mount(), with its buffer set
+ * @param dir output directory, must exist
+ * @param verbose print a line per file and per damaged segment
+ * @param[out] report what was found
+ * @return false on a read or write error
+ */
+bool segfiles_extract(seglog_t *log, const char *dir, bool verbose, segfiles_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,105 @@
+/* timebasetest — checks of the receive timestamp mapping across counter wraps, late frames and long gaps.
+
+   Usage: timebasetest
+
+   Feeds main/timebase.c a synthetic radio counter and monotonic clock, starting just before the 32-bit
+   counter wraps, and checks that stamps follow the elapsed time: through a wrap, after a late frame and
+   after quiet periods longer than half and than a whole wrap period (35.8 and 71.6 minutes), during which
+   no frame reaches the callback. The system clock the model samples is synthetic too: gettimeofday() is
+   defined here, the linker takes it over the C library's, and runs at the radio's rate from a fixed epoch.
+   Exit status 0 if every check passed.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "timebase.h"
+
+#define FRAME_INTERVAL_US       (1000)
+#define TOLERANCE_US            (1000)
+#define EPOCH_US                (1760000000LL * 1000000) /* system clock at the start of the run */
+
+static timebase_t timebase;
+static uint64_t radio_us = (1ULL << 32) - 5000000; /* the counter wraps 5 s into the run */
+static int64_t now_us;
+static int64_t last_stamp;
+static int failures;
+
+int gettimeofday(struct timeval *tv, void *tz)
+{
+    tv->tv_sec = (EPOCH_US + now_us) / 1000000;
+    tv->tv_usec = (EPOCH_US + now_us) % 1000000;
+    return 0;
+}
+
+static int64_t frame(int64_t advance_us)
+{
+    radio_us += advance_us;
+    now_us += advance_us;
+    return timebase_stamp(&timebase, (uint32_t)radio_us, now_us);
+}
+
+static void check(bool ok, const char *what, long long detail)
+{
+    printf("%-44s %s (%lld us)\n", what, ok ? "ok" : "FAILED", detail);
+    failures += !ok;
+}
+
+/* A stream of frames for seconds, every stamp FRAME_INTERVAL_US after the one before */
+static void stream(uint32_t seconds, const char *what)
+{
+    int64_t worst = 0;
+
+    for (uint32_t i = 0; i < seconds * (1000000 / FRAME_INTERVAL_US); i++)
+    {
+        int64_t stamp = frame(FRAME_INTERVAL_US);
+        int64_t error = llabs(stamp - last_stamp - FRAME_INTERVAL_US);
+        worst = error > worst ? error : worst;
+        last_stamp = stamp;
+    }
+    check(worst < TOLERANCE_US, what, worst);
+}
+
+/* A quiet period, then frames again */
+static void gap(int64_t gap_us, const char *what)
+{
+    int64_t stamp = frame(gap_us);
+    check(llabs(stamp - last_stamp - gap_us) < TOLERANCE_US, what, stamp - last_stamp - gap_us);
+    last_stamp = stamp;
+    stamp = frame(1000000);
+    check(stamp - last_stamp > 990000 && stamp - last_stamp <= 1000000 + TOLERANCE_US, "  frames after it move on",
+          stamp - last_stamp);
+    last_stamp = stamp;
+}
+
+int main(void)
+{
+    timebase_init(&timebase);
+    last_stamp = frame(0);
+    stream(20, "stream through the counter wrap");
+
+    /* a frame latched before the previous one must not go back in time or move the counter */
+    radio_us -= 200;
+    now_us -= 200;
+    int64_t late = frame(0);
+    check(late == last_stamp, "late frame keeps the last stamp", late - last_stamp);
+    radio_us += 200;
+    now_us += 200;
+    stream(1, "stream after the late frame");
+
+    gap(50 * 60 * 1000000LL, "gap of 50 minutes");
+    stream(5, "stream after it");
+    gap(80 * 60 * 1000000LL, "gap of 80 minutes, more than a wrap");
+    stream(5, "stream after it");
+    gap(36 * 60 * 1000000LL, "gap of 36 minutes");
+
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,400 @@
+/* Workload — synthetic 802.11 probe-request streams for stress tests, reproducible from a seed.
+
+   Devices are kept in a min-heap ordered by the time of their next frame, so the stream comes out in time
+   order at O(log devices) per frame and crowds of 100000 devices take a few megabytes.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "workload.h"
+
+#define WORKLOAD_MAX_SSIDS          (3)     /* remembered networks per device */
+#define WORKLOAD_SSID_MAX           (32)
+#define WORKLOAD_MAX_BURST          (8)
+#define WORKLOAD_CHANNEL_SLOT_US    (20000) /* time a scan spends on each channel */
+#define WORKLOAD_MIN_GAP_US         (1000000)
+#define WORKLOAD_ROTATE_PER_SCAN    (1)     /* workload_profile_t::rotation_s: new address for every scan */
+#define WORKLOAD_MAC_HEADER_LEN     (24)
+
+typedef struct {
+    uint32_t share;             /* percent of the crowd */
+    uint32_t scan_gap_s;        /* mean time between scans */
+    uint32_t rotation_s;        /* mean lifetime of a randomized address, 0 keeps the vendor address */
+    uint32_t directed_percent;  /* scans that also probe the remembered SSIDs */
+    uint8_t oui[3];             /* vendor address prefix, without randomization */
+    const uint8_t *ies;         /* elements after the DS parameter set */
+    uint32_t ies_length;
+} workload_profile_t;
+
+typedef struct {
+    uint64_t next_us;           /* time of the next frame */
+    uint64_t scan_us;           /* start of the current scan */
+    uint64_t rotate_us;         /* when the randomized address changes next */
+    uint8_t mac[6];
+    uint16_t seq;
+    uint8_t profile;
+    int8_t rssi;
+    uint8_t ssid_count;
+    uint8_t channel_idx;        /* position in the channel sweep */
+    uint8_t frame_no;           /* frames sent on the current channel */
+    uint8_t frames;             /* frames to send on the current channel */
+    bool directed;              /* this scan probes the remembered SSIDs */
+    bool fresh;                 /* address not sent yet */
+    uint16_t ssids[WORKLOAD_MAX_SSIDS];
+} workload_device_t;
+
+struct workload {
+    workload_config_t config;
+    uint64_t rng;
+    uint64_t end_us;
+    uint64_t addresses;
+    workload_device_t *devices;
+    uint32_t *heap;             /* device indices, earliest next_us first */
+    char (*ssids)[WORKLOAD_SSID_MAX + 1];
+};
+
+/* Smartphone, address randomized for a while (iOS-like): HT, extended capabilities, Apple vendor element */
+static const uint8_t ies_phone_a[] = {
+    0x2d, 0x1a, 0x2d, 0x40, 0x17, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7f, 0x0a, 0x04, 0x00, 0x0a, 0x02, 0x01, 0x40, 0x00, 0x40, 0x00, 0x01,
+    0xdd, 0x0a, 0x00, 0x17, 0xf2, 0x0a, 0x00, 0x01, 0x04, 0x00, 0x00, 0x00,
+};
+/* Smartphone, new address for every scan (Android-like): HT, extended capabilities, Wi-Fi Alliance element */
+static const uint8_t ies_phone_b[] = {
+    0x2d, 0x1a, 0xef, 0x01, 0x13, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7f, 0x08, 0x00, 0x00, 0x08, 0x84, 0x00, 0x00, 0x00, 0x40,
+    0xdd, 0x09, 0x00, 0x10, 0x18, 0x02, 0x00, 0x00, 0x1c, 0x00, 0x00,
+};
+/* Laptop, vendor address: HT, extended capabilities, WPS element */
+static const uint8_t ies_laptop[] = {
+    0x2d, 0x1a, 0x6f, 0x00, 0x17, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7f, 0x08, 0x04, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x40,
+    0xdd, 0x0e, 0x00, 0x50, 0xf2, 0x04, 0x10, 0x4a, 0x00, 0x01, 0x10, 0x10, 0x3a, 0x00, 0x01, 0x00,
+};
+/* IoT device, vendor address, legacy rates only */
+static const uint8_t ies_iot[] = {
+    0xdd, 0x07, 0x00, 0x50, 0xf2, 0x08, 0x00, 0x10, 0x00,
+};
+
+static const workload_profile_t profiles[] = {
+    { 45, 45, 900, 5, { 0x00, 0x17, 0xf2 }, ies_phone_a, sizeof(ies_phone_a) },
+    { 35, 30, WORKLOAD_ROTATE_PER_SCAN, 10, { 0x00, 0x1a, 0x11 }, ies_phone_b, sizeof(ies_phone_b) },
+    { 12, 60, 0, 60, { 0x3c, 0xa9, 0xf4 }, ies_laptop, sizeof(ies_laptop) },
+    { 8, 120, 0, 100, { 0x24, 0x0a, 0xc4 }, ies_iot, sizeof(ies_iot) },
+};
+
+static const uint8_t rates[] = { 0x01, 0x04, 0x82, 0x84, 0x8b, 0x96 };
+static const uint8_t extended_rates[] = { 0x32, 0x08, 0x0c, 0x12, 0x18, 0x24, 0x30, 0x48, 0x60, 0x6c };
+
+static const char *ssid_patterns[] = {
+    "eduroam", "Starbucks WiFi", "HomeNet-%04X", "FRITZ!Box 7590 %02X", "TP-Link_%04X", "Vodafone-%04X",
+    "AndroidAP%04X", "Guest-%03u", "Office %u", "iPhone %u",
+};
+
+/* xorshift64*, seeded through splitmix64 so that small seeds give unrelated streams */
+static uint64_t next_random(workload_t *workload)
+{
+    workload->rng ^= workload->rng >> 12;
+    workload->rng ^= workload->rng << 25;
+    workload->rng ^= workload->rng >> 27;
+    return workload->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t uniform(workload_t *workload, uint32_t range)
+{
+    return (uint32_t)((next_random(workload) >> 32) * range >> 32);
+}
+
+static uint64_t exponential_us(workload_t *workload, uint64_t mean_us)
+{
+    double u = (next_random(workload) >> 11) * (1.0 / 9007199254740992.0);
+
+    return (uint64_t)(-log(1.0 - u) * mean_us);
+}
+
+static void new_address(workload_t *workload, workload_device_t *device)
+{
+    const workload_profile_t *profile = &profiles[device->profile];
+    uint64_t random = next_random(workload);
+
+    memcpy(device->mac, &random, sizeof(device->mac));
+    if (profile->rotation_s)
+    {
+        /* locally administered unicast */
+        device->mac[0] = (device->mac[0] & 0xFC) | 0x02;
+        if (profile->rotation_s != WORKLOAD_ROTATE_PER_SCAN)
+        {
+            device->rotate_us = device->scan_us + exponential_us(workload, profile->rotation_s * 1000000ULL);
+        }
+    }
+    else
+    {
+        memcpy(device->mac, profile->oui, sizeof(profile->oui));
+    }
+    device->seq = uniform(workload, 4096);
+    device->fresh = true;
+}
+
+static uint8_t burst_size(workload_t *workload)
+{
+    uint32_t mean = workload->config.burst_mean;
+    uint8_t frames = 1;
+
+    /* geometric around the mean */
+    while (frames < WORKLOAD_MAX_BURST && uniform(workload, mean) > 0)
+    {
+        frames++;
+    }
+    return frames;
+}
+
+static void start_channel(workload_t *workload, workload_device_t *device)
+{
+    uint64_t next_us = device->scan_us + device->channel_idx * WORKLOAD_CHANNEL_SLOT_US + uniform(workload, 3000);
+
+    device->frame_no = 0;
+    device->frames = burst_size(workload) * (1 + (device->directed ? device->ssid_count : 0));
+    /* long bursts overrun the slot and push the following channels back */
+    device->next_us = device->channel_idx && next_us <= device->next_us ? device->next_us + 1000 : next_us;
+}
+
+static void start_scan(workload_t *workload, workload_device_t *device, uint64_t scan_us)
+{
+    const workload_profile_t *profile = &profiles[device->profile];
+
+    device->scan_us = scan_us;
+    if (profile->rotation_s == WORKLOAD_ROTATE_PER_SCAN || (profile->rotation_s && scan_us >= device->rotate_us))
+    {
+        new_address(workload, device);
+    }
+    device->directed = device->ssid_count > 0 && uniform(workload, 100) < profile->directed_percent;
+    device->channel_idx = 0;
+    start_channel(workload, device);
+}
+
+static void advance(workload_t *workload, workload_device_t *device)
+{
+    const workload_profile_t *profile = &profiles[device->profile];
+
+    if (++device->frame_no < device->frames)
+    {
+        device->next_us += 1000 + uniform(workload, 2000);
+    }
+    else if (++device->channel_idx < workload->config.channel_count)
+    {
+        start_channel(workload, device);
+    }
+    else
+    {
+        uint64_t gap = exponential_us(workload, profile->scan_gap_s * 10000ULL * workload->config.scan_gap_scale);
+        start_scan(workload, device, device->next_us + (gap < WORKLOAD_MIN_GAP_US ? WORKLOAD_MIN_GAP_US : gap));
+    }
+}
+
+static inline bool earlier(const workload_t *workload, uint32_t a, uint32_t b)
+{
+    return workload->devices[workload->heap[a]].next_us < workload->devices[workload->heap[b]].next_us;
+}
+
+static void swap(workload_t *workload, uint32_t a, uint32_t b)
+{
+    uint32_t device = workload->heap[a];
+
+    workload->heap[a] = workload->heap[b];
+    workload->heap[b] = device;
+}
+
+static void sift_down(workload_t *workload, uint32_t pos)
+{
+    uint32_t count = workload->config.devices;
+
+    while (2 * pos + 1 < count)
+    {
+        uint32_t child = 2 * pos + 1;
+        if (child + 1 < count && earlier(workload, child + 1, child))
+        {
+            child++;
+        }
+        if (!earlier(workload, child, pos))
+        {
+            break;
+        }
+        swap(workload, child, pos);
+        pos = child;
+    }
+}
+
+static uint32_t build_frame(const workload_t *workload, const workload_device_t *device, uint8_t channel,
+                            uint8_t *p)
+{
+    const workload_profile_t *profile = &profiles[device->profile];
+    uint8_t *start = p;
+    uint32_t probe = device->directed ? device->frame_no % (1 + device->ssid_count) : 0;
+    const char *ssid = probe ? workload->ssids[device->ssids[probe - 1]] : "";
+    uint32_t ssid_length = strlen(ssid);
+
+    memset(p, 0, WORKLOAD_MAC_HEADER_LEN);
+    p[0] = 0x40;
+    memset(p + 4, 0xFF, 6);
+    memcpy(p + 10, device->mac, 6);
+    memset(p + 16, 0xFF, 6);
+    p[22] = device->seq << 4;
+    p[23] = device->seq >> 4;
+    p += WORKLOAD_MAC_HEADER_LEN;
+
+    *p++ = 0;
+    *p++ = ssid_length;
+    memcpy(p, ssid, ssid_length);
+    p += ssid_length;
+    memcpy(p, rates, sizeof(rates));
+    p += sizeof(rates);
+    memcpy(p, extended_rates, sizeof(extended_rates));
+    p += sizeof(extended_rates);
+    *p++ = 3;
+    *p++ = 1;
+    *p++ = channel;
+    memcpy(p, profile->ies, profile->ies_length);
+    p += profile->ies_length;
+    return p - start;
+}
+
+void workload_default_config(workload_config_t *config, uint32_t devices, uint64_t seed, uint32_t duration_s)
+{
+    memset(config, 0, sizeof(*config));
+    config->devices = devices;
+    config->seed = seed;
+    config->duration_s = duration_s;
+    config->start_us = 1700000000ULL * 1000000;
+    for (uint32_t i = 0; i < 13; i++)
+    {
+        config->channels[i] = i + 1;
+    }
+    config->channel_count = 13;
+    config->scan_gap_scale = 100;
+    config->burst_mean = 2;
+    config->ssid_pool = 64;
+}
+
+workload_t *workload_create(const workload_config_t *config)
+{
+    workload_t *workload = calloc(1, sizeof(*workload));
+
+    if (!workload || config->devices == 0 || config->channel_count == 0 || config->ssid_pool == 0)
+    {
+        free(workload);
+        return NULL;
+    }
+    workload->config = *config;
+    if (workload->config.burst_mean == 0)
+    {
+        workload->config.burst_mean = 1;
+    }
+    workload->devices = calloc(config->devices, sizeof(*workload->devices));
+    workload->heap = calloc(config->devices, sizeof(*workload->heap));
+    workload->ssids = calloc(config->ssid_pool, sizeof(*workload->ssids));
+    if (!workload->devices || !workload->heap || !workload->ssids)
+    {
+        workload_destroy(workload);
+        return NULL;
+    }
+    workload->end_us = config->start_us + config->duration_s * 1000000ULL;
+
+    uint64_t z = config->seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    workload->rng = (z ^ (z >> 31)) | 1;
+
+    for (uint32_t i = 0; i < config->ssid_pool; i++)
+    {
+        const char *pattern = ssid_patterns[uniform(workload, sizeof(ssid_patterns) / sizeof(ssid_patterns[0]))];
+        snprintf(workload->ssids[i], sizeof(workload->ssids[i]), pattern, uniform(workload, 0x10000));
+    }
+
+    for (uint32_t i = 0; i < config->devices; i++)
+    {
+        workload_device_t *device = &workload->devices[i];
+        uint32_t pick = uniform(workload, 100);
+        while (pick >= profiles[device->profile].share)
+        {
+            pick -= profiles[device->profile].share;
+            device->profile++;
+        }
+        device->rssi = -90 + (int8_t)uniform(workload, 56);
+        /* few networks are remembered by many devices, most by few */
+        device->ssid_count = uniform(workload, WORKLOAD_MAX_SSIDS + 1);
+        for (uint32_t s = 0; s < device->ssid_count; s++)
+        {
+            uint32_t u = uniform(workload, 1024);
+            device->ssids[s] = (uint64_t)config->ssid_pool * u * u / (1024 * 1024);
+        }
+        /* the crowd is already scanning when the stream starts */
+        uint64_t offset = uniform(workload, profiles[device->profile].scan_gap_s) * 1000000ULL;
+        if (!profiles[device->profile].rotation_s)
+        {
+            new_address(workload, device);
+        }
+        /* randomizing devices pick their first address here */
+        start_scan(workload, device, config->start_us + offset);
+        workload->heap[i] = i;
+    }
+    for (uint32_t i = config->devices / 2; i-- > 0;)
+    {
+        sift_down(workload, i);
+    }
+    return workload;
+}
+
+bool workload_next(workload_t *workload, workload_frame_t *frame)
+{
+    uint32_t index = workload->heap[0];
+    workload_device_t *device = &workload->devices[index];
+
+    if (device->next_us >= workload->end_us)
+    {
+        return false;
+    }
+    uint8_t channel = workload->config.channels[device->channel_idx];
+    int32_t rssi = device->rssi + (int32_t)uniform(workload, 7) - 3;
+
+    frame->length = build_frame(workload, device, channel, frame->data);
+    frame->timestamp_us = device->next_us;
+    frame->channel = channel;
+    frame->rssi = rssi > -20 ? -20 : rssi;
+    frame->device = index;
+    if (device->fresh)
+    {
+        device->fresh = false;
+        workload->addresses++;
+    }
+
+    device->seq = (device->seq + 1) & 0x0FFF;
+    advance(workload, device);
+    sift_down(workload, 0);
+    return true;
+}
+
+uint64_t workload_addresses(const workload_t *workload)
+{
+    return workload->addresses;
+}
+
+void workload_destroy(workload_t *workload)
+{
+    if (workload)
+    {
+        free(workload->devices);
+        free(workload->heap);
+        free(workload->ssids);
+        free(workload);
+    }
+}
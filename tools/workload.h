@@ -0,0 +1,94 @@
+/* Workload — synthetic 802.11 probe-request streams for stress tests, reproducible from a seed.
+
+   A crowd of devices scans for networks: every scan sweeps the channel list and sends a burst of probe
+   requests on each channel, scans are separated by random gaps. Devices follow one of a few profiles
+   (phones, laptops, IoT) that fix their information elements, how often they scan, whether they send
+   directed probes for their remembered SSIDs and how often they rotate a randomized MAC address.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WORKLOAD_MAX_CHANNELS       (14)
+#define WORKLOAD_MAX_FRAME          (256)
+
+/**
+ * @brief Shape of the generated crowd
+ *
+ */
+typedef struct {
+    uint32_t devices;           /*!< Size of the crowd */
+    uint64_t seed;              /*!< Same seed and settings, same stream */
+    uint32_t duration_s;        /*!< Length of the stream */
+    uint64_t start_us;          /*!< Timestamp of the stream start */
+    uint8_t channels[WORKLOAD_MAX_CHANNELS]; /*!< Channels swept by every scan */
+    uint32_t channel_count;
+    uint32_t scan_gap_scale;    /*!< Percent of each profile's mean gap between scans, 100 keeps them */
+    uint32_t burst_mean;        /*!< Mean probe requests per channel and scan, at least 1 */
+    uint32_t ssid_pool;         /*!< Distinct SSIDs remembered across the crowd */
+} workload_config_t;
+
+/**
+ * @brief One generated frame
+ *
+ */
+typedef struct {
+    uint8_t data[WORKLOAD_MAX_FRAME];
+    uint32_t length;
+    uint64_t timestamp_us;
+    uint8_t channel;
+    int8_t rssi;
+    uint32_t device;            /*!< Index of the sending device */
+} workload_frame_t;
+
+typedef struct workload workload_t;
+
+/**
+ * @brief Defaults: channels 1-13, profile scan gaps, 2 probes per channel and scan, 64 SSIDs
+ *
+ * @param[out] config configuration to adjust
+ * @param devices size of the crowd
+ * @param seed stream seed
+ * @param duration_s length of the stream
+ */
+void workload_default_config(workload_config_t *config, uint32_t devices, uint64_t seed, uint32_t duration_s);
+
+/**
+ * @brief Set up a crowd
+ *
+ * @param config shape of the crowd
+ * @return generator, NULL if out of memory
+ */
+workload_t *workload_create(const workload_config_t *config);
+
+/**
+ * @brief Next frame in time order
+ *
+ * @param workload generator
+ * @param[out] frame frame and its metadata
+ * @return false once the stream is over
+ */
+bool workload_next(workload_t *workload, workload_frame_t *frame);
+
+/**
+ * @brief Distinct transmitter addresses sent so far, counting every rotation of a randomized MAC
+ *
+ */
+uint64_t workload_addresses(const workload_t *workload);
+
+void workload_destroy(workload_t *workload);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,179 @@
+/* writebench — latency of the capture file block writes, with and without preallocation.
+
+   Usage: writebench [-m megabytes] [-f files] [-b block] [-s] dir
+
+   Writes files of the given size in blocks like the pcap writer task does, first letting them grow
+   and then reserving their space up front with the firmware's file_extent functions, and prints
+   p50/p99/max, mean and standard deviation of the block writes of each run. -s syncs after every
+   block, like a card without a write cache. Point dir at a mounted FAT image to see the cost of
+   cluster allocation, e.g.:
+
+       truncate -s 1G fat.img && mkfs.vfat -F 32 -s 64 fat.img
+       mount -o loop,sync fat.img /mnt/fat && writebench -m 32 -f 8 /mnt/fat
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, fileno, fsync, getopt */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "file_extent.h"
+#include "latency.h"
+
+#define DEFAULT_BLOCK_SIZE  (16 * 1024)
+/* host ticks are nanoseconds */
+#define TICKS_PER_US        (1000)
+
+typedef struct {
+    latency_histogram_t histogram;
+    double sum_us;
+    double sum_sq_us;
+    double reserve_us;      /* spent in file_extent_reserve() */
+    double close_us;        /* spent closing and trimming */
+    uint32_t errors;
+} run_result_t;
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-m megabytes] [-f files] [-b block] [-s] dir\n", name);
+    return 1;
+}
+
+static double elapsed_us(uint32_t start)
+{
+    return (double)(latency_ticks() - start) / TICKS_PER_US;
+}
+
+/* Write files of size bytes into dir, reserving their space first if preallocate is set */
+static bool run(const char *dir, uint32_t size, uint32_t files, uint32_t block_size, bool sync, bool preallocate,
+                run_result_t *result)
+{
+    char path[512];
+    uint8_t *block = malloc(block_size);
+
+    if (!block)
+    {
+        return false;
+    }
+    memset(result, 0, sizeof(*result));
+    for (uint32_t i = 0; i < block_size; i++)
+    {
+        block[i] = (uint8_t)(i * 131 + 7);
+    }
+    for (uint32_t file = 0; file < files; file++)
+    {
+        snprintf(path, sizeof(path), "%s/writebench_%06u.bin", dir, file);
+        FILE *fp = fopen(path, "wb+");
+        if (!fp)
+        {
+            perror(path);
+            free(block);
+            return false;
+        }
+        setvbuf(fp, NULL, _IONBF, 0);
+        if (preallocate)
+        {
+            /* a little more than written, as the firmware sizes from the previous file */
+            uint32_t start = latency_ticks();
+            if (file_extent_reserve(fp, 0, size + size / 4) != ESP_OK)
+            {
+                result->errors++;
+            }
+            result->reserve_us += elapsed_us(start);
+        }
+        for (uint32_t written = 0; written < size; written += block_size)
+        {
+            uint32_t start = latency_ticks();
+            if (fwrite(block, 1, block_size, fp) != block_size || (sync && fsync(fileno(fp)) != 0))
+            {
+                result->errors++;
+            }
+            uint32_t ticks = latency_ticks() - start;
+            double us = (double)ticks / TICKS_PER_US;
+            latency_histogram_add(&result->histogram, ticks);
+            result->sum_us += us;
+            result->sum_sq_us += us * us;
+        }
+        uint32_t start = latency_ticks();
+        if (fclose(fp) != 0 || file_extent_trim(path, size) != ESP_OK)
+        {
+            result->errors++;
+        }
+        result->close_us += elapsed_us(start);
+    }
+    for (uint32_t file = 0; file < files; file++)
+    {
+        snprintf(path, sizeof(path), "%s/writebench_%06u.bin", dir, file);
+        remove(path);
+    }
+    free(block);
+    return true;
+}
+
+static void report(const char *name, const run_result_t *result, uint32_t files)
+{
+    latency_summary_t summary;
+
+    latency_histogram_summary(&result->histogram, TICKS_PER_US, &summary);
+    double mean = summary.count ? result->sum_us / summary.count : 0;
+    double variance = summary.count ? result->sum_sq_us / summary.count - mean * mean : 0;
+    printf("%-13s %8u writes, p50 %8.1f us, p99 %8.1f us, max %9.1f us, mean %8.1f us, stddev %8.1f us\n", name,
+           summary.count, summary.p50, summary.p99, summary.max, mean, sqrt(variance > 0 ? variance : 0));
+    printf("%-13s reserve %.1f us, close and trim %.1f us per file%s\n", "", result->reserve_us / files,
+           result->close_us / files, result->errors ? ", WRITE ERRORS" : "");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t megabytes = 16;
+    uint32_t files = 4;
+    uint32_t block_size = DEFAULT_BLOCK_SIZE;
+    bool sync = false;
+    run_result_t growing;
+    run_result_t preallocated;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:f:b:s")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            megabytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            files = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            block_size = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            sync = true;
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || megabytes == 0 || files == 0 || block_size == 0)
+    {
+        return usage(argv[0]);
+    }
+    uint32_t size = megabytes * 1024 * 1024 / block_size * block_size;
+
+    printf("%u files of %u bytes in %u byte blocks%s\n", files, size, block_size, sync ? ", synced per block" : "");
+    if (!run(argv[optind], size, files, block_size, sync, false, &growing) ||
+        !run(argv[optind], size, files, block_size, sync, true, &preallocated))
+    {
+        return 1;
+    }
+    report("growing", &growing, files);
+    report("preallocated", &preallocated, files);
+    return 0;
+}